@@ -4,9 +4,19 @@ import (
 	"autocomplete/backend/internal/cache"
 	"autocomplete/backend/internal/completer"
 	"autocomplete/backend/internal/log"
+	"autocomplete/backend/internal/metrics"
 	"autocomplete/backend/internal/storage"
+	"bytes"
+	"context"
+	"errors"
+	"fmt"
+	"io"
 	"net/http"
 	"os"
+	"os/signal"
+	"path/filepath"
+	"syscall"
+	"time"
 
 	"github.com/gin-gonic/gin"
 )
@@ -35,30 +45,45 @@ func runServerWithAPIKey(openaiAPIKey string) {
 		log.ErrorLogger.Fatalf("FATAL: Failed to validate embedder connection: %v", err)
 	}
 
+	// Completion queries go ahead of re-indexing, and re-indexing ahead of
+	// directory indexing, for every workspace sharing the embedder
+	embedder = completer.NewScheduledEmbedder(embedder, config)
+
 	// Get embedding dimensions and create vector store
 	dimensions := embedder.GetDimensions()
 	log.InfoLogger.Printf("📏 Using embedding dimensions: %d", dimensions)
 
-	vectorStore, err := storage.NewVectorStore(dimensions)
-	if err != nil {
-		log.ErrorLogger.Fatalf("Could not create vector store: %v", err)
+	newVectorStore := storage.NewVectorStore
+	if config.ProfileCacheMisses {
+		log.InfoLogger.Println("🔬 Profiling vector search cache misses")
+		newVectorStore = storage.NewProfiledVectorStore
 	}
-	defer vectorStore.Close()
 
-	// Use injected OpenAI API key string for completions (still using OpenAI for text generation)
-	// Create OpenAI client for completions (still using OpenAI for text generation)
+	// Vector searches for completion queries go ahead of store updates from
+	// indexing, across all workspaces
+	storeScheduler := completer.NewVectorStoreScheduler()
+
+	// Completions come from OpenAI or a local OpenAI-compatible server, with
+	// slow requests optionally hedged to a backup
 	if openaiAPIKey == "" {
 		log.ErrorLogger.Fatalln("FATAL: OpenAI API key must be provided to run the server.")
 	}
-	completionModel := config.Embedding.CompletionModel
-	if completionModel == "" {
-		completionModel = "gpt-4.1-nano"
-	}
-	openaiClient := completer.NewOpenAIClientWithModel(openaiAPIKey, completionModel)
+	llm := completer.NewCompletionProvider(config, openaiAPIKey)
 
-	// Create completion service with configurable embedder but OpenAI for completions
-	embCache := cache.NewInMemoryCache()
-	completionService := completer.NewCompletionService(vectorStore, embedder, openaiClient, embCache, config)
+	// Every workspace gets its own vector store and completion service, while
+	// the embedder, the LLM and the embedding cache are shared
+	embCache := newEmbeddingCache(config, dimensions)
+	if closer, ok := embCache.(interface{ Close() error }); ok {
+		defer closer.Close()
+	}
+	workspaces := completer.NewWorkspaces(func() (*completer.CompletionService, error) {
+		vectorStore, err := newVectorStore(dimensions)
+		if err != nil {
+			return nil, fmt.Errorf("could not create vector store: %w", err)
+		}
+		return completer.NewCompletionService(storeScheduler.Schedule(vectorStore), embedder, llm, embCache, config), nil
+	}, dimensions, int64(config.WorkspaceMemoryMB)<<20)
+	defer workspaces.Close()
 
 	// Simple health check endpoint
 	router.GET("/", func(c *gin.Context) {
@@ -67,6 +92,17 @@ func runServerWithAPIKey(openaiAPIKey string) {
 		})
 	})
 
+	// Prometheus-style metrics: per-stage completion latency histograms plus
+	// vector search counters for tuning search width and spotting degenerate graphs
+	router.GET("/metrics", func(c *gin.Context) {
+		var body bytes.Buffer
+		metrics.WritePrometheus(&body)
+		writeVectorSearchMetrics(&body, workspaces.VectorStats())
+		metrics.WriteSample(&body, "workspaces_loaded", "gauge",
+			"Workspace indexes currently loaded.", float64(workspaces.Loaded()))
+		c.Data(http.StatusOK, "text/plain; version=0.0.4; charset=utf-8", body.Bytes())
+	})
+
 	// Endpoint to trigger workspace indexing
 	router.POST("/index", func(c *gin.Context) {
 		var jsonBody struct {
@@ -77,32 +113,23 @@ func runServerWithAPIKey(openaiAPIKey string) {
 			return
 		}
 
-		// If no path is provided, use the current working directory.
-		path := jsonBody.Path
-		if path == "" {
-			var err error
-			path, err = os.Getwd()
-			if err != nil {
-				c.JSON(http.StatusInternalServerError, gin.H{"error": "Could not get working directory"})
-				return
-			}
+		path, err := workspaces.Index(jsonBody.Path)
+		if err != nil {
+			c.JSON(http.StatusInternalServerError, gin.H{"error": err.Error()})
+			return
 		}
 
-		// Run indexing asynchronously
-		go func(path string) {
-			if err := completionService.IndexDirectory(path); err != nil {
-				log.ErrorLogger.Printf("ERROR: Failed to index directory async: %v", err)
-			} else {
-				log.InfoLogger.Printf("Async indexing completed for directory: %s", path)
-			}
-		}(path)
-
 		// Immediately respond that indexing started
 		c.JSON(http.StatusOK, gin.H{
 			"message": "Indexing started for directory: " + path,
 		})
 	})
 
+	// Endpoint to report queued, running and recent indexing jobs
+	router.GET("/index/status", func(c *gin.Context) {
+		c.JSON(http.StatusOK, gin.H{"workspaces": workspaces.IndexStatus()})
+	})
+
 	// Endpoint to index a single file
 	router.POST("/index-file", func(c *gin.Context) {
 		var jsonBody struct {
@@ -113,14 +140,7 @@ func runServerWithAPIKey(openaiAPIKey string) {
 			return
 		}
 
-		// Run file indexing asynchronously
-		go func(path string) {
-			if err := completionService.IndexFile(path); err != nil {
-				log.ErrorLogger.Printf("ERROR: Failed to index file async: %v", err)
-			} else {
-				log.InfoLogger.Printf("Async indexing completed for file: %s", path)
-			}
-		}(jsonBody.Path)
+		indexFileAsync(workspaces, jsonBody.Path)
 
 		// Immediately respond that indexing started
 		c.JSON(http.StatusOK, gin.H{
@@ -137,7 +157,13 @@ func runServerWithAPIKey(openaiAPIKey string) {
 			c.JSON(http.StatusBadRequest, gin.H{"error": err.Error()})
 			return
 		}
-		if err := completionService.DeleteFile(jsonBody.Path); err != nil {
+		service, release, err := workspaces.Acquire(jsonBody.Path)
+		if err != nil {
+			c.JSON(http.StatusInternalServerError, gin.H{"error": err.Error()})
+			return
+		}
+		defer release()
+		if err := service.DeleteFile(jsonBody.Path); err != nil {
 			log.ErrorLogger.Printf("ERROR: Failed to delete file: %v", err)
 			c.JSON(http.StatusInternalServerError, gin.H{"error": err.Error()})
 			return
@@ -145,20 +171,89 @@ func runServerWithAPIKey(openaiAPIKey string) {
 		c.JSON(http.StatusOK, gin.H{"message": "Deletion completed for file: " + jsonBody.Path})
 	})
 
-	// Endpoint to get a code completion
-	router.GET("/complete", func(c *gin.Context) {
-		filePath := c.Query("file_path")
-		content := c.Query("content")
+	// Endpoints mirroring the documents open in the editor, so completion
+	// requests can send a cursor offset instead of the text before it
+	router.POST("/documents/open", func(c *gin.Context) {
+		var jsonBody struct {
+			FilePath string `json:"file_path"`
+			Version  int    `json:"version"`
+			Text     string `json:"text"`
+		}
+		if err := c.ShouldBindJSON(&jsonBody); err != nil || jsonBody.FilePath == "" {
+			c.JSON(http.StatusBadRequest, gin.H{"error": "file_path, version and text are required"})
+			return
+		}
+		service, release, err := workspaces.Acquire(jsonBody.FilePath)
+		if err != nil {
+			c.JSON(http.StatusInternalServerError, gin.H{"error": err.Error()})
+			return
+		}
+		defer release()
+		service.OpenDocument(jsonBody.FilePath, jsonBody.Version, jsonBody.Text)
+		c.JSON(http.StatusOK, gin.H{"version": jsonBody.Version})
+	})
 
-		if filePath == "" || content == "" {
-			c.JSON(http.StatusBadRequest, gin.H{"error": "file_path and content are required"})
+	router.POST("/documents/change", func(c *gin.Context) {
+		var jsonBody struct {
+			FilePath    string                   `json:"file_path"`
+			BaseVersion int                      `json:"base_version"`
+			Version     int                      `json:"version"`
+			Changes     []completer.DocumentEdit `json:"changes"`
+		}
+		if err := c.ShouldBindJSON(&jsonBody); err != nil || jsonBody.FilePath == "" {
+			c.JSON(http.StatusBadRequest, gin.H{"error": "file_path, base_version, version and changes are required"})
+			return
+		}
+		service, release, err := workspaces.Acquire(jsonBody.FilePath)
+		if err != nil {
+			c.JSON(http.StatusInternalServerError, gin.H{"error": err.Error()})
+			return
+		}
+		defer release()
+		err = service.ChangeDocument(jsonBody.FilePath, jsonBody.BaseVersion, jsonBody.Version, jsonBody.Changes)
+		if err != nil {
+			c.JSON(documentErrorStatus(err), gin.H{"error": err.Error()})
+			return
+		}
+		c.JSON(http.StatusOK, gin.H{"version": jsonBody.Version})
+	})
+
+	router.POST("/documents/close", func(c *gin.Context) {
+		var jsonBody struct {
+			FilePath string `json:"file_path"`
+		}
+		if err := c.ShouldBindJSON(&jsonBody); err != nil || jsonBody.FilePath == "" {
+			c.JSON(http.StatusBadRequest, gin.H{"error": "file_path is required"})
+			return
+		}
+		service, release, err := workspaces.Acquire(jsonBody.FilePath)
+		if err != nil {
+			c.JSON(http.StatusInternalServerError, gin.H{"error": err.Error()})
+			return
+		}
+		defer release()
+		service.CloseDocument(jsonBody.FilePath)
+		c.JSON(http.StatusOK, gin.H{"message": "Closed document: " + jsonBody.FilePath})
+	})
+
+	// Endpoint to get a code completion
+	complete := func(c *gin.Context) {
+		service, filePath, content, release, ok := readCompletionRequest(c, workspaces)
+		if !ok {
 			return
 		}
+		defer release()
 
 		log.InfoLogger.Printf("Received completion request for file: %s", filePath)
 
-		// Get single completion response
-		completion, err := completionService.GetCompletion(filePath, content)
+		// Get single completion response. The request context is cancelled
+		// when the editor drops the connection.
+		completion, err := service.GetCompletion(c.Request.Context(), filePath, content)
+		if errors.Is(err, completer.ErrSuperseded) || errors.Is(err, context.Canceled) {
+			log.InfoLogger.Printf("Completion request for %s abandoned: %v", filePath, err)
+			c.JSON(http.StatusOK, gin.H{"completion": ""})
+			return
+		}
 		if err != nil {
 			log.ErrorLogger.Printf("Failed to get completion: %v", err)
 			c.JSON(http.StatusInternalServerError, gin.H{"error": "Failed to generate completion"})
@@ -167,12 +262,94 @@ func runServerWithAPIKey(openaiAPIKey string) {
 
 		// Return single JSON response
 		c.JSON(http.StatusOK, gin.H{"completion": completion})
-	})
+	}
+	router.GET("/complete", complete)
+	router.POST("/complete", complete)
+
+	// Endpoint to stream a code completion as server-sent events: one
+	// "token" event per piece of text as the LLM produces it, then "done",
+	// or "error" with the status of a failed request if the completion
+	// failed. The stream ends after the first complete statement or block.
+	completeStream := func(c *gin.Context) {
+		service, filePath, content, release, ok := readCompletionRequest(c, workspaces)
+		if !ok {
+			return
+		}
+		defer release()
 
-	log.InfoLogger.Println("🚀 Starting server on http://localhost:2539")
-	if err := router.Run(":2539"); err != nil {
+		log.InfoLogger.Printf("Received streaming completion request for file: %s", filePath)
+
+		tokens := make(chan string)
+		streamErr := make(chan error, 1)
+		go func() {
+			streamErr <- service.GetCompletionStream(c.Request.Context(), filePath, content, tokens)
+		}()
+
+		c.Header("Cache-Control", "no-cache")
+		c.Header("X-Accel-Buffering", "no")
+		disconnected := c.Stream(func(w io.Writer) bool {
+			token, ok := <-tokens
+			if !ok {
+				err := <-streamErr
+				if errors.Is(err, completer.ErrSuperseded) || errors.Is(err, context.Canceled) {
+					log.InfoLogger.Printf("Streaming completion for %s abandoned: %v", filePath, err)
+				} else if err != nil {
+					log.ErrorLogger.Printf("Failed to stream completion: %v", err)
+					c.SSEvent("error", gin.H{"error": "Failed to generate completion", "status": http.StatusInternalServerError})
+					return false
+				}
+				c.SSEvent("done", gin.H{})
+				return false
+			}
+			c.SSEvent("token", gin.H{"text": token})
+			return true
+		})
+		if disconnected {
+			// The client went away; let the service wind down.
+			for range tokens {
+			}
+		}
+	}
+	router.GET("/complete/stream", completeStream)
+	router.POST("/complete/stream", completeStream)
+
+	// The server runs until it is interrupted or the RPC socket goes idle.
+	// It then returns rather than exiting, so the deferred closes above
+	// save the workspace indexes and the embedding cache.
+	ctx, stop := signal.NotifyContext(context.Background(), os.Interrupt, syscall.SIGTERM)
+	defer stop()
+
+	// The editor talks to the backend over a Unix socket when one is
+	// configured; HTTP stays available for metrics and other tools unless
+	// its port is set to 0.
+	if config.ListenSocket != "" {
+		go func() {
+			defer stop()
+			idleTimeout := time.Duration(config.IdleTimeoutSeconds) * time.Second
+			if err := serveRPC(ctx, config.ListenSocket, workspaces, idleTimeout); err != nil {
+				log.ErrorLogger.Fatalf("🔥 Could not serve RPC: %s\n", err)
+			}
+		}()
+		if config.ListenPort == 0 {
+			<-ctx.Done()
+			return
+		}
+	}
+
+	server := &http.Server{Addr: fmt.Sprintf(":%d", config.ListenPort), Handler: router}
+	drained := make(chan struct{})
+	go func() {
+		defer close(drained)
+		<-ctx.Done()
+		shutdown, cancel := context.WithTimeout(context.Background(), 5*time.Second)
+		defer cancel()
+		server.Shutdown(shutdown)
+	}()
+	log.InfoLogger.Printf("🚀 Starting server on http://localhost:%d", config.ListenPort)
+	if err := server.ListenAndServe(); err != nil && !errors.Is(err, http.ErrServerClosed) {
 		log.ErrorLogger.Fatalf("🔥 Could not start server: %s\n", err)
 	}
+	<-drained
 }
 
 // main is the entry point of the program.
@@ -185,3 +362,95 @@ func main() {
 	}
 	runServerWithAPIKey(openaiAPIKey)
 }
+
+// newEmbeddingCache builds the embedding cache: a bounded in-memory tier in
+// front of the persistent cache shared by every workspace. If persistence is
+// disabled or fails to open, only the in-memory tier is used.
+func newEmbeddingCache(config *completer.Config, dimensions int) cache.EmbeddingCache {
+	memory := cache.NewSlabCache(dimensions, int64(config.Embedding.MemoryCacheMB)<<20)
+	if config.Embedding.CacheMaxMB == 0 {
+		return memory
+	}
+	cacheDir, err := os.UserCacheDir()
+	if err != nil {
+		log.ErrorLogger.Printf("⚠️ No user cache directory, embeddings will not persist: %v", err)
+		return memory
+	}
+	modelID := fmt.Sprintf("%s/%d", config.EmbeddingModelID(), dimensions)
+	maxBytes := int64(config.Embedding.CacheMaxMB) << 20
+	diskCache, err := cache.NewDiskCache(filepath.Join(cacheDir, "autocomplete", "embeddings"), modelID, maxBytes)
+	if err != nil {
+		log.ErrorLogger.Printf("⚠️ Failed to open embedding cache, embeddings will not persist: %v", err)
+		return memory
+	}
+	return cache.NewTieredCache(memory, diskCache)
+}
+
+// indexFileAsync queues re-indexing a single file in its workspace.
+func indexFileAsync(workspaces *completer.Workspaces, path string) {
+	go func() {
+		service, release, err := workspaces.Acquire(path)
+		if err != nil {
+			log.ErrorLogger.Printf("ERROR: Failed to index file async: %v", err)
+			return
+		}
+		defer release()
+		service.QueueFileChanges([]string{path}).Wait()
+		log.InfoLogger.Printf("Async indexing completed for file: %s", path)
+	}()
+}
+
+// readCompletionRequest returns the service of the workspace of a
+// completion request's file, the file and the text before the cursor,
+// writing an error response if it has neither. GET requests carry the text
+// in the query string; POST requests name a version of a mirrored document
+// and a cursor offset in it. release must be called when ok is true.
+func readCompletionRequest(c *gin.Context, workspaces *completer.Workspaces) (service *completer.CompletionService, filePath, content string, release func(), ok bool) {
+	var version, offset int
+	if c.Request.Method == http.MethodGet {
+		filePath = c.Query("file_path")
+		content = c.Query("content")
+		if filePath == "" || content == "" {
+			c.JSON(http.StatusBadRequest, gin.H{"error": "file_path and content are required"})
+			return nil, "", "", nil, false
+		}
+	} else {
+		var jsonBody struct {
+			FilePath string `json:"file_path"`
+			Version  int    `json:"version"`
+			Offset   int    `json:"offset"`
+		}
+		if err := c.ShouldBindJSON(&jsonBody); err != nil || jsonBody.FilePath == "" {
+			c.JSON(http.StatusBadRequest, gin.H{"error": "file_path, version and offset are required"})
+			return nil, "", "", nil, false
+		}
+		filePath, version, offset = jsonBody.FilePath, jsonBody.Version, jsonBody.Offset
+	}
+
+	service, release, err := workspaces.Acquire(filePath)
+	if err != nil {
+		c.JSON(http.StatusInternalServerError, gin.H{"error": err.Error()})
+		return nil, "", "", nil, false
+	}
+	if content == "" {
+		if content, err = service.DocumentPrefix(filePath, version, offset); err != nil {
+			release()
+			c.JSON(documentErrorStatus(err), gin.H{"error": err.Error()})
+			return nil, "", "", nil, false
+		}
+	}
+	return service, filePath, content, release, true
+}
+
+// documentErrorStatus maps a document mirror error to an HTTP status. A
+// 404 or 409 tells the editor to open the document again.
+func documentErrorStatus(err error) int {
+	switch {
+	case errors.Is(err, completer.ErrUnknownDocument):
+		return http.StatusNotFound
+	case errors.Is(err, completer.ErrVersionMismatch):
+		return http.StatusConflict
+	default:
+		return http.StatusBadRequest
+	}
+}
@@ -0,0 +1,29 @@
+package main
+
+import (
+	"autocomplete/backend/internal/metrics"
+	"autocomplete/backend/internal/storage"
+	"io"
+)
+
+// writeVectorSearchMetrics renders vector search statistics in the
+// Prometheus text exposition format. The graph traversal counters are left
+// out: the store's brute-force indexes never produce them.
+func writeVectorSearchMetrics(w io.Writer, stats storage.Stats) {
+	metrics.WriteSample(w, "vector_search_vectors", "gauge",
+		"Vectors in the current index.", float64(stats.Vectors))
+	metrics.WriteSample(w, "vector_search_queries_total", "counter",
+		"Vector search queries served.", float64(stats.Queries))
+	metrics.WriteSample(w, "vector_search_distance_computations_total", "counter",
+		"Distance evaluations performed by queries.", float64(stats.DistanceComputations))
+	metrics.WriteSample(w, "vector_search_visited_nodes_total", "counter",
+		"Distinct nodes visited by queries.", float64(stats.VisitedNodes))
+	metrics.WriteSample(w, "vector_search_profiled_queries_total", "counter",
+		"Queries with a hardware cache-miss measurement.", float64(stats.ProfiledQueries))
+	metrics.WriteSample(w, "vector_search_cache_misses_total", "counter",
+		"Hardware cache misses incurred by profiled queries.", float64(stats.CacheMisses))
+	metrics.WriteSample(w, "vector_search_build_inserts", "gauge",
+		"Vectors inserted into the current index by its build and since.", float64(stats.BuildInserts))
+	metrics.WriteSample(w, "vector_search_build_inserts_per_second", "gauge",
+		"Insert throughput of the current index.", stats.BuildInsertsPerSecond())
+}
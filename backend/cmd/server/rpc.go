@@ -0,0 +1,479 @@
+package main
+
+import (
+	"autocomplete/backend/internal/completer"
+	"autocomplete/backend/internal/log"
+	"bufio"
+	"context"
+	"encoding/binary"
+	"encoding/json"
+	"errors"
+	"fmt"
+	"io"
+	"net"
+	"net/http"
+	"os"
+	"path/filepath"
+	"sync"
+	"time"
+)
+
+// The RPC protocol carries the editor's calls over a Unix socket without
+// HTTP. Every message in either direction is a frame: a 4-byte big-endian
+// length followed by that many bytes of JSON. A request is
+//
+//	{"id": 7, "method": "complete", "params": {...}}
+//
+// and is answered by a frame with the same id holding either "result" or
+// "error" and an HTTP-style "status". Streaming methods first send any
+// number of {"id": 7, "event": "token", "result": {...}} frames. Requests
+// on one connection run concurrently, and {"method": "cancel", "params":
+// {"id": 7}} abandons request 7; closing the connection abandons them all.
+
+// maxRPCFrame bounds the size of a frame, which must hold a whole document
+// when it is opened.
+const maxRPCFrame = 64 << 20
+
+type rpcRequest struct {
+	ID     uint64          `json:"id"`
+	Method string          `json:"method"`
+	Params json.RawMessage `json:"params"`
+}
+
+type rpcResponse struct {
+	ID     uint64 `json:"id"`
+	Event  string `json:"event,omitempty"`
+	Result any    `json:"result,omitempty"`
+	Error  string `json:"error,omitempty"`
+	Status int    `json:"status,omitempty"`
+}
+
+// rpcError is an error with the HTTP status it would have had.
+type rpcError struct {
+	status int
+	err    error
+}
+
+func (e *rpcError) Error() string { return e.err.Error() }
+
+// serveRPC accepts RPC connections on a Unix socket at path until ctx is
+// done. A stale socket file from an earlier run is replaced, but not one
+// another server is still listening on. The socket is only accessible to the
+// current user. With a positive idleTimeout, it also stops once it has had
+// no connections for that long, so a backend shared by several editor
+// windows goes away with the last of them. It removes the socket and returns
+// nil when it stops, or the error if the listener fails.
+func serveRPC(ctx context.Context, path string, workspaces *completer.Workspaces, idleTimeout time.Duration) error {
+	listener, err := listenRPC(path)
+	if err != nil {
+		return err
+	}
+	log.InfoLogger.Printf("🔌 Listening for RPC on %s", path)
+
+	ctx, stop := context.WithCancel(ctx)
+	defer stop()
+	closed := make(chan struct{})
+	go func() {
+		defer close(closed)
+		<-ctx.Done()
+		// A server starting meanwhile finds this one still listening rather
+		// than having its new socket removed.
+		if unlock, err := lockSocket(path); err == nil {
+			defer unlock()
+		}
+		listener.Close() // Also removes the socket
+	}()
+
+	idle := newIdleExit(idleTimeout, stop)
+	for {
+		conn, err := listener.Accept()
+		if err != nil {
+			stopped := ctx.Err() != nil
+			stop()
+			<-closed
+			if stopped {
+				return nil
+			}
+			return err
+		}
+		idle.connected()
+		go func() {
+			defer idle.disconnected()
+			newRPCConn(conn, workspaces).serve()
+		}()
+	}
+}
+
+// listenRPC replaces a stale socket at path and listens on it, holding the
+// socket's lock so that a server starting at the same time cannot remove
+// the socket in between. The socket must be in a directory only the current
+// user can reach, so nobody else can connect before its permissions are
+// restricted.
+func listenRPC(path string) (net.Listener, error) {
+	if err := checkSocketDir(filepath.Dir(path)); err != nil {
+		return nil, err
+	}
+	unlock, err := lockSocket(path)
+	if err != nil {
+		return nil, fmt.Errorf("could not lock socket %s: %w", path, err)
+	}
+	defer unlock()
+
+	if conn, err := net.Dial("unix", path); err == nil {
+		conn.Close()
+		return nil, fmt.Errorf("another server is already listening on %s", path)
+	}
+	if err := os.Remove(path); err != nil && !errors.Is(err, os.ErrNotExist) {
+		return nil, fmt.Errorf("could not remove stale socket %s: %w", path, err)
+	}
+	listener, err := net.Listen("unix", path)
+	if err != nil {
+		return nil, err
+	}
+	if err := os.Chmod(path, 0o600); err != nil {
+		listener.Close()
+		return nil, err
+	}
+	return listener, nil
+}
+
+// idleExit stops the server when no client has been connected for a while.
+type idleExit struct {
+	timeout time.Duration
+	stop    func()
+
+	mu    sync.Mutex
+	conns int
+	timer *time.Timer
+}
+
+func newIdleExit(timeout time.Duration, stop func()) *idleExit {
+	idle := &idleExit{timeout: timeout, stop: stop}
+	if timeout > 0 {
+		idle.timer = time.AfterFunc(timeout, idle.exit)
+	}
+	return idle
+}
+
+func (i *idleExit) connected() {
+	i.mu.Lock()
+	defer i.mu.Unlock()
+	i.conns++
+	if i.timer != nil {
+		i.timer.Stop()
+	}
+}
+
+func (i *idleExit) disconnected() {
+	i.mu.Lock()
+	defer i.mu.Unlock()
+	i.conns--
+	if i.timer != nil && i.conns == 0 {
+		i.timer.Reset(i.timeout)
+	}
+}
+
+func (i *idleExit) exit() {
+	i.mu.Lock()
+	defer i.mu.Unlock()
+	if i.conns > 0 {
+		return
+	}
+	log.InfoLogger.Printf("💤 No clients for %s; exiting", i.timeout)
+	i.stop()
+}
+
+// rpcConn is one editor connection.
+type rpcConn struct {
+	conn       net.Conn
+	workspaces *completer.Workspaces
+
+	writeMu sync.Mutex
+	writer  *bufio.Writer
+
+	mu       sync.Mutex
+	inflight map[uint64]context.CancelFunc
+}
+
+func newRPCConn(conn net.Conn, workspaces *completer.Workspaces) *rpcConn {
+	return &rpcConn{
+		conn:       conn,
+		workspaces: workspaces,
+		writer:     bufio.NewWriter(conn),
+		inflight:   make(map[uint64]context.CancelFunc),
+	}
+}
+
+func (c *rpcConn) serve() {
+	ctx, cancel := context.WithCancel(context.Background())
+	defer cancel()
+	defer c.conn.Close()
+
+	reader := bufio.NewReader(c.conn)
+	var header [4]byte
+	for {
+		if _, err := io.ReadFull(reader, header[:]); err != nil {
+			if !errors.Is(err, io.EOF) {
+				log.ErrorLogger.Printf("⚠️ RPC read failed: %v", err)
+			}
+			return
+		}
+		size := binary.BigEndian.Uint32(header[:])
+		if size > maxRPCFrame {
+			log.ErrorLogger.Printf("⚠️ RPC frame of %d bytes is too large; closing connection", size)
+			return
+		}
+		frame := make([]byte, size)
+		if _, err := io.ReadFull(reader, frame); err != nil {
+			log.ErrorLogger.Printf("⚠️ RPC read failed: %v", err)
+			return
+		}
+		var req rpcRequest
+		if err := json.Unmarshal(frame, &req); err != nil {
+			log.ErrorLogger.Printf("⚠️ Malformed RPC request: %v", err)
+			return
+		}
+
+		if req.Method == "cancel" {
+			var params struct {
+				ID uint64 `json:"id"`
+			}
+			if err := json.Unmarshal(req.Params, &params); err == nil {
+				c.cancel(params.ID)
+			}
+			continue
+		}
+
+		reqCtx, reqCancel := context.WithCancel(ctx)
+		c.mu.Lock()
+		c.inflight[req.ID] = reqCancel
+		c.mu.Unlock()
+		go func() {
+			defer c.cancel(req.ID)
+			result, err := c.call(reqCtx, req)
+			c.reply(req.ID, result, err)
+		}()
+	}
+}
+
+func (c *rpcConn) cancel(id uint64) {
+	c.mu.Lock()
+	cancel := c.inflight[id]
+	delete(c.inflight, id)
+	c.mu.Unlock()
+	if cancel != nil {
+		cancel()
+	}
+}
+
+// call runs one request and returns its result.
+func (c *rpcConn) call(ctx context.Context, req rpcRequest) (any, error) {
+	switch req.Method {
+	case "index":
+		var params struct {
+			Path string `json:"path"`
+		}
+		if err := decodeParams(req.Params, &params); err != nil {
+			return nil, err
+		}
+		path, err := c.workspaces.Index(params.Path)
+		if err != nil {
+			return nil, err
+		}
+		return map[string]string{"message": "Indexing started for directory: " + path}, nil
+
+	case "indexFile":
+		var params struct {
+			Path string `json:"path"`
+		}
+		if err := decodeParams(req.Params, &params); err != nil {
+			return nil, err
+		}
+		indexFileAsync(c.workspaces, params.Path)
+		return map[string]string{"message": "Indexing started for file: " + params.Path}, nil
+
+	case "indexStatus":
+		return map[string]any{"workspaces": c.workspaces.IndexStatus()}, nil
+
+	case "deleteFile":
+		var params struct {
+			Path string `json:"path"`
+		}
+		if err := decodeParams(req.Params, &params); err != nil {
+			return nil, err
+		}
+		service, release, err := c.acquire(params.Path)
+		if err != nil {
+			return nil, err
+		}
+		defer release()
+		if err := service.DeleteFile(params.Path); err != nil {
+			return nil, &rpcError{http.StatusInternalServerError, err}
+		}
+		return map[string]string{"message": "Deletion completed for file: " + params.Path}, nil
+
+	case "openDocument":
+		var params struct {
+			FilePath string `json:"file_path"`
+			Version  int    `json:"version"`
+			Text     string `json:"text"`
+		}
+		if err := decodeParams(req.Params, &params); err != nil {
+			return nil, err
+		}
+		service, release, err := c.acquire(params.FilePath)
+		if err != nil {
+			return nil, err
+		}
+		defer release()
+		service.OpenDocument(params.FilePath, params.Version, params.Text)
+		return map[string]int{"version": params.Version}, nil
+
+	case "changeDocument":
+		var params struct {
+			FilePath    string                   `json:"file_path"`
+			BaseVersion int                      `json:"base_version"`
+			Version     int                      `json:"version"`
+			Changes     []completer.DocumentEdit `json:"changes"`
+		}
+		if err := decodeParams(req.Params, &params); err != nil {
+			return nil, err
+		}
+		service, release, err := c.acquire(params.FilePath)
+		if err != nil {
+			return nil, err
+		}
+		defer release()
+		if err := service.ChangeDocument(params.FilePath, params.BaseVersion, params.Version, params.Changes); err != nil {
+			return nil, &rpcError{documentErrorStatus(err), err}
+		}
+		return map[string]int{"version": params.Version}, nil
+
+	case "closeDocument":
+		var params struct {
+			FilePath string `json:"file_path"`
+		}
+		if err := decodeParams(req.Params, &params); err != nil {
+			return nil, err
+		}
+		service, release, err := c.acquire(params.FilePath)
+		if err != nil {
+			return nil, err
+		}
+		defer release()
+		service.CloseDocument(params.FilePath)
+		return map[string]string{}, nil
+
+	case "complete", "completeStream":
+		var params struct {
+			FilePath string `json:"file_path"`
+			Content  string `json:"content"`
+			Version  int    `json:"version"`
+			Offset   int    `json:"offset"`
+		}
+		if err := decodeParams(req.Params, &params); err != nil {
+			return nil, err
+		}
+		service, release, err := c.acquire(params.FilePath)
+		if err != nil {
+			return nil, err
+		}
+		defer release()
+		// The text before the cursor is either sent along or taken from a
+		// version of a mirrored document.
+		content := params.Content
+		if content == "" {
+			content, err = service.DocumentPrefix(params.FilePath, params.Version, params.Offset)
+			if err != nil {
+				return nil, &rpcError{documentErrorStatus(err), err}
+			}
+		}
+		if req.Method == "complete" {
+			completion, err := service.GetCompletion(ctx, params.FilePath, content)
+			if errors.Is(err, completer.ErrSuperseded) || errors.Is(err, context.Canceled) {
+				completion, err = "", nil
+			}
+			if err != nil {
+				log.ErrorLogger.Printf("Failed to get completion: %v", err)
+				return nil, &rpcError{http.StatusInternalServerError, errors.New("failed to generate completion")}
+			}
+			return map[string]string{"completion": completion}, nil
+		}
+
+		tokens := make(chan string)
+		streamErr := make(chan error, 1)
+		go func() { streamErr <- service.GetCompletionStream(ctx, params.FilePath, content, tokens) }()
+		for token := range tokens {
+			if err := c.send(rpcResponse{ID: req.ID, Event: "token", Result: map[string]string{"text": token}}); err != nil {
+				for range tokens {
+				}
+				return nil, err
+			}
+		}
+		err = <-streamErr
+		if errors.Is(err, completer.ErrSuperseded) || errors.Is(err, context.Canceled) {
+			err = nil
+		}
+		if err != nil {
+			log.ErrorLogger.Printf("Failed to stream completion: %v", err)
+			return nil, &rpcError{http.StatusInternalServerError, errors.New("failed to generate completion")}
+		}
+		return map[string]string{}, nil
+
+	default:
+		return nil, &rpcError{http.StatusNotFound, fmt.Errorf("unknown method %q", req.Method)}
+	}
+}
+
+// acquire returns the service of the workspace of path.
+func (c *rpcConn) acquire(path string) (*completer.CompletionService, func(), error) {
+	service, release, err := c.workspaces.Acquire(path)
+	if err != nil {
+		return nil, nil, &rpcError{http.StatusInternalServerError, err}
+	}
+	return service, release, nil
+}
+
+func decodeParams(params json.RawMessage, into any) error {
+	if err := json.Unmarshal(params, into); err != nil {
+		return &rpcError{http.StatusBadRequest, err}
+	}
+	return nil
+}
+
+func (c *rpcConn) reply(id uint64, result any, err error) {
+	response := rpcResponse{ID: id, Result: result, Status: http.StatusOK}
+	if err != nil {
+		response.Result = nil
+		response.Error = err.Error()
+		response.Status = http.StatusInternalServerError
+		var rpcErr *rpcError
+		if errors.As(err, &rpcErr) {
+			response.Status = rpcErr.status
+		}
+	}
+	if err := c.send(response); err != nil {
+		log.ErrorLogger.Printf("⚠️ RPC write failed: %v", err)
+	}
+}
+
+// send writes one frame; frames of concurrent requests are interleaved
+// whole.
+func (c *rpcConn) send(response rpcResponse) error {
+	body, err := json.Marshal(response)
+	if err != nil {
+		return err
+	}
+	var header [4]byte
+	binary.BigEndian.PutUint32(header[:], uint32(len(body)))
+
+	c.writeMu.Lock()
+	defer c.writeMu.Unlock()
+	if _, err := c.writer.Write(header[:]); err != nil {
+		return err
+	}
+	if _, err := c.writer.Write(body); err != nil {
+		return err
+	}
+	return c.writer.Flush()
+}
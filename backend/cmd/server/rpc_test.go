@@ -0,0 +1,197 @@
+package main
+
+import (
+	"autocomplete/backend/internal/completer"
+	"context"
+	"encoding/binary"
+	"encoding/json"
+	"errors"
+	"io"
+	"net"
+	"net/http"
+	"os"
+	"path/filepath"
+	"strings"
+	"testing"
+	"time"
+)
+
+func TestListenRPCRequiresPrivateDirectory(t *testing.T) {
+	dir := t.TempDir()
+	if err := os.Chmod(dir, 0o755); err != nil {
+		t.Fatal(err)
+	}
+	if listener, err := listenRPC(filepath.Join(dir, "backend.sock")); err == nil {
+		listener.Close()
+		t.Fatal("listenRPC accepted a directory other users can enter")
+	}
+}
+
+// privateDir returns a temporary directory only the current user can enter.
+func privateDir(t *testing.T) string {
+	dir := t.TempDir()
+	if err := os.Chmod(dir, 0o700); err != nil {
+		t.Fatal(err)
+	}
+	return dir
+}
+
+func TestServeRPCStopsWhenIdle(t *testing.T) {
+	path := filepath.Join(privateDir(t), "backend.sock")
+	served := make(chan error, 1)
+	go func() { served <- serveRPC(context.Background(), path, nil, 200*time.Millisecond) }()
+
+	var conn net.Conn
+	deadline := time.Now().Add(5 * time.Second)
+	for {
+		var err error
+		if conn, err = net.Dial("unix", path); err == nil {
+			break
+		}
+		select {
+		case err := <-served:
+			t.Fatalf("serveRPC failed: %v", err)
+		default:
+		}
+		if time.Now().After(deadline) {
+			t.Fatalf("server did not start listening: %v", err)
+		}
+		time.Sleep(5 * time.Millisecond)
+	}
+	info, err := os.Stat(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if perm := info.Mode().Perm(); perm != 0o600 {
+		t.Fatalf("socket permissions are %o, want 600", perm)
+	}
+	if listener, err := listenRPC(path); err == nil {
+		listener.Close()
+		t.Fatal("a second server replaced a live socket")
+	} else if !strings.Contains(err.Error(), "already listening") {
+		t.Fatalf("second listenRPC failed with %v", err)
+	}
+
+	// The server stays while a client is connected and stops once it has
+	// been gone for the idle timeout.
+	select {
+	case err := <-served:
+		t.Fatalf("server stopped with a client connected: %v", err)
+	case <-time.After(400 * time.Millisecond):
+	}
+	conn.Close()
+	select {
+	case err := <-served:
+		if err != nil {
+			t.Fatalf("serveRPC returned %v when idle", err)
+		}
+	case <-time.After(5 * time.Second):
+		t.Fatal("server did not stop when idle")
+	}
+	if _, err := os.Stat(path); !os.IsNotExist(err) {
+		t.Fatalf("socket left behind after stopping: %v", err)
+	}
+}
+
+// writeFrame sends v as one RPC frame, a byte at a time so the server has to
+// reassemble it.
+func writeFrame(t *testing.T, conn net.Conn, v any) {
+	t.Helper()
+	body, err := json.Marshal(v)
+	if err != nil {
+		t.Fatal(err)
+	}
+	frame := binary.BigEndian.AppendUint32(nil, uint32(len(body)))
+	for _, b := range append(frame, body...) {
+		if _, err := conn.Write([]byte{b}); err != nil {
+			t.Fatal(err)
+		}
+	}
+}
+
+// testResponse is an RPC response as the client decodes it.
+type testResponse struct {
+	ID     uint64          `json:"id"`
+	Result json.RawMessage `json:"result"`
+	Error  string          `json:"error"`
+	Status int             `json:"status"`
+}
+
+func readFrame(t *testing.T, conn net.Conn) testResponse {
+	t.Helper()
+	var header [4]byte
+	if _, err := io.ReadFull(conn, header[:]); err != nil {
+		t.Fatal(err)
+	}
+	body := make([]byte, binary.BigEndian.Uint32(header[:]))
+	if _, err := io.ReadFull(conn, body); err != nil {
+		t.Fatal(err)
+	}
+	var response testResponse
+	if err := json.Unmarshal(body, &response); err != nil {
+		t.Fatalf("malformed response %q: %v", body, err)
+	}
+	return response
+}
+
+// startRPCConn serves one RPC connection over a pipe and returns the client
+// end and a channel closed when the server is done with it.
+func startRPCConn(t *testing.T) (net.Conn, <-chan struct{}) {
+	client, server := net.Pipe()
+	t.Cleanup(func() { client.Close() })
+	noService := func() (*completer.CompletionService, error) { return nil, errors.New("no workspaces in this test") }
+	workspaces := completer.NewWorkspaces(noService, 3, 1)
+	t.Cleanup(func() { workspaces.Close() })
+	done := make(chan struct{})
+	go func() {
+		defer close(done)
+		newRPCConn(server, workspaces).serve()
+	}()
+	return client, done
+}
+
+func TestRPCConnAnswersFramedRequestsByID(t *testing.T) {
+	conn, _ := startRPCConn(t)
+	writeFrame(t, conn, map[string]any{"id": 1, "method": "unknown"})
+	writeFrame(t, conn, map[string]any{"id": 2, "method": "index", "params": map[string]any{"path": 5}})
+	writeFrame(t, conn, map[string]any{"id": 3, "method": "indexStatus"})
+
+	// Requests run concurrently, so responses may come in any order.
+	responses := make(map[uint64]testResponse)
+	for i := 0; i < 3; i++ {
+		response := readFrame(t, conn)
+		responses[response.ID] = response
+	}
+	if r := responses[1]; r.Status != http.StatusNotFound || !strings.Contains(r.Error, "unknown") {
+		t.Errorf("unknown method answered with %+v", r)
+	}
+	if r := responses[2]; r.Status != http.StatusBadRequest || r.Error == "" {
+		t.Errorf("malformed params answered with %+v", r)
+	}
+	if r := responses[3]; r.Status != http.StatusOK || r.Error != "" || string(r.Result) != `{"workspaces":[]}` {
+		t.Errorf("indexStatus answered with %+v", r)
+	}
+}
+
+func TestRPCConnClosesOnBadFrames(t *testing.T) {
+	frames := map[string][]byte{
+		"oversized frame": binary.BigEndian.AppendUint32(nil, maxRPCFrame+1),
+		"malformed JSON":  append(binary.BigEndian.AppendUint32(nil, 5), "{id:1"...),
+	}
+	for name, frame := range frames {
+		t.Run(name, func(t *testing.T) {
+			conn, done := startRPCConn(t)
+			if _, err := conn.Write(frame); err != nil {
+				t.Fatal(err)
+			}
+			select {
+			case <-done:
+			case <-time.After(5 * time.Second):
+				t.Fatal("connection kept open")
+			}
+			if _, err := conn.Read(make([]byte, 1)); err == nil {
+				t.Fatal("read from a closed connection succeeded")
+			}
+		})
+	}
+}
@@ -0,0 +1,15 @@
+//go:build !unix
+
+package main
+
+// lockSocket is a no-op where advisory file locks are unavailable; only one
+// server should then be started at a time.
+func lockSocket(path string) (func(), error) {
+	return func() {}, nil
+}
+
+// checkSocketDir accepts any directory where file ownership cannot be
+// checked; the socket's own permissions still apply.
+func checkSocketDir(dir string) error {
+	return nil
+}
@@ -5,6 +5,7 @@ import "sync"
 // EmbeddingCache defines a simple interface for storing and retrieving embeddings.
 type EmbeddingCache interface {
 	// Get returns the embedding for the given key and whether it was found.
+	// Implementations may return shared storage, so callers must not modify it.
 	Get(key string) ([]float32, bool)
 	// Set stores the embedding for the given key.
 	Set(key string, embedding []float32)
@@ -1,21 +1,61 @@
 package cache
 
 import (
-	"crypto/sha256"
+	"encoding/binary"
 	"encoding/hex"
-	"fmt"
+	"strconv"
 )
 
-// ComputeKey generates a deterministic cache key for a given file path and content.
-// It concatenates the file path and chunk content with a separator, hashes the result
-// using SHA-256, and returns the hex-encoded string.
-func ComputeKey(filePath, chunkContent string) string {
-	// Combine file path and content to form the input for key generation.
-	input := fmt.Sprintf("%s:%s", filePath, chunkContent)
+// KeyMode selects what identifies a chunk in the embedding cache.
+type KeyMode string
 
-	// Compute SHA-256 hash of the combined input.
-	sum := sha256.Sum256([]byte(input))
+const (
+	// KeyByContent keys chunks by their text alone, so moved, renamed or
+	// duplicated code reuses the same embedding.
+	KeyByContent KeyMode = "content"
+	// KeyByPath also mixes in the file path, keeping identical chunks in
+	// different files apart.
+	KeyByPath KeyMode = "path"
+)
+
+// keySeedSalt keeps the two 64-bit halves of a key independent.
+const keySeedSalt uint64 = 0x9e3779b97f4a7c15
+
+// Keyer computes embedding cache keys. Keys are 128-bit xxHash64 digests
+// seeded with the embedding model and dimensions, so embeddings from
+// different models never collide.
+type Keyer struct {
+	mode KeyMode
+	seed uint64
+}
+
+// NewKeyer returns a Keyer for the given mode and embedding model.
+func NewKeyer(mode KeyMode, modelID string, dimensions int) Keyer {
+	d := newXXDigest(0)
+	d.writeString(modelID)
+	d.writeString("\x00")
+	d.writeString(strconv.Itoa(dimensions))
+	return Keyer{mode: mode, seed: d.sum64()}
+}
+
+// Key returns the cache key for a chunk of filePath. The path is ignored in
+// KeyByContent mode.
+func (k Keyer) Key(filePath, chunkContent string) string {
+	var sum [16]byte
+	binary.BigEndian.PutUint64(sum[:8], k.hash(k.seed, filePath, chunkContent))
+	binary.BigEndian.PutUint64(sum[8:], k.hash(k.seed^keySeedSalt, filePath, chunkContent))
+
+	var key [32]byte
+	hex.Encode(key[:], sum[:])
+	return string(key[:])
+}
 
-	// Return the hex-encoded representation of the hash.
-	return hex.EncodeToString(sum[:])
+func (k Keyer) hash(seed uint64, filePath, chunkContent string) uint64 {
+	d := newXXDigest(seed)
+	if k.mode == KeyByPath {
+		d.writeString(filePath)
+		d.writeString("\x00")
+	}
+	d.writeString(chunkContent)
+	return d.sum64()
 }
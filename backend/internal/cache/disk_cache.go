@@ -0,0 +1,459 @@
+package cache
+
+import (
+	"bufio"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"hash/crc32"
+	"io"
+	"math"
+	"os"
+	"path/filepath"
+	"sort"
+	"sync"
+	"time"
+
+	"autocomplete/backend/internal/log"
+)
+
+const (
+	diskCacheLogName  = "embeddings.log"
+	diskCacheLockName = "embeddings.lock"
+	diskCacheMagic    = "ACEMB01\n"
+
+	// Each record is: key length (uint32), dimensions (uint32), key bytes,
+	// little-endian float32 values, CRC-32 of everything before it.
+	recordHeaderSize  = 8
+	recordTrailerSize = 4
+)
+
+// diskEntry locates the latest record for a key in the log.
+type diskEntry struct {
+	offset  int64
+	size    int64
+	lastUse uint64
+}
+
+// logFile is an open handle on the log. Get reads through it after
+// releasing the cache mutex, so it counts its readers and is only closed
+// once they are done.
+type logFile struct {
+	*os.File
+	readers sync.WaitGroup
+}
+
+// close waits for readers of the handle and closes it. The cache mutex must
+// be held, so no reader can take a new reference meanwhile.
+func (f *logFile) close() error {
+	f.readers.Wait()
+	return f.File.Close()
+}
+
+// DiskCache is an EmbeddingCache persisted as an append-only log, so
+// embeddings survive restarts and are shared by every workspace and server
+// process using the same model. Keys are namespaced by the embedding model
+// id. When the log outgrows its size cap it is compacted, keeping the most
+// recently used entries.
+//
+// Several processes may share one log: appends and compaction are serialized
+// with a lock file, and each process picks up records written by others
+// before reporting a miss. A process that compacts appends a marker to the
+// log it replaces, so the others notice by the size of their own handle.
+type DiskCache struct {
+	mu       sync.Mutex
+	dir      string
+	modelID  string
+	maxBytes int64
+	lock     *fileLock
+
+	file       *logFile
+	readOffset int64 // End of the log as replayed by this process
+	entries    map[string]*diskEntry
+	liveBytes  int64
+	useClock   uint64
+
+	// logSize and logModTime are the log's as of the last sync; the log
+	// is only looked at again once they change.
+	logSize    int64
+	logModTime time.Time
+}
+
+// NewDiskCache opens (or creates) the embedding log in dir for the given
+// model id. maxBytes caps the log size; older entries are compacted away.
+func NewDiskCache(dir, modelID string, maxBytes int64) (*DiskCache, error) {
+	if err := os.MkdirAll(dir, 0o755); err != nil {
+		return nil, fmt.Errorf("failed to create embedding cache directory: %w", err)
+	}
+	lock, err := openFileLock(filepath.Join(dir, diskCacheLockName))
+	if err != nil {
+		return nil, fmt.Errorf("failed to open embedding cache lock: %w", err)
+	}
+	c := &DiskCache{
+		dir:      dir,
+		modelID:  modelID,
+		maxBytes: maxBytes,
+		lock:     lock,
+	}
+
+	if err := lock.lock(); err != nil {
+		lock.close()
+		return nil, fmt.Errorf("failed to lock embedding cache: %w", err)
+	}
+	defer lock.unlock()
+
+	if err := c.reopen(); err == nil {
+		err = c.dropTornTail()
+	}
+	if err != nil {
+		if c.file != nil {
+			c.file.Close()
+		}
+		lock.close()
+		return nil, err
+	}
+
+	log.InfoLogger.Printf("💽 Embedding cache opened at %s (%d entries, %d MB)", c.logPath(), len(c.entries), c.readOffset>>20)
+	return c, nil
+}
+
+// Get returns the embedding stored for key under this cache's model.
+func (c *DiskCache) Get(key string) ([]float32, bool) {
+	namespaced := c.namespaced(key)
+
+	c.mu.Lock()
+	entry, found := c.entries[namespaced]
+	if !found {
+		// Another process may have embedded it, or compacted the log,
+		// since we last looked.
+		if err := c.syncWithLog(false); err != nil {
+			log.ErrorLogger.Printf("⚠️ Embedding cache catch-up failed: %v", err)
+		}
+		entry, found = c.entries[namespaced]
+	}
+	if !found {
+		c.mu.Unlock()
+		return nil, false
+	}
+	c.useClock++
+	entry.lastUse = c.useClock
+	file, offset, size := c.file, entry.offset, entry.size
+	file.readers.Add(1)
+	c.mu.Unlock()
+
+	record := make([]byte, size)
+	_, err := file.ReadAt(record, offset)
+	file.readers.Done()
+	if err != nil {
+		log.ErrorLogger.Printf("⚠️ Embedding cache read failed: %v", err)
+		return nil, false
+	}
+	recordKey, embedding, err := decodeRecord(record)
+	if err != nil || recordKey != namespaced {
+		log.ErrorLogger.Printf("⚠️ Embedding cache record for %s is corrupt", key)
+		return nil, false
+	}
+	return embedding, true
+}
+
+// Set appends the embedding for key under this cache's model.
+func (c *DiskCache) Set(key string, embedding []float32) {
+	namespaced := c.namespaced(key)
+	record := encodeRecord(namespaced, embedding)
+
+	c.mu.Lock()
+	defer c.mu.Unlock()
+
+	if err := c.lock.lock(); err != nil {
+		log.ErrorLogger.Printf("⚠️ Failed to lock embedding cache: %v", err)
+		return
+	}
+	defer c.lock.unlock()
+
+	// A replaced log without a marker would take our record with it, so
+	// look at the path even if our handle is unchanged.
+	if err := c.syncWithLog(true); err != nil {
+		log.ErrorLogger.Printf("⚠️ Embedding cache sync failed: %v", err)
+		return
+	}
+	if err := c.dropTornTail(); err != nil {
+		log.ErrorLogger.Printf("⚠️ Embedding cache repair failed: %v", err)
+		return
+	}
+	offset := c.readOffset
+	if _, err := c.file.Write(record); err != nil {
+		log.ErrorLogger.Printf("⚠️ Embedding cache write failed: %v", err)
+		return
+	}
+	c.readOffset += int64(len(record))
+	c.index(namespaced, offset, int64(len(record)))
+	if err := c.statLog(); err != nil {
+		log.ErrorLogger.Printf("⚠️ Embedding cache stat failed: %v", err)
+	}
+
+	if c.maxBytes > 0 && c.readOffset > c.maxBytes {
+		if err := c.compact(); err != nil {
+			log.ErrorLogger.Printf("⚠️ Embedding cache compaction failed: %v", err)
+		}
+	}
+}
+
+// Close releases the log and lock files.
+func (c *DiskCache) Close() error {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	c.lock.close()
+	return c.file.close()
+}
+
+func (c *DiskCache) namespaced(key string) string {
+	return c.modelID + ":" + key
+}
+
+func (c *DiskCache) logPath() string {
+	return filepath.Join(c.dir, diskCacheLogName)
+}
+
+// index records that the latest value for key lives at offset.
+func (c *DiskCache) index(key string, offset, size int64) {
+	if previous, found := c.entries[key]; found {
+		c.liveBytes -= previous.size
+	}
+	c.useClock++
+	c.entries[key] = &diskEntry{offset: offset, size: size, lastUse: c.useClock}
+	c.liveBytes += size
+}
+
+// reopen opens the log from scratch and replays it. c.mu must be held.
+func (c *DiskCache) reopen() error {
+	if c.file != nil {
+		c.file.close()
+	}
+	file, err := os.OpenFile(c.logPath(), os.O_RDWR|os.O_CREATE|os.O_APPEND, 0o644)
+	if err != nil {
+		return fmt.Errorf("failed to open embedding cache log: %w", err)
+	}
+	c.file = &logFile{File: file}
+	c.entries = make(map[string]*diskEntry)
+	c.liveBytes = 0
+	c.readOffset = 0
+	c.logSize, c.logModTime = 0, time.Time{}
+
+	info, err := file.Stat()
+	if err != nil {
+		return err
+	}
+	if info.Size() == 0 {
+		if _, err := file.Write([]byte(diskCacheMagic)); err != nil {
+			return fmt.Errorf("failed to initialize embedding cache log: %w", err)
+		}
+		if info, err = file.Stat(); err != nil {
+			return err
+		}
+	} else {
+		magic := make([]byte, len(diskCacheMagic))
+		if _, err := file.ReadAt(magic, 0); err != nil || string(magic) != diskCacheMagic {
+			return fmt.Errorf("embedding cache log %s has an unknown format", c.logPath())
+		}
+	}
+	c.readOffset = int64(len(diskCacheMagic))
+	c.catchUp(info)
+	return nil
+}
+
+// syncWithLog replays records appended since we last read, reopening the log
+// if another process compacted it. Unless checkPath is set, a log whose
+// handle has the size and modification time of the last sync is taken as
+// unchanged, which costs a single fstat. c.mu must be held.
+func (c *DiskCache) syncWithLog(checkPath bool) error {
+	current, err := c.file.Stat()
+	if err != nil {
+		return err
+	}
+	if !checkPath && current.Size() == c.logSize && current.ModTime().Equal(c.logModTime) {
+		return nil
+	}
+	onDisk, err := os.Stat(c.logPath())
+	if err != nil || !os.SameFile(current, onDisk) {
+		return c.reopen()
+	}
+	c.catchUp(current)
+	return nil
+}
+
+// catchUp replays complete records past readOffset in the log described by
+// info. It stops at a partial or corrupt record: another process may be
+// mid-append, or may have crashed there, which dropTornTail repairs. c.mu
+// must be held.
+func (c *DiskCache) catchUp(info os.FileInfo) {
+	c.logSize, c.logModTime = info.Size(), info.ModTime()
+	if info.Size() <= c.readOffset {
+		return
+	}
+
+	reader := bufio.NewReader(io.NewSectionReader(c.file, c.readOffset, info.Size()-c.readOffset))
+	for {
+		key, size, err := readRecord(reader)
+		if err != nil {
+			return // End of log or incomplete tail
+		}
+		if key != "" { // Compaction markers carry no entry
+			c.index(key, c.readOffset, size)
+		}
+		c.readOffset += size
+	}
+}
+
+// statLog records the current size and modification time of the log after
+// this process changed it. c.mu must be held.
+func (c *DiskCache) statLog() error {
+	info, err := c.file.Stat()
+	if err != nil {
+		return err
+	}
+	c.logSize, c.logModTime = info.Size(), info.ModTime()
+	return nil
+}
+
+// dropTornTail truncates whatever follows the last valid record: with the
+// lock file held nobody else is appending, so it is a record torn by a
+// process that crashed mid-append. Left in place, it would hide every record
+// appended after it from other processes. c.mu and the lock file must be
+// held, and the log synced.
+func (c *DiskCache) dropTornTail() error {
+	if c.logSize <= c.readOffset {
+		return nil
+	}
+	log.ErrorLogger.Printf("⚠️ Dropping %d bytes of torn records from the embedding cache log", c.logSize-c.readOffset)
+	if err := c.file.Truncate(c.readOffset); err != nil {
+		return fmt.Errorf("failed to truncate embedding cache log: %w", err)
+	}
+	return c.statLog()
+}
+
+// compact rewrites the log with the most recently used entries until it is
+// back under three quarters of the cap. Survivors are written least recently
+// used first: replaying the log assigns recency in file order, so the
+// compacted log keeps the order in which entries were used. c.mu and the
+// lock file must be held.
+func (c *DiskCache) compact() error {
+	type liveEntry struct {
+		key string
+		*diskEntry
+	}
+	live := make([]liveEntry, 0, len(c.entries))
+	for key, entry := range c.entries {
+		live = append(live, liveEntry{key, entry})
+	}
+	sort.Slice(live, func(i, j int) bool {
+		if live[i].lastUse != live[j].lastUse {
+			return live[i].lastUse > live[j].lastUse
+		}
+		return live[i].offset > live[j].offset
+	})
+
+	target := c.maxBytes * 3 / 4
+	tmpPath := c.logPath() + ".compact"
+	tmp, err := os.Create(tmpPath)
+	if err != nil {
+		return err
+	}
+	defer os.Remove(tmpPath)
+
+	writer := bufio.NewWriter(tmp)
+	written := int64(len(diskCacheMagic))
+	writer.WriteString(diskCacheMagic)
+	kept := 0
+	for kept < len(live) && written+live[kept].size <= target {
+		written += live[kept].size
+		kept++
+	}
+	for i := kept - 1; i >= 0; i-- {
+		entry := live[i]
+		record := make([]byte, entry.size)
+		if _, err := c.file.ReadAt(record, entry.offset); err != nil {
+			tmp.Close()
+			return err
+		}
+		writer.Write(record)
+	}
+	if err := writer.Flush(); err != nil {
+		tmp.Close()
+		return err
+	}
+	if err := tmp.Sync(); err != nil {
+		tmp.Close()
+		return err
+	}
+	tmp.Close()
+	if err := os.Rename(tmpPath, c.logPath()); err != nil {
+		return err
+	}
+	// Grow the replaced log, so other processes find it changed and look
+	// for the new one.
+	if _, err := c.file.Write(encodeRecord("", nil)); err != nil {
+		log.ErrorLogger.Printf("⚠️ Could not mark the replaced embedding cache log: %v", err)
+	}
+
+	log.InfoLogger.Printf("🧹 Compacted embedding cache: kept %d of %d entries (%d MB)", kept, len(live), written>>20)
+	return c.reopen()
+}
+
+func encodeRecord(key string, embedding []float32) []byte {
+	size := recordHeaderSize + len(key) + 4*len(embedding) + recordTrailerSize
+	record := make([]byte, size)
+	binary.LittleEndian.PutUint32(record[0:], uint32(len(key)))
+	binary.LittleEndian.PutUint32(record[4:], uint32(len(embedding)))
+	copy(record[recordHeaderSize:], key)
+	values := record[recordHeaderSize+len(key):]
+	for i, v := range embedding {
+		binary.LittleEndian.PutUint32(values[4*i:], math.Float32bits(v))
+	}
+	binary.LittleEndian.PutUint32(record[size-recordTrailerSize:], crc32.ChecksumIEEE(record[:size-recordTrailerSize]))
+	return record
+}
+
+func decodeRecord(record []byte) (string, []float32, error) {
+	if len(record) < recordHeaderSize+recordTrailerSize {
+		return "", nil, errors.New("record too short")
+	}
+	keyLen := int(binary.LittleEndian.Uint32(record[0:]))
+	dim := int(binary.LittleEndian.Uint32(record[4:]))
+	if len(record) != recordHeaderSize+keyLen+4*dim+recordTrailerSize {
+		return "", nil, errors.New("record length mismatch")
+	}
+	body := record[:len(record)-recordTrailerSize]
+	if crc32.ChecksumIEEE(body) != binary.LittleEndian.Uint32(record[len(body):]) {
+		return "", nil, errors.New("record checksum mismatch")
+	}
+	values := body[recordHeaderSize+keyLen:]
+	embedding := make([]float32, dim)
+	for i := range embedding {
+		embedding[i] = math.Float32frombits(binary.LittleEndian.Uint32(values[4*i:]))
+	}
+	return string(body[recordHeaderSize : recordHeaderSize+keyLen]), embedding, nil
+}
+
+// readRecord reads and verifies the next record, returning its key and size.
+func readRecord(reader *bufio.Reader) (string, int64, error) {
+	header, err := reader.Peek(recordHeaderSize)
+	if err != nil {
+		return "", 0, err
+	}
+	keyLen := int(binary.LittleEndian.Uint32(header[0:]))
+	dim := int(binary.LittleEndian.Uint32(header[4:]))
+	size := recordHeaderSize + keyLen + 4*dim + recordTrailerSize
+	if keyLen > 1<<16 || dim > 1<<16 {
+		return "", 0, errors.New("implausible record header")
+	}
+
+	record := make([]byte, size)
+	if _, err := io.ReadFull(reader, record); err != nil {
+		return "", 0, err
+	}
+	body := record[:size-recordTrailerSize]
+	if crc32.ChecksumIEEE(body) != binary.LittleEndian.Uint32(record[size-recordTrailerSize:]) {
+		return "", 0, errors.New("record checksum mismatch")
+	}
+	return string(body[recordHeaderSize : recordHeaderSize+keyLen]), int64(size), nil
+}
@@ -0,0 +1,157 @@
+package cache
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+const testDimensions = 16
+
+// testRecordSize is the log size of one test entry: a key of five bytes
+// namespaced with a one-byte model id, and testDimensions values.
+const testRecordSize = recordHeaderSize + len("m:k00") + 4*testDimensions + recordTrailerSize
+
+// testCacheBytes caps a test log at ten entries, so compaction keeps seven.
+const testCacheBytes = int64(len(diskCacheMagic) + 10*testRecordSize)
+
+func testKey(i int) string {
+	return fmt.Sprintf("k%02d", i)
+}
+
+func testEmbedding(i int) []float32 {
+	embedding := make([]float32, testDimensions)
+	for j := range embedding {
+		embedding[j] = float32(i*testDimensions + j)
+	}
+	return embedding
+}
+
+// indexed reports whether c holds key, without marking it used as Get would.
+func indexed(c *DiskCache, key string) bool {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	_, found := c.entries[c.namespaced(key)]
+	return found
+}
+
+func TestDiskCacheKeepsRecencyAcrossCompaction(t *testing.T) {
+	c, err := NewDiskCache(t.TempDir(), "m", testCacheBytes)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer c.Close()
+
+	for i := 0; i < 10; i++ {
+		c.Set(testKey(i), testEmbedding(i))
+	}
+	if _, found := c.Get(testKey(0)); !found {
+		t.Fatalf("%s missing before compaction", testKey(0))
+	}
+
+	// The eleventh entry compacts the log down to the seven most recently
+	// used: k00, just read, and k05 to k10.
+	c.Set(testKey(10), testEmbedding(10))
+	for i := 0; i <= 10; i++ {
+		if want := i == 0 || i >= 5; indexed(c, testKey(i)) != want {
+			t.Fatalf("after first compaction: %s cached = %v, want %v", testKey(i), !want, want)
+		}
+	}
+
+	// Four more entries compact again. k00 was used after k05 to k09, so it
+	// must outlive them rather than be the first one dropped.
+	for i := 11; i <= 14; i++ {
+		c.Set(testKey(i), testEmbedding(i))
+	}
+	for i := 0; i <= 14; i++ {
+		if want := i == 0 || i >= 9; indexed(c, testKey(i)) != want {
+			t.Fatalf("after second compaction: %s cached = %v, want %v", testKey(i), !want, want)
+		}
+	}
+
+	embedding, found := c.Get(testKey(0))
+	if !found || embedding[1] != testEmbedding(0)[1] {
+		t.Fatalf("Get(%s) = %v, %v after compaction", testKey(0), embedding, found)
+	}
+}
+
+func TestDiskCacheCatchesUpWithOtherProcess(t *testing.T) {
+	dir := t.TempDir()
+	writer, err := NewDiskCache(dir, "m", testCacheBytes)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer writer.Close()
+	reader, err := NewDiskCache(dir, "m", 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer reader.Close()
+
+	// Records appended by another process are found on a miss.
+	writer.Set(testKey(0), testEmbedding(0))
+	if embedding, found := reader.Get(testKey(0)); !found || embedding[2] != testEmbedding(0)[2] {
+		t.Fatalf("Get(%s) = %v, %v, want the other process's entry", testKey(0), embedding, found)
+	}
+
+	// The other process compacts down to k04 to k10. The reader still holds
+	// the replaced log and must switch to the new one to find later entries.
+	for i := 1; i <= 12; i++ {
+		writer.Set(testKey(i), testEmbedding(i))
+	}
+	for _, i := range []int{4, 12} {
+		if embedding, found := reader.Get(testKey(i)); !found || embedding[3] != testEmbedding(i)[3] {
+			t.Fatalf("Get(%s) = %v, %v after the other process compacted", testKey(i), embedding, found)
+		}
+	}
+	if _, found := reader.Get(testKey(1)); found {
+		t.Fatalf("Get(%s) found an entry compacted away by the other process", testKey(1))
+	}
+}
+
+func TestDiskCacheRepairsTornTail(t *testing.T) {
+	dir := t.TempDir()
+	writer, err := NewDiskCache(dir, "m", 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer writer.Close()
+	reader, err := NewDiskCache(dir, "m", 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer reader.Close()
+
+	// A third process crashes halfway through appending a record.
+	writer.Set(testKey(0), testEmbedding(0))
+	torn := encodeRecord(writer.namespaced(testKey(1)), testEmbedding(1))
+	logFile, err := os.OpenFile(filepath.Join(dir, diskCacheLogName), os.O_WRONLY|os.O_APPEND, 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if _, err := logFile.Write(torn[:len(torn)/2]); err != nil {
+		t.Fatal(err)
+	}
+	logFile.Close()
+	if _, found := reader.Get(testKey(0)); !found {
+		t.Fatalf("Get(%s) missed the record before the torn one", testKey(0))
+	}
+
+	// Records appended after the crash are found by a process that was
+	// already reading the log, and by one opening it afterwards.
+	writer.Set(testKey(2), testEmbedding(2))
+	if embedding, found := reader.Get(testKey(2)); !found || embedding[1] != testEmbedding(2)[1] {
+		t.Fatalf("Get(%s) = %v, %v after a torn record", testKey(2), embedding, found)
+	}
+	reopened, err := NewDiskCache(dir, "m", 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer reopened.Close()
+	for _, i := range []int{0, 2} {
+		if _, found := reopened.Get(testKey(i)); !found {
+			t.Fatalf("Get(%s) missed after reopening a repaired log", testKey(i))
+		}
+	}
+}
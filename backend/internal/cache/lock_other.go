@@ -0,0 +1,15 @@
+//go:build !unix
+
+package cache
+
+// fileLock is a no-op where advisory file locks are unavailable; the cache
+// is then only safe for a single server process.
+type fileLock struct{}
+
+func openFileLock(path string) (*fileLock, error) {
+	return &fileLock{}, nil
+}
+
+func (l *fileLock) lock() error  { return nil }
+func (l *fileLock) unlock()      {}
+func (l *fileLock) close() error { return nil }
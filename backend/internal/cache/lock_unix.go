@@ -0,0 +1,38 @@
+//go:build unix
+
+package cache
+
+import (
+	"os"
+	"syscall"
+)
+
+// fileLock is an exclusive advisory lock on a lock file, which stays open
+// between uses so taking the lock costs a single system call.
+type fileLock struct {
+	file *os.File
+}
+
+// openFileLock opens the lock file at path, creating it if needed.
+func openFileLock(path string) (*fileLock, error) {
+	file, err := os.OpenFile(path, os.O_RDWR|os.O_CREATE, 0o644)
+	if err != nil {
+		return nil, err
+	}
+	return &fileLock{file: file}, nil
+}
+
+// lock blocks until the lock is held.
+func (l *fileLock) lock() error {
+	return syscall.Flock(int(l.file.Fd()), syscall.LOCK_EX)
+}
+
+// unlock releases the lock.
+func (l *fileLock) unlock() {
+	syscall.Flock(int(l.file.Fd()), syscall.LOCK_UN)
+}
+
+// close closes the lock file, releasing the lock if it is held.
+func (l *fileLock) close() error {
+	return l.file.Close()
+}
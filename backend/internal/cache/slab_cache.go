@@ -0,0 +1,169 @@
+package cache
+
+import (
+	"runtime"
+	"sync"
+	"sync/atomic"
+)
+
+// SlabCache is a bounded in-memory EmbeddingCache for embeddings of one fixed
+// dimension. Embeddings are packed into large per-shard segments rather than
+// one slice per entry, and Get returns a view into its segment without
+// copying, so callers must treat returned embeddings as read-only.
+//
+// Eviction retires whole segments in CLOCK order: when a shard exceeds its
+// share of the byte budget, entries of its oldest segment that were read
+// since being written get a second chance in the newest segment and the rest
+// are dropped. Retired segments are never reused, so views handed out
+// earlier stay valid for as long as callers hold on to them.
+type SlabCache struct {
+	dim    int
+	shards []slabShard
+	mask   uint64
+}
+
+type slabShard struct {
+	mu           sync.RWMutex
+	slots        map[string]slabSlot
+	segments     []*slabSegment // Oldest first; the last one is being filled
+	segmentSlots int
+	maxSegments  int
+	dim          int
+	_            [64]byte // Keep shard locks on separate cache lines
+}
+
+type slabSegment struct {
+	data       []float32
+	keys       []string
+	referenced []atomic.Bool
+	used       int
+}
+
+type slabSlot struct {
+	segment *slabSegment
+	index   int
+}
+
+const (
+	// Each shard aims to hold this many segments, so eviction discards
+	// roughly an eighth of a shard at a time.
+	slabSegmentsPerShard = 8
+	minSlabSegmentSlots  = 16
+	maxSlabSegmentSlots  = 1024
+)
+
+// NewSlabCache returns a cache for embeddings of the given dimension that
+// holds at most about maxBytes of vector data.
+func NewSlabCache(dimensions int, maxBytes int64) *SlabCache {
+	shardCount := 1
+	for shardCount < 4*runtime.GOMAXPROCS(0) {
+		shardCount <<= 1
+	}
+
+	entryBytes := int64(4 * dimensions)
+	segmentSlots := int(maxBytes / int64(shardCount) / slabSegmentsPerShard / entryBytes)
+	segmentSlots = max(minSlabSegmentSlots, min(segmentSlots, maxSlabSegmentSlots))
+	maxSegments := max(2, int(maxBytes/int64(shardCount)/(int64(segmentSlots)*entryBytes)))
+
+	c := &SlabCache{
+		dim:    dimensions,
+		shards: make([]slabShard, shardCount),
+		mask:   uint64(shardCount - 1),
+	}
+	for i := range c.shards {
+		c.shards[i] = slabShard{
+			slots:        make(map[string]slabSlot),
+			segmentSlots: segmentSlots,
+			maxSegments:  maxSegments,
+			dim:          dimensions,
+		}
+	}
+	return c
+}
+
+// Get returns a read-only view of the embedding stored for key.
+func (c *SlabCache) Get(key string) ([]float32, bool) {
+	shard := c.shard(key)
+	shard.mu.RLock()
+	slot, found := shard.slots[key]
+	shard.mu.RUnlock()
+	if !found {
+		return nil, false
+	}
+	slot.segment.referenced[slot.index].Store(true)
+	return slot.segment.view(slot.index, c.dim), true
+}
+
+// Set copies embedding into the cache. Embeddings of the wrong dimension are
+// ignored, and keys already present keep their existing value.
+func (c *SlabCache) Set(key string, embedding []float32) {
+	if len(embedding) != c.dim {
+		return
+	}
+	shard := c.shard(key)
+	shard.mu.Lock()
+	defer shard.mu.Unlock()
+
+	if slot, found := shard.slots[key]; found {
+		slot.segment.referenced[slot.index].Store(true)
+		return
+	}
+	shard.insert(key, embedding)
+}
+
+func (c *SlabCache) shard(key string) *slabShard {
+	return &c.shards[xxHash64String(0, key)&c.mask]
+}
+
+// insert copies embedding into the active segment. s.mu must be held.
+func (s *slabShard) insert(key string, embedding []float32) {
+	segment := s.active()
+	index := segment.used
+	copy(segment.data[index*s.dim:], embedding)
+	segment.keys[index] = key
+	segment.used++
+	s.slots[key] = slabSlot{segment: segment, index: index}
+}
+
+// active returns a segment with a free slot, retiring old segments to stay
+// within budget. s.mu must be held.
+func (s *slabShard) active() *slabSegment {
+	for {
+		if n := len(s.segments); n > 0 && s.segments[n-1].used < s.segmentSlots {
+			return s.segments[n-1]
+		}
+		if len(s.segments) >= s.maxSegments {
+			s.retireOldest()
+			continue
+		}
+		s.segments = append(s.segments, &slabSegment{
+			data:       make([]float32, s.segmentSlots*s.dim),
+			keys:       make([]string, s.segmentSlots),
+			referenced: make([]atomic.Bool, s.segmentSlots),
+		})
+	}
+}
+
+// retireOldest drops the oldest segment, moving entries that were read since
+// they were written into the newest one. Moved entries start unreferenced,
+// so each gets a single second chance. s.mu must be held.
+func (s *slabShard) retireOldest() {
+	oldest := s.segments[0]
+	s.segments[0] = nil
+	s.segments = s.segments[1:]
+
+	for i := 0; i < oldest.used; i++ {
+		key := oldest.keys[i]
+		if oldest.referenced[i].Load() {
+			s.insert(key, oldest.view(i, s.dim))
+		} else {
+			delete(s.slots, key)
+		}
+	}
+}
+
+// view returns the embedding in slot i, capped so appends cannot spill into
+// the neighbouring slot.
+func (seg *slabSegment) view(i, dim int) []float32 {
+	return seg.data[i*dim : (i+1)*dim : (i+1)*dim]
+}
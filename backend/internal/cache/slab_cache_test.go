@@ -0,0 +1,124 @@
+package cache
+
+import (
+	"fmt"
+	"reflect"
+	"testing"
+)
+
+// shardKeys returns n keys that all fall in the first shard of c.
+func shardKeys(c *SlabCache, n int) []string {
+	var keys []string
+	for i := 0; len(keys) < n; i++ {
+		key := fmt.Sprintf("key%d", i)
+		if c.shard(key) == &c.shards[0] {
+			keys = append(keys, key)
+		}
+	}
+	return keys
+}
+
+func TestSlabCacheStoresCopiesAndHandsOutCappedViews(t *testing.T) {
+	c := NewSlabCache(testDimensions, 1<<20)
+	embedding := testEmbedding(1)
+	c.Set("a", embedding)
+	c.Set("b", testEmbedding(2))
+	embedding[0] = -1
+
+	got, found := c.Get("a")
+	if !found || !reflect.DeepEqual(got, testEmbedding(1)) {
+		t.Fatalf("Get(a) = %v, %v, want the embedding as it was set", got, found)
+	}
+	if cap(got) != testDimensions {
+		t.Fatalf("view has capacity %d, want %d", cap(got), testDimensions)
+	}
+	_ = append(got, 42)
+	if b, _ := c.Get("b"); !reflect.DeepEqual(b, testEmbedding(2)) {
+		t.Fatalf("appending to a view changed its neighbour: %v", b)
+	}
+
+	c.Set("a", testEmbedding(3))
+	if got, _ := c.Get("a"); !reflect.DeepEqual(got, testEmbedding(1)) {
+		t.Fatalf("Set of a present key replaced its value with %v", got)
+	}
+	c.Set("short", []float32{1, 2})
+	if _, found := c.Get("short"); found {
+		t.Fatal("an embedding of the wrong dimension was stored")
+	}
+}
+
+func TestSlabCacheGivesReadEntriesASecondChance(t *testing.T) {
+	// The smallest budget: two segments of minSlabSegmentSlots per shard.
+	c := NewSlabCache(testDimensions, 1)
+	shard := &c.shards[0]
+	if shard.segmentSlots != minSlabSegmentSlots || shard.maxSegments != 2 {
+		t.Fatalf("shard holds %d segments of %d slots", shard.maxSegments, shard.segmentSlots)
+	}
+	keys := shardKeys(c, 2*minSlabSegmentSlots+1)
+	for i, key := range keys[:2*minSlabSegmentSlots] {
+		c.Set(key, testEmbedding(i))
+	}
+	kept, _ := c.Get(keys[0])
+
+	// The next entry retires the oldest segment: only the entry read since
+	// it was written survives.
+	c.Set(keys[len(keys)-1], testEmbedding(len(keys)-1))
+	for i, key := range keys {
+		_, found := c.Get(key)
+		if want := i == 0 || i >= minSlabSegmentSlots; found != want {
+			t.Errorf("entry %d cached: %v, want %v", i, found, want)
+		}
+	}
+	if len(shard.slots) != minSlabSegmentSlots+2 {
+		t.Errorf("shard holds %d entries, want %d", len(shard.slots), minSlabSegmentSlots+2)
+	}
+	// Views handed out before eviction stay valid.
+	if !reflect.DeepEqual(kept, testEmbedding(0)) {
+		t.Errorf("view of a moved entry changed to %v", kept)
+	}
+}
+
+func TestSlabCacheStaysWithinBudget(t *testing.T) {
+	c := NewSlabCache(testDimensions, 64<<10)
+	for i := 0; i < 20000; i++ {
+		c.Set(fmt.Sprintf("key%d", i), testEmbedding(i))
+	}
+	var vectors int64
+	for i := range c.shards {
+		for _, segment := range c.shards[i].segments {
+			vectors += int64(len(segment.referenced))
+		}
+	}
+	// Every shard gets at least two segments of minSlabSegmentSlots, which
+	// may exceed a small budget on machines with many cores.
+	floor := int64(len(c.shards) * 2 * minSlabSegmentSlots * 4 * testDimensions)
+	if bytes := 4 * testDimensions * vectors; bytes > max(64<<10, floor) {
+		t.Fatalf("cache holds %d bytes of segments, budget %d", bytes, 64<<10)
+	}
+}
+
+func TestTieredCachePromotesPersistentHits(t *testing.T) {
+	memory, persistent := NewInMemoryCache(), NewInMemoryCache()
+	c := NewTieredCache(memory, persistent)
+
+	c.Set("a", testEmbedding(1))
+	for name, tier := range map[string]EmbeddingCache{"memory": memory, "persistent": persistent} {
+		if got, found := tier.Get("a"); !found || !reflect.DeepEqual(got, testEmbedding(1)) {
+			t.Fatalf("%s tier holds %v, %v after Set", name, got, found)
+		}
+	}
+
+	persistent.Set("b", testEmbedding(2))
+	if got, found := c.Get("b"); !found || !reflect.DeepEqual(got, testEmbedding(2)) {
+		t.Fatalf("Get of a persistent entry = %v, %v", got, found)
+	}
+	if _, found := memory.Get("b"); !found {
+		t.Fatal("persistent hit was not promoted to memory")
+	}
+	if _, found := c.Get("c"); found {
+		t.Fatal("Get of a missing key succeeded")
+	}
+	if err := c.Close(); err != nil {
+		t.Fatal(err)
+	}
+}
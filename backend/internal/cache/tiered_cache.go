@@ -0,0 +1,39 @@
+package cache
+
+// TieredCache serves embeddings from a fast in-memory cache and falls back to
+// a persistent one, promoting what it finds there.
+type TieredCache struct {
+	memory     EmbeddingCache
+	persistent EmbeddingCache
+}
+
+// NewTieredCache layers memory in front of persistent.
+func NewTieredCache(memory, persistent EmbeddingCache) *TieredCache {
+	return &TieredCache{memory: memory, persistent: persistent}
+}
+
+// Get looks in memory first, then in the persistent cache.
+func (c *TieredCache) Get(key string) ([]float32, bool) {
+	if embedding, found := c.memory.Get(key); found {
+		return embedding, true
+	}
+	embedding, found := c.persistent.Get(key)
+	if found {
+		c.memory.Set(key, embedding)
+	}
+	return embedding, found
+}
+
+// Set stores the embedding in both tiers.
+func (c *TieredCache) Set(key string, embedding []float32) {
+	c.memory.Set(key, embedding)
+	c.persistent.Set(key, embedding)
+}
+
+// Close closes the persistent tier if it holds resources.
+func (c *TieredCache) Close() error {
+	if closer, ok := c.persistent.(interface{ Close() error }); ok {
+		return closer.Close()
+	}
+	return nil
+}
@@ -0,0 +1,138 @@
+package cache
+
+import (
+	"encoding/binary"
+	"math/bits"
+	"unsafe"
+)
+
+// xxHash64, as specified at https://github.com/Cyan4973/xxHash. It is kept
+// in-tree because cache keys only need a fast, well-distributed hash and the
+// reference algorithm is small.
+
+const (
+	xxPrime1 uint64 = 11400714785074694791
+	xxPrime2 uint64 = 14029467366897019727
+	xxPrime3 uint64 = 1609587929392839161
+	xxPrime4 uint64 = 9650029242287828579
+	xxPrime5 uint64 = 2870177450012600261
+)
+
+// xxDigest is a streaming xxHash64 state.
+type xxDigest struct {
+	seed           uint64
+	v1, v2, v3, v4 uint64
+	total          uint64
+	mem            [32]byte
+	n              int // Buffered bytes in mem
+}
+
+func newXXDigest(seed uint64) xxDigest {
+	return xxDigest{
+		seed: seed,
+		v1:   seed + xxPrime1 + xxPrime2,
+		v2:   seed + xxPrime2,
+		v3:   seed,
+		v4:   seed - xxPrime1,
+	}
+}
+
+// writeString hashes s without copying it.
+func (d *xxDigest) writeString(s string) {
+	d.write(unsafe.Slice(unsafe.StringData(s), len(s)))
+}
+
+func (d *xxDigest) write(b []byte) {
+	d.total += uint64(len(b))
+
+	if d.n+len(b) < 32 {
+		d.n += copy(d.mem[d.n:], b)
+		return
+	}
+	if d.n > 0 {
+		c := copy(d.mem[d.n:], b)
+		d.stripe(d.mem[:])
+		b = b[c:]
+		d.n = 0
+	}
+	for len(b) >= 32 {
+		d.stripe(b[:32])
+		b = b[32:]
+	}
+	d.n = copy(d.mem[:], b)
+}
+
+func (d *xxDigest) stripe(b []byte) {
+	d.v1 = xxRound(d.v1, binary.LittleEndian.Uint64(b[0:]))
+	d.v2 = xxRound(d.v2, binary.LittleEndian.Uint64(b[8:]))
+	d.v3 = xxRound(d.v3, binary.LittleEndian.Uint64(b[16:]))
+	d.v4 = xxRound(d.v4, binary.LittleEndian.Uint64(b[24:]))
+}
+
+func (d *xxDigest) sum64() uint64 {
+	var h uint64
+	if d.total >= 32 {
+		h = bits.RotateLeft64(d.v1, 1) + bits.RotateLeft64(d.v2, 7) +
+			bits.RotateLeft64(d.v3, 12) + bits.RotateLeft64(d.v4, 18)
+		h = xxMergeRound(h, d.v1)
+		h = xxMergeRound(h, d.v2)
+		h = xxMergeRound(h, d.v3)
+		h = xxMergeRound(h, d.v4)
+	} else {
+		h = d.seed + xxPrime5
+	}
+	h += d.total
+
+	b := d.mem[:d.n]
+	for ; len(b) >= 8; b = b[8:] {
+		h ^= xxRound(0, binary.LittleEndian.Uint64(b))
+		h = bits.RotateLeft64(h, 27)*xxPrime1 + xxPrime4
+	}
+	if len(b) >= 4 {
+		h ^= uint64(binary.LittleEndian.Uint32(b)) * xxPrime1
+		h = bits.RotateLeft64(h, 23)*xxPrime2 + xxPrime3
+		b = b[4:]
+	}
+	for _, c := range b {
+		h ^= uint64(c) * xxPrime5
+		h = bits.RotateLeft64(h, 11) * xxPrime1
+	}
+
+	h ^= h >> 33
+	h *= xxPrime2
+	h ^= h >> 29
+	h *= xxPrime3
+	h ^= h >> 32
+	return h
+}
+
+func xxRound(acc, input uint64) uint64 {
+	acc += input * xxPrime2
+	acc = bits.RotateLeft64(acc, 31)
+	return acc * xxPrime1
+}
+
+func xxMergeRound(acc, val uint64) uint64 {
+	acc ^= xxRound(0, val)
+	return acc*xxPrime1 + xxPrime4
+}
+
+// xxHash64String returns the xxHash64 of s with the given seed.
+func xxHash64String(seed uint64, s string) uint64 {
+	d := newXXDigest(seed)
+	d.writeString(s)
+	return d.sum64()
+}
+
+// HashString returns the xxHash64 of s without copying it. It is used for
+// chunk content hashes.
+func HashString(s string) uint64 {
+	return xxHash64String(0, s)
+}
+
+// HashBytes returns the xxHash64 of b. It is used for file content hashes.
+func HashBytes(b []byte) uint64 {
+	d := newXXDigest(0)
+	d.write(b)
+	return d.sum64()
+}
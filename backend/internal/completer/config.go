@@ -5,6 +5,8 @@ import (
 	"os"
 	"strconv"
 	"strings"
+
+	"autocomplete/backend/internal/indexer"
 )
 
 // EmbeddingProvider represents the type of embedding provider
@@ -18,11 +20,38 @@ const (
 
 // Config holds all configuration for the completion service
 type Config struct {
-	Embedding EmbeddingConfig `json:"embedding"`
+	Embedding  EmbeddingConfig  `json:"embedding"`
+	Completion CompletionConfig `json:"completion"`
 
 	// New exclusion settings
 	ExcludedFiles      []string `json:"excluded_files"`
 	ExcludedExtensions []string `json:"excluded_extensions"`
+
+	// Count hardware cache misses per vector search query (Linux only)
+	ProfileCacheMisses bool `json:"profile_cache_misses"`
+
+	// Quiet period before a changed file is re-indexed (0 disables watching)
+	WatchDebounceMS int `json:"watch_debounce_ms"`
+
+	// Declaration chunk size bounds in estimated tokens
+	ChunkMaxTokens int `json:"chunk_max_tokens"`
+	ChunkMinTokens int `json:"chunk_min_tokens"`
+
+	// Lines before the cursor embedded as the retrieval query, and the
+	// number of query embeddings kept for repeated windows (0 disables)
+	QueryWindowLines  int `json:"query_window_lines"`
+	QueryCacheEntries int `json:"query_cache_entries"`
+
+	// Where the server listens: a TCP port for HTTP (0 disables it) and a
+	// Unix socket path for the framed RPC protocol (empty disables it)
+	ListenPort   int    `json:"listen_port"`
+	ListenSocket string `json:"listen_socket"`
+
+	// Memory budget for the indexes of all loaded workspaces (0 is
+	// unbounded), and how long the server keeps running without socket
+	// clients before it exits (0 keeps it running)
+	WorkspaceMemoryMB  int `json:"workspace_memory_mb"`
+	IdleTimeoutSeconds int `json:"idle_timeout_seconds"`
 }
 
 // EmbeddingConfig holds configuration for embedding providers
@@ -33,6 +62,35 @@ type EmbeddingConfig struct {
 	HuggingFace     HuggingFaceConfig `json:"huggingface"`
 	Dimensions      int               `json:"dimensions"`       // Auto-detected if 0
 	CompletionModel string            `json:"completion_model"` // For text completion (OpenAI)
+	BatchSize       int               `json:"batch_size"`       // Texts per embedding request when indexing
+
+	// Indexing pipeline limits; 0 selects a per-provider default
+	Concurrency       int     `json:"concurrency"`         // Embedding requests in flight
+	RequestsPerSecond float64 `json:"requests_per_second"` // Embedding request rate limit (0 = unlimited)
+
+	// Embedding requests in flight for completion queries and for re-indexing
+	// changed files; directory indexing is bounded by Concurrency
+	InteractiveConcurrency int `json:"interactive_concurrency"`
+	FileConcurrency        int `json:"file_concurrency"`
+
+	CacheMaxMB    int    `json:"cache_max_mb"`    // Size cap of the persistent embedding cache (0 = memory only)
+	MemoryCacheMB int    `json:"memory_cache_mb"` // Budget of the in-memory embedding cache
+	CacheKeyMode  string `json:"cache_key_mode"`  // "content" (default) or "path"
+}
+
+// CompletionConfig selects the LLM that generates completions and the
+// backup that slow requests are hedged to. The OpenAI model is
+// EmbeddingConfig.CompletionModel.
+type CompletionConfig struct {
+	Provider   string `json:"provider"`    // "openai" or "local"
+	LocalURL   string `json:"local_url"`   // /v1 endpoint of an OpenAI-compatible server (llama.cpp, Ollama)
+	LocalModel string `json:"local_model"` // Model served by the local server
+
+	// Backup of requests without a first token within the HedgePercentile
+	// of observed time to first token: "" (no hedging), "primary" (a second
+	// request to the same provider), "openai" or "local"
+	Hedge           string  `json:"hedge"`
+	HedgePercentile float64 `json:"hedge_percentile"`
 }
 
 // OpenAIConfig holds OpenAI-specific configuration
@@ -78,8 +136,27 @@ func LoadConfig() (*Config, error) {
 				MaxLength: 512,
 				BatchSize: 1,
 			},
-			Dimensions: 0, // Auto-detect
+			Dimensions:    0, // Auto-detect
+			BatchSize:     32,
+			CacheMaxMB:    512,
+			MemoryCacheMB: 256,
+			CacheKeyMode:  "content",
+
+			InteractiveConcurrency: 4,
+			FileConcurrency:        2,
+		},
+		Completion: CompletionConfig{
+			Provider:        "openai",
+			LocalURL:        "http://localhost:11434/v1",
+			HedgePercentile: 95,
 		},
+		WatchDebounceMS:   300,
+		ChunkMaxTokens:    indexer.DefaultChunkBudget.MaxTokens,
+		ChunkMinTokens:    indexer.DefaultChunkBudget.MinTokens,
+		QueryWindowLines:  defaultQueryWindowLines,
+		QueryCacheEntries: 256,
+		ListenPort:        2539,
+		WorkspaceMemoryMB: 2048,
 	}
 
 	// Load embedding provider type
@@ -127,6 +204,25 @@ func LoadConfig() (*Config, error) {
 		config.Embedding.CompletionModel = ""
 	}
 
+	// Load completion LLM configuration
+	if provider := os.Getenv("COMPLETION_PROVIDER"); provider != "" {
+		config.Completion.Provider = strings.ToLower(provider)
+	}
+	if localURL := os.Getenv("COMPLETION_LOCAL_URL"); localURL != "" {
+		config.Completion.LocalURL = localURL
+	}
+	if localModel := os.Getenv("COMPLETION_LOCAL_MODEL"); localModel != "" {
+		config.Completion.LocalModel = localModel
+	}
+	if hedge := os.Getenv("COMPLETION_HEDGE"); hedge != "" && hedge != "off" {
+		config.Completion.Hedge = strings.ToLower(hedge)
+	}
+	if percentileStr := os.Getenv("COMPLETION_HEDGE_PERCENTILE"); percentileStr != "" {
+		if percentile, err := strconv.ParseFloat(percentileStr, 64); err == nil {
+			config.Completion.HedgePercentile = percentile
+		}
+	}
+
 	// Load HuggingFace configuration
 	if modelID := os.Getenv("HUGGINGFACE_MODEL_ID"); modelID != "" {
 		config.Embedding.HuggingFace.ModelID = modelID
@@ -150,6 +246,51 @@ func LoadConfig() (*Config, error) {
 		}
 	}
 
+	// Load embedding batch size
+	if batchSizeStr := os.Getenv("EMBEDDING_BATCH_SIZE"); batchSizeStr != "" {
+		if batchSize, err := strconv.Atoi(batchSizeStr); err == nil && batchSize > 0 {
+			config.Embedding.BatchSize = batchSize
+		}
+	}
+
+	// Load embedding pipeline limits
+	if concurrencyStr := os.Getenv("EMBEDDING_CONCURRENCY"); concurrencyStr != "" {
+		if concurrency, err := strconv.Atoi(concurrencyStr); err == nil && concurrency > 0 {
+			config.Embedding.Concurrency = concurrency
+		}
+	}
+	if concurrencyStr := os.Getenv("EMBEDDING_INTERACTIVE_CONCURRENCY"); concurrencyStr != "" {
+		if concurrency, err := strconv.Atoi(concurrencyStr); err == nil && concurrency > 0 {
+			config.Embedding.InteractiveConcurrency = concurrency
+		}
+	}
+	if concurrencyStr := os.Getenv("EMBEDDING_FILE_CONCURRENCY"); concurrencyStr != "" {
+		if concurrency, err := strconv.Atoi(concurrencyStr); err == nil && concurrency > 0 {
+			config.Embedding.FileConcurrency = concurrency
+		}
+	}
+	if rpsStr := os.Getenv("EMBEDDING_REQUESTS_PER_SECOND"); rpsStr != "" {
+		if rps, err := strconv.ParseFloat(rpsStr, 64); err == nil && rps >= 0 {
+			config.Embedding.RequestsPerSecond = rps
+		}
+	}
+
+	// Load persistent embedding cache size
+	if cacheStr := os.Getenv("EMBEDDING_CACHE_MAX_MB"); cacheStr != "" {
+		if cacheMB, err := strconv.Atoi(cacheStr); err == nil && cacheMB >= 0 {
+			config.Embedding.CacheMaxMB = cacheMB
+		}
+	}
+
+	if memoryStr := os.Getenv("EMBEDDING_MEMORY_CACHE_MB"); memoryStr != "" {
+		if memoryMB, err := strconv.Atoi(memoryStr); err == nil && memoryMB > 0 {
+			config.Embedding.MemoryCacheMB = memoryMB
+		}
+	}
+	if keyMode := os.Getenv("EMBEDDING_CACHE_KEY_MODE"); keyMode != "" {
+		config.Embedding.CacheKeyMode = keyMode
+	}
+
 	// Load embedding dimensions override
 	if dimStr := os.Getenv("EMBEDDING_DIMENSIONS"); dimStr != "" {
 		if dimensions, err := strconv.Atoi(dimStr); err == nil && dimensions > 0 {
@@ -173,6 +314,66 @@ func LoadConfig() (*Config, error) {
 		config.ExcludedExtensions = exts
 	}
 
+	// Load vector search profiling settings
+	if profileStr := os.Getenv("VECTOR_SEARCH_PROFILE_CACHE_MISSES"); profileStr != "" {
+		if profile, err := strconv.ParseBool(profileStr); err == nil {
+			config.ProfileCacheMisses = profile
+		}
+	}
+
+	// Load file watcher settings
+	if debounceStr := os.Getenv("INDEX_WATCH_DEBOUNCE_MS"); debounceStr != "" {
+		if debounce, err := strconv.Atoi(debounceStr); err == nil && debounce >= 0 {
+			config.WatchDebounceMS = debounce
+		}
+	}
+
+	// Load chunk size bounds
+	if maxStr := os.Getenv("CHUNK_MAX_TOKENS"); maxStr != "" {
+		if maxTokens, err := strconv.Atoi(maxStr); err == nil && maxTokens > 0 {
+			config.ChunkMaxTokens = maxTokens
+		}
+	}
+	if minStr := os.Getenv("CHUNK_MIN_TOKENS"); minStr != "" {
+		if minTokens, err := strconv.Atoi(minStr); err == nil && minTokens >= 0 {
+			config.ChunkMinTokens = minTokens
+		}
+	}
+
+	// Load completion query settings
+	if linesStr := os.Getenv("QUERY_WINDOW_LINES"); linesStr != "" {
+		if lines, err := strconv.Atoi(linesStr); err == nil && lines > 0 {
+			config.QueryWindowLines = lines
+		}
+	}
+	if entriesStr := os.Getenv("QUERY_EMBEDDING_CACHE_SIZE"); entriesStr != "" {
+		if entries, err := strconv.Atoi(entriesStr); err == nil && entries >= 0 {
+			config.QueryCacheEntries = entries
+		}
+	}
+
+	// Load listener settings
+	if portStr := os.Getenv("BACKEND_PORT"); portStr != "" {
+		if port, err := strconv.Atoi(portStr); err == nil && port >= 0 && port <= 65535 {
+			config.ListenPort = port
+		}
+	}
+	if socket := os.Getenv("BACKEND_SOCKET"); socket != "" {
+		config.ListenSocket = socket
+	}
+	if idleStr := os.Getenv("BACKEND_IDLE_TIMEOUT_SECONDS"); idleStr != "" {
+		if idle, err := strconv.Atoi(idleStr); err == nil && idle >= 0 {
+			config.IdleTimeoutSeconds = idle
+		}
+	}
+
+	// Load workspace settings
+	if memoryStr := os.Getenv("WORKSPACE_MEMORY_MB"); memoryStr != "" {
+		if memoryMB, err := strconv.Atoi(memoryStr); err == nil && memoryMB >= 0 {
+			config.WorkspaceMemoryMB = memoryMB
+		}
+	}
+
 	// Validate configuration
 	if err := config.Validate(); err != nil {
 		return nil, fmt.Errorf("invalid configuration: %w", err)
@@ -227,6 +428,54 @@ func (c *Config) Validate() error {
 	if c.Embedding.Dimensions < 0 {
 		return fmt.Errorf("embedding dimensions must be non-negative")
 	}
+	if c.Embedding.BatchSize <= 0 {
+		return fmt.Errorf("embedding batch size must be positive")
+	}
+	if c.Embedding.Concurrency < 0 {
+		return fmt.Errorf("embedding concurrency must be non-negative")
+	}
+	if c.Embedding.RequestsPerSecond < 0 {
+		return fmt.Errorf("embedding requests per second must be non-negative")
+	}
+	if c.Embedding.CacheMaxMB < 0 {
+		return fmt.Errorf("embedding cache size must be non-negative")
+	}
+	if c.Embedding.MemoryCacheMB <= 0 {
+		return fmt.Errorf("in-memory embedding cache size must be positive")
+	}
+	if c.Embedding.CacheKeyMode != "content" && c.Embedding.CacheKeyMode != "path" {
+		return fmt.Errorf("unsupported embedding cache key mode: %s", c.Embedding.CacheKeyMode)
+	}
+	if c.WatchDebounceMS < 0 {
+		return fmt.Errorf("watch debounce must be non-negative")
+	}
+	if c.ChunkMinTokens > c.ChunkMaxTokens {
+		return fmt.Errorf("chunk min tokens (%d) must not exceed chunk max tokens (%d)", c.ChunkMinTokens, c.ChunkMaxTokens)
+	}
+	switch c.Completion.Provider {
+	case "openai":
+	case "local":
+		if c.Completion.LocalURL == "" || c.Completion.LocalModel == "" {
+			return fmt.Errorf("a local completion server URL and model are required when using the local completion provider")
+		}
+	default:
+		return fmt.Errorf("invalid completion provider: %s (must be 'openai' or 'local')", c.Completion.Provider)
+	}
+	switch c.Completion.Hedge {
+	case "", "primary", "openai":
+	case "local":
+		if c.Completion.LocalURL == "" || c.Completion.LocalModel == "" {
+			return fmt.Errorf("a local completion server URL and model are required to hedge to it")
+		}
+	default:
+		return fmt.Errorf("invalid completion hedge: %s (must be 'off', 'primary', 'openai' or 'local')", c.Completion.Hedge)
+	}
+	if c.Completion.HedgePercentile <= 0 || c.Completion.HedgePercentile >= 100 {
+		return fmt.Errorf("completion hedge percentile must be between 0 and 100")
+	}
+	if c.ListenPort == 0 && c.ListenSocket == "" {
+		return fmt.Errorf("either a listen port or a listen socket is required")
+	}
 
 	return nil
 }
@@ -274,6 +523,85 @@ func (c *Config) GetEmbeddingDimensions() int {
 	return 1536 // Fallback
 }
 
+// EmbeddingBatchSize returns how many texts to send per embedding request.
+// The HuggingFace provider keeps honouring its own batch size setting.
+func (c *Config) EmbeddingBatchSize() int {
+	if c.Embedding.Provider == ProviderHuggingFace {
+		return c.Embedding.HuggingFace.BatchSize
+	}
+	return c.Embedding.BatchSize
+}
+
+// EmbeddingConcurrency returns how many embedding requests the indexing
+// pipeline keeps in flight. Hosted APIs tolerate more parallelism than a
+// local server sharing the developer's machine; Ollama batches already fan
+// out internally.
+func (c *Config) EmbeddingConcurrency() int {
+	if c.Embedding.Concurrency > 0 {
+		return c.Embedding.Concurrency
+	}
+	switch c.Embedding.Provider {
+	case ProviderOpenAI:
+		return 4
+	case ProviderLocal:
+		if c.Embedding.Local.ServerType == "ollama" {
+			return 1
+		}
+		return 2
+	default:
+		return 2
+	}
+}
+
+// EmbeddingModelID identifies the model that produces embeddings, so cached
+// vectors are never mixed across providers or models.
+func (c *Config) EmbeddingModelID() string {
+	switch c.Embedding.Provider {
+	case ProviderOpenAI:
+		return "openai/" + c.Embedding.OpenAI.Model
+	case ProviderLocal:
+		model := c.Embedding.Local.ModelName
+		if model == "" {
+			// TEI serves a single model per server, so the URL identifies it
+			model = c.Embedding.Local.ServerURL
+		}
+		return "local/" + c.Embedding.Local.ServerType + "/" + model
+	case ProviderHuggingFace:
+		return "huggingface/" + c.Embedding.HuggingFace.ModelID
+	}
+	return string(c.Embedding.Provider)
+}
+
+// CompletionModelName returns the OpenAI model that generates completions.
+func (c *Config) CompletionModelName() string {
+	if c.Embedding.CompletionModel == "" {
+		return DefaultCompletionModel
+	}
+	return c.Embedding.CompletionModel
+}
+
+// ChunkBudget returns the chunk size bounds, falling back to the defaults
+// when none are configured.
+func (c *Config) ChunkBudget() indexer.ChunkBudget {
+	if c.ChunkMaxTokens <= 0 {
+		return indexer.DefaultChunkBudget
+	}
+	return indexer.ChunkBudget{MaxTokens: c.ChunkMaxTokens, MinTokens: c.ChunkMinTokens}
+}
+
+// defaultQueryWindowLines is the number of lines before the cursor that
+// retrieval is based on when none is configured.
+const defaultQueryWindowLines = 40
+
+// QueryLines returns the number of lines before the cursor embedded as the
+// retrieval query.
+func (c *Config) QueryLines() int {
+	if c.QueryWindowLines <= 0 {
+		return defaultQueryWindowLines
+	}
+	return c.QueryWindowLines
+}
+
 // SetEmbeddingDimensions sets the embedding dimensions (used after auto-detection)
 func (c *Config) SetEmbeddingDimensions(dimensions int) {
 	c.Embedding.Dimensions = dimensions
@@ -0,0 +1,150 @@
+package completer
+
+import (
+	"errors"
+	"fmt"
+	"sync"
+	"unicode/utf8"
+)
+
+var (
+	// ErrUnknownDocument is returned for a document that is not open.
+	ErrUnknownDocument = errors.New("document is not open")
+	// ErrVersionMismatch is returned when a request is based on a different
+	// version of a document than the server holds; the editor should open
+	// the document again with its full text.
+	ErrVersionMismatch = errors.New("document version mismatch")
+)
+
+// DocumentEdit replaces Length characters at Offset with Text. Offsets and
+// lengths count UTF-16 code units, as editors do.
+type DocumentEdit struct {
+	Offset int    `json:"offset"`
+	Length int    `json:"length"`
+	Text   string `json:"text"`
+}
+
+// documentMirror holds the editor's open documents, kept up to date by
+// incremental edits in the manner of LSP didOpen/didChange, so a completion
+// request only has to name a document version and a cursor offset instead
+// of sending the text before the cursor every time.
+type documentMirror struct {
+	mu   sync.Mutex
+	open map[string]*openDocument
+}
+
+type openDocument struct {
+	version int
+	text    string
+	ascii   bool // UTF-16 offsets are byte offsets
+}
+
+func newDocumentMirror() *documentMirror {
+	return &documentMirror{open: make(map[string]*openDocument)}
+}
+
+func newOpenDocument(version int, text string) *openDocument {
+	return &openDocument{version: version, text: text, ascii: isASCII(text)}
+}
+
+// OpenDocument starts mirroring path at version with its full text,
+// replacing any earlier state.
+func (s *CompletionService) OpenDocument(path string, version int, text string) {
+	s.editors.mu.Lock()
+	defer s.editors.mu.Unlock()
+	s.editors.open[path] = newOpenDocument(version, text)
+}
+
+// ChangeDocument applies edits, in order, to the mirror of path at
+// baseVersion, making it version.
+func (s *CompletionService) ChangeDocument(path string, baseVersion, version int, edits []DocumentEdit) error {
+	s.editors.mu.Lock()
+	defer s.editors.mu.Unlock()
+	doc := s.editors.open[path]
+	if doc == nil {
+		return ErrUnknownDocument
+	}
+	if doc.version != baseVersion {
+		return fmt.Errorf("%w: have %d, edits are based on %d", ErrVersionMismatch, doc.version, baseVersion)
+	}
+	text := doc.text
+	ascii := doc.ascii
+	for _, edit := range edits {
+		start, err := byteOffset(text, ascii, edit.Offset)
+		if err != nil {
+			return err
+		}
+		end, err := byteOffset(text[start:], ascii, edit.Length)
+		if err != nil {
+			return err
+		}
+		text = text[:start] + edit.Text + text[start+end:]
+		ascii = ascii && isASCII(edit.Text)
+	}
+	s.editors.open[path] = &openDocument{version: version, text: text, ascii: ascii}
+	return nil
+}
+
+// CloseDocument stops mirroring path.
+func (s *CompletionService) CloseDocument(path string) {
+	s.editors.mu.Lock()
+	defer s.editors.mu.Unlock()
+	delete(s.editors.open, path)
+}
+
+// DocumentPrefix returns the text before offset in version of the mirrored
+// document at path.
+func (s *CompletionService) DocumentPrefix(path string, version, offset int) (string, error) {
+	s.editors.mu.Lock()
+	doc := s.editors.open[path]
+	s.editors.mu.Unlock()
+	if doc == nil {
+		return "", ErrUnknownDocument
+	}
+	if doc.version != version {
+		return "", fmt.Errorf("%w: have %d, requested %d", ErrVersionMismatch, doc.version, version)
+	}
+	end, err := byteOffset(doc.text, doc.ascii, offset)
+	if err != nil {
+		return "", err
+	}
+	return doc.text[:end], nil
+}
+
+// byteOffset converts an offset in UTF-16 code units from the start of text
+// to a byte offset.
+func byteOffset(text string, ascii bool, units int) (int, error) {
+	if units < 0 {
+		return 0, fmt.Errorf("negative document offset %d", units)
+	}
+	if ascii {
+		if units > len(text) {
+			return 0, fmt.Errorf("document offset %d is past the end (%d)", units, len(text))
+		}
+		return units, nil
+	}
+	counted := 0
+	for i, r := range text {
+		if counted >= units {
+			return i, nil
+		}
+		if r >= 0x10000 {
+			counted += 2
+		} else {
+			counted++
+		}
+	}
+	if counted < units {
+		return 0, fmt.Errorf("document offset %d is past the end (%d)", units, counted)
+	}
+	return len(text), nil
+}
+
+func isASCII(s string) bool {
+	for i := 0; i < len(s); i++ {
+		if s[i] >= utf8.RuneSelf {
+			return false
+		}
+	}
+	return true
+}
@@ -0,0 +1,85 @@
+package completer
+
+import (
+	"errors"
+	"testing"
+)
+
+func TestDocumentMirrorCountsUTF16CodeUnits(t *testing.T) {
+	s, _, _ := newTestService(t)
+	const path = "/src/a.go"
+	// é is one UTF-16 unit in two bytes, 😀 two units in four bytes.
+	s.OpenDocument(path, 1, `s := "é😀"`)
+
+	prefixes := []struct {
+		offset int
+		want   string
+	}{
+		{0, ``},
+		{7, `s := "é`},
+		{9, `s := "é😀`},
+		{10, `s := "é😀"`},
+	}
+	for _, p := range prefixes {
+		if got, err := s.DocumentPrefix(path, 1, p.offset); err != nil || got != p.want {
+			t.Errorf("DocumentPrefix at %d = %q, %v, want %q", p.offset, got, err, p.want)
+		}
+	}
+	if _, err := s.DocumentPrefix(path, 1, 11); err == nil {
+		t.Error("DocumentPrefix past the end succeeded")
+	}
+
+	// Replace the emoji, then append after the closing quote.
+	edits := []DocumentEdit{{Offset: 7, Length: 2, Text: "ü"}, {Offset: 9, Length: 0, Text: " // ✓"}}
+	if err := s.ChangeDocument(path, 1, 2, edits); err != nil {
+		t.Fatal(err)
+	}
+	if got, err := s.DocumentPrefix(path, 2, 14); err != nil || got != `s := "éü" // ✓` {
+		t.Fatalf("document after edits = %q, %v", got, err)
+	}
+}
+
+func TestDocumentMirrorLeavesASCIIFastPathOnNonASCIIEdit(t *testing.T) {
+	s, _, _ := newTestService(t)
+	const path = "/src/a.go"
+	s.OpenDocument(path, 1, "x := 1\n")
+
+	edits := []DocumentEdit{{Offset: 5, Length: 1, Text: `"😀"`}, {Offset: 9, Length: 0, Text: " + y"}}
+	if err := s.ChangeDocument(path, 1, 2, edits); err != nil {
+		t.Fatal(err)
+	}
+	if got, err := s.DocumentPrefix(path, 2, 13); err != nil || got != `x := "😀" + y` {
+		t.Fatalf("document after edits = %q, %v", got, err)
+	}
+}
+
+func TestDocumentMirrorRejectsStaleAndUnknownDocuments(t *testing.T) {
+	s, _, _ := newTestService(t)
+	const path = "/src/a.go"
+	if _, err := s.DocumentPrefix(path, 1, 0); !errors.Is(err, ErrUnknownDocument) {
+		t.Fatalf("DocumentPrefix of a document never opened returned %v", err)
+	}
+	s.OpenDocument(path, 3, "abc")
+
+	if err := s.ChangeDocument(path, 2, 4, []DocumentEdit{{Offset: 0, Text: "x"}}); !errors.Is(err, ErrVersionMismatch) {
+		t.Fatalf("ChangeDocument based on an old version returned %v", err)
+	}
+	if _, err := s.DocumentPrefix(path, 4, 0); !errors.Is(err, ErrVersionMismatch) {
+		t.Fatalf("DocumentPrefix of a version never reached returned %v", err)
+	}
+
+	// A failing edit leaves the document as it was, even after earlier
+	// edits of the same change applied.
+	edits := []DocumentEdit{{Offset: 0, Text: "x"}, {Offset: 10, Text: "y"}}
+	if err := s.ChangeDocument(path, 3, 4, edits); err == nil {
+		t.Fatal("ChangeDocument with an edit past the end succeeded")
+	}
+	if got, err := s.DocumentPrefix(path, 3, 3); err != nil || got != "abc" {
+		t.Fatalf("document after a failed change = %q, %v", got, err)
+	}
+
+	s.CloseDocument(path)
+	if _, err := s.DocumentPrefix(path, 3, 0); !errors.Is(err, ErrUnknownDocument) {
+		t.Fatalf("DocumentPrefix of a closed document returned %v", err)
+	}
+}
@@ -1,9 +1,15 @@
 package completer
 
+import "context"
+
 // Embedder is an interface for creating vector embeddings from text.
 // This will allow us to easily swap between different embedding providers
 // like OpenAI, Google, or local models.
 type Embedder interface {
-	// Embed takes a string of text and returns its vector embedding.
-	Embed(text string) ([]float32, error)
+	// Embed takes a string of text and returns its vector embedding. The
+	// request is abandoned when ctx is done.
+	Embed(ctx context.Context, text string) ([]float32, error)
+	// BatchEmbed embeds several texts with as few provider round trips as
+	// possible, returning one embedding per input in input order.
+	BatchEmbed(ctx context.Context, texts []string) ([][]float32, error)
 }
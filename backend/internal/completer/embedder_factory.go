@@ -2,6 +2,7 @@ package completer
 
 import (
 	"autocomplete/backend/internal/log"
+	"context"
 	"fmt"
 )
 
@@ -106,8 +107,13 @@ type OpenAIEmbedderWrapper struct {
 }
 
 // Embed delegates to the OpenAI client
-func (w *OpenAIEmbedderWrapper) Embed(text string) ([]float32, error) {
-	return w.client.Embed(text)
+func (w *OpenAIEmbedderWrapper) Embed(ctx context.Context, text string) ([]float32, error) {
+	return w.client.Embed(ctx, text)
+}
+
+// BatchEmbed delegates to the OpenAI client
+func (w *OpenAIEmbedderWrapper) BatchEmbed(ctx context.Context, texts []string) ([][]float32, error) {
+	return w.client.BatchEmbed(ctx, texts)
 }
 
 // GetDimensions returns the dimensions for the configured OpenAI model
@@ -139,7 +145,7 @@ func ValidateEmbedderConnection(embedder EmbedderWithDimensions) error {
 
 	// Test with a simple embedding
 	testText := "Hello world"
-	embedding, err := embedder.Embed(testText)
+	embedding, err := embedder.Embed(context.Background(), testText)
 	if err != nil {
 		return fmt.Errorf("failed to create test embedding: %w", err)
 	}
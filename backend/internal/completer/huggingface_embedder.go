@@ -64,7 +64,7 @@ func NewHuggingFaceEmbedder(config HuggingFaceConfig) (*HuggingFaceEmbedder, err
 }
 
 // Embed creates a vector embedding for the given text using the HuggingFace model
-func (e *HuggingFaceEmbedder) Embed(text string) ([]float32, error) {
+func (e *HuggingFaceEmbedder) Embed(ctx context.Context, text string) ([]float32, error) {
 	if text == "" {
 		return nil, fmt.Errorf("text cannot be empty")
 	}
@@ -87,7 +87,7 @@ func (e *HuggingFaceEmbedder) Embed(text string) ([]float32, error) {
 	log.InfoLogger.Printf("🔄 Creating embedding for text (length: %d chars)", len(text))
 
 	// Get embeddings from HuggingFace using automatic reduction to get [][]float32
-	resp, err := e.client.FeatureExtractionWithAutomaticReduction(context.Background(), req)
+	resp, err := e.client.FeatureExtractionWithAutomaticReduction(ctx, req)
 	if err != nil {
 		// Check for authentication errors and provide helpful guidance
 		if strings.Contains(err.Error(), "Invalid username or password") ||
@@ -172,7 +172,7 @@ func (e *HuggingFaceEmbedder) ValidateModel() error {
 
 	// Try to create a simple embedding to validate the model
 	testText := "validation test"
-	_, err := e.Embed(testText)
+	_, err := e.Embed(context.Background(), testText)
 	if err != nil {
 		return fmt.Errorf("model validation failed: %w", err)
 	}
@@ -230,22 +230,45 @@ func (e *HuggingFaceEmbedder) GetCacheSize() (int64, error) {
 	return size, nil
 }
 
-// BatchEmbed creates embeddings for multiple texts at once (future enhancement)
-func (e *HuggingFaceEmbedder) BatchEmbed(texts []string) ([][]float32, error) {
+// BatchEmbed creates embeddings for multiple texts in a single inference request
+func (e *HuggingFaceEmbedder) BatchEmbed(ctx context.Context, texts []string) ([][]float32, error) {
 	if len(texts) == 0 {
 		return nil, fmt.Errorf("texts cannot be empty")
 	}
 
 	log.InfoLogger.Printf("🔄 Creating batch embeddings for %d texts", len(texts))
 
-	// For now, process texts individually
-	// TODO: Implement true batch processing when the library supports it better
-	results := make([][]float32, len(texts))
-
+	inputs := make([]string, len(texts))
 	for i, text := range texts {
-		embedding, err := e.Embed(text)
-		if err != nil {
-			return nil, fmt.Errorf("failed to embed text %d: %w", i, err)
+		if text == "" {
+			return nil, fmt.Errorf("text %d cannot be empty", i)
+		}
+		if len(text) > e.config.MaxLength {
+			text = text[:e.config.MaxLength]
+		}
+		inputs[i] = text
+	}
+
+	req := &huggingface.FeatureExtractionRequest{
+		Inputs: inputs,
+		Options: huggingface.Options{
+			WaitForModel: huggingface.PTR(true),
+			UseCache:     huggingface.PTR(true),
+		},
+	}
+
+	resp, err := e.client.FeatureExtractionWithAutomaticReduction(ctx, req)
+	if err != nil {
+		return nil, fmt.Errorf("failed to get batch embeddings from HuggingFace model %s: %w", e.config.ModelID, err)
+	}
+	if len(resp) != len(texts) {
+		return nil, fmt.Errorf("expected %d embeddings, got %d", len(texts), len(resp))
+	}
+
+	results := make([][]float32, len(resp))
+	for i, embedding := range resp {
+		if len(embedding) != e.dimensions {
+			return nil, fmt.Errorf("dimension mismatch for text %d: expected %d, got %d", i, e.dimensions, len(embedding))
 		}
 		results[i] = embedding
 	}
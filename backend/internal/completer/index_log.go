@@ -0,0 +1,280 @@
+package completer
+
+import (
+	"bufio"
+	"bytes"
+	"encoding/binary"
+	"encoding/gob"
+	"errors"
+	"fmt"
+	"hash/crc32"
+	"io"
+	"os"
+
+	"autocomplete/backend/internal/indexer"
+	"autocomplete/backend/internal/log"
+)
+
+// indexFileName is the on-disk index inside a workspace's cache directory.
+const indexFileName = "index.records"
+
+// indexRecord is one entry of the on-disk index: the complete indexed state
+// of a file, or its removal when Deleted is set. The latest record for a
+// path wins, and the hash, size and modification time of the live records
+// form the manifest checked against the tree on startup.
+type indexRecord struct {
+	Path       string
+	Hash       uint64
+	Size       int64
+	ModTime    int64 // Unix nanoseconds
+	Chunks     []indexer.Chunk
+	Embeddings [][]float32 // Parallel to Chunks; nil where embedding failed
+	Deleted    bool
+}
+
+func (rec *indexRecord) meta() fileMeta {
+	return fileMeta{hash: rec.Hash, size: rec.Size, modTime: rec.ModTime}
+}
+
+// record builds the index record of a file at this version.
+func (m fileMeta) record(path string, chunks []indexer.Chunk, embeddings [][]float32) *indexRecord {
+	return &indexRecord{
+		Path:       path,
+		Hash:       m.hash,
+		Size:       m.size,
+		ModTime:    m.modTime,
+		Chunks:     chunks,
+		Embeddings: embeddings,
+	}
+}
+
+// recordSpan locates a record in the log.
+type recordSpan struct {
+	offset int64
+	size   int64
+}
+
+// indexLog is the on-disk index: an append-only sequence of framed records
+// (length, CRC-32, gob payload). Saving a file appends one record rather
+// than rewriting the whole index; the log is compacted once superseded
+// records make up most of it.
+type indexLog struct {
+	path      string
+	file      *os.File
+	size      int64
+	liveBytes int64
+	latest    map[string]recordSpan
+}
+
+const (
+	indexRecordHeaderSize = 8
+	maxIndexRecordBytes   = 256 << 20
+	// Compaction waits until the log is at least this large and mostly dead.
+	minIndexCompactionBytes = 8 << 20
+)
+
+// createIndexLog writes a fresh index containing records, replacing any
+// existing one.
+func createIndexLog(path string, records []*indexRecord) (*indexLog, error) {
+	tmpPath := path + ".tmp"
+	file, err := os.Create(tmpPath)
+	if err != nil {
+		return nil, err
+	}
+	l := &indexLog{path: tmpPath, file: file, latest: make(map[string]recordSpan)}
+
+	writer := bufio.NewWriter(file)
+	for _, rec := range records {
+		frame, err := encodeIndexRecord(rec)
+		if err != nil {
+			file.Close()
+			return nil, err
+		}
+		if _, err := writer.Write(frame); err != nil {
+			file.Close()
+			return nil, err
+		}
+		l.track(rec.Path, int64(len(frame)), rec.Deleted)
+	}
+	if err := writer.Flush(); err != nil {
+		file.Close()
+		return nil, err
+	}
+	if err := file.Sync(); err != nil {
+		file.Close()
+		return nil, err
+	}
+	if err := os.Rename(tmpPath, path); err != nil {
+		file.Close()
+		return nil, err
+	}
+	l.path = path
+	return l, nil
+}
+
+// openIndexLog replays an existing index and returns the latest live record
+// for every file. A torn record at the tail, left by a crash mid-append, is
+// truncated away.
+func openIndexLog(path string) (*indexLog, map[string]*indexRecord, error) {
+	file, err := os.OpenFile(path, os.O_RDWR, 0o644)
+	if err != nil {
+		return nil, nil, err
+	}
+	l := &indexLog{path: path, file: file, latest: make(map[string]recordSpan)}
+
+	records := make(map[string]*indexRecord)
+	reader := bufio.NewReader(file)
+	for {
+		rec, size, err := readIndexRecord(reader)
+		if err != nil {
+			if !errors.Is(err, io.EOF) {
+				log.ErrorLogger.Printf("⚠️ Discarding damaged tail of index %s: %v", path, err)
+			}
+			break
+		}
+		l.track(rec.Path, size, rec.Deleted)
+		if rec.Deleted {
+			delete(records, rec.Path)
+		} else {
+			records[rec.Path] = rec
+		}
+	}
+
+	if err := file.Truncate(l.size); err != nil {
+		file.Close()
+		return nil, nil, err
+	}
+	if _, err := file.Seek(l.size, io.SeekStart); err != nil {
+		file.Close()
+		return nil, nil, err
+	}
+	return l, records, nil
+}
+
+// append writes rec at the end of the log, compacting it afterwards if
+// superseded records dominate.
+func (l *indexLog) append(rec *indexRecord) error {
+	frame, err := encodeIndexRecord(rec)
+	if err != nil {
+		return err
+	}
+	if _, err := l.file.Write(frame); err != nil {
+		return err
+	}
+	l.track(rec.Path, int64(len(frame)), rec.Deleted)
+
+	if l.size > minIndexCompactionBytes && l.size > 2*l.liveBytes {
+		return l.compact()
+	}
+	return nil
+}
+
+// read returns the latest record for path, or nil if it has none.
+func (l *indexLog) read(path string) (*indexRecord, error) {
+	span, found := l.latest[path]
+	if !found {
+		return nil, nil
+	}
+	rec, _, err := readIndexRecord(bufio.NewReader(io.NewSectionReader(l.file, span.offset, span.size)))
+	return rec, err
+}
+
+// track accounts for a record of size bytes appended at the end of the log.
+func (l *indexLog) track(path string, size int64, deleted bool) {
+	if previous, found := l.latest[path]; found {
+		l.liveBytes -= previous.size
+		delete(l.latest, path)
+	}
+	if !deleted {
+		l.latest[path] = recordSpan{offset: l.size, size: size}
+		l.liveBytes += size
+	}
+	l.size += size
+}
+
+// compact rewrites the log with only the latest record of each live file.
+func (l *indexLog) compact() error {
+	tmpPath := l.path + ".tmp"
+	tmp, err := os.Create(tmpPath)
+	if err != nil {
+		return err
+	}
+	defer os.Remove(tmpPath)
+
+	latest := make(map[string]recordSpan, len(l.latest))
+	writer := bufio.NewWriter(tmp)
+	var size int64
+	for path, span := range l.latest {
+		if _, err := io.Copy(writer, io.NewSectionReader(l.file, span.offset, span.size)); err != nil {
+			tmp.Close()
+			return err
+		}
+		latest[path] = recordSpan{offset: size, size: span.size}
+		size += span.size
+	}
+	if err := writer.Flush(); err != nil {
+		tmp.Close()
+		return err
+	}
+	if err := tmp.Sync(); err != nil {
+		tmp.Close()
+		return err
+	}
+	if err := os.Rename(tmpPath, l.path); err != nil {
+		tmp.Close()
+		return err
+	}
+
+	log.InfoLogger.Printf("🧹 Compacted index %s from %d to %d bytes", l.path, l.size, size)
+	l.file.Close()
+	l.file = tmp
+	l.size = size
+	l.liveBytes = size
+	l.latest = latest
+	return nil
+}
+
+func (l *indexLog) close() error {
+	return l.file.Close()
+}
+
+func encodeIndexRecord(rec *indexRecord) ([]byte, error) {
+	var buf bytes.Buffer
+	buf.Write(make([]byte, indexRecordHeaderSize))
+	if err := gob.NewEncoder(&buf).Encode(rec); err != nil {
+		return nil, fmt.Errorf("failed to encode index record for %s: %w", rec.Path, err)
+	}
+	frame := buf.Bytes()
+	payload := frame[indexRecordHeaderSize:]
+	binary.LittleEndian.PutUint32(frame[0:], uint32(len(payload)))
+	binary.LittleEndian.PutUint32(frame[4:], crc32.ChecksumIEEE(payload))
+	return frame, nil
+}
+
+// readIndexRecord reads the next framed record and returns it with its size
+// in the log.
+func readIndexRecord(reader *bufio.Reader) (*indexRecord, int64, error) {
+	var header [indexRecordHeaderSize]byte
+	if _, err := io.ReadFull(reader, header[:]); err != nil {
+		if errors.Is(err, io.ErrUnexpectedEOF) {
+			return nil, 0, errors.New("truncated record header")
+		}
+		return nil, 0, err
+	}
+	length := binary.LittleEndian.Uint32(header[0:])
+	if length > maxIndexRecordBytes {
+		return nil, 0, errors.New("implausible record length")
+	}
+	payload := make([]byte, length)
+	if _, err := io.ReadFull(reader, payload); err != nil {
+		return nil, 0, errors.New("truncated record")
+	}
+	if crc32.ChecksumIEEE(payload) != binary.LittleEndian.Uint32(header[4:]) {
+		return nil, 0, errors.New("record checksum mismatch")
+	}
+	rec := &indexRecord{}
+	if err := gob.NewDecoder(bytes.NewReader(payload)).Decode(rec); err != nil {
+		return nil, 0, err
+	}
+	return rec, int64(indexRecordHeaderSize + len(payload)), nil
+}
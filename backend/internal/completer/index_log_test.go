@@ -0,0 +1,140 @@
+package completer
+
+import (
+	"os"
+	"path/filepath"
+	"reflect"
+	"testing"
+
+	"autocomplete/backend/internal/indexer"
+)
+
+// testRecord returns the record of path at version hash, with one chunk.
+func testRecord(path string, hash uint64, embedding []float32) *indexRecord {
+	chunk := indexer.Chunk{FilePath: path, Content: path, StartLine: 1, EndLine: 1}
+	return fileMeta{hash: hash, size: int64(hash), modTime: int64(hash)}.record(path, []indexer.Chunk{chunk}, [][]float32{embedding})
+}
+
+// checkLatest fails the test unless the index at path replays to want, by
+// path and hash.
+func checkLatest(t *testing.T, path string, want map[string]uint64) *indexLog {
+	t.Helper()
+	l, records, err := openIndexLog(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	got := make(map[string]uint64, len(records))
+	for path, rec := range records {
+		got[path] = rec.Hash
+	}
+	if !reflect.DeepEqual(got, want) {
+		l.close()
+		t.Fatalf("index replays to %v, want %v", got, want)
+	}
+	return l
+}
+
+func TestIndexLogReplaysLatestRecordOfEachFile(t *testing.T) {
+	path := filepath.Join(t.TempDir(), indexFileName)
+	l, err := createIndexLog(path, []*indexRecord{testRecord("a.go", 1, []float32{1}), testRecord("b.go", 1, []float32{2})})
+	if err != nil {
+		t.Fatal(err)
+	}
+	for _, rec := range []*indexRecord{testRecord("a.go", 2, []float32{3}), {Path: "b.go", Deleted: true}, testRecord("c.go", 1, nil)} {
+		if err := l.append(rec); err != nil {
+			t.Fatal(err)
+		}
+	}
+	rec, err := l.read("a.go")
+	if err != nil || rec == nil || rec.Hash != 2 || !reflect.DeepEqual(rec.Embeddings, [][]float32{{3}}) {
+		t.Fatalf("read(a.go) = %+v, %v, want the appended version", rec, err)
+	}
+	if rec, err := l.read("b.go"); rec != nil || err != nil {
+		t.Fatalf("read of a deleted file = %+v, %v", rec, err)
+	}
+	l.close()
+
+	l = checkLatest(t, path, map[string]uint64{"a.go": 2, "c.go": 1})
+	l.close()
+}
+
+func TestIndexLogDiscardsDamagedTail(t *testing.T) {
+	path := filepath.Join(t.TempDir(), indexFileName)
+	l, err := createIndexLog(path, []*indexRecord{testRecord("a.go", 1, []float32{1})})
+	if err != nil {
+		t.Fatal(err)
+	}
+	if err := l.append(testRecord("a.go", 2, []float32{2})); err != nil {
+		t.Fatal(err)
+	}
+	intact := l.size
+	if err := l.append(testRecord("a.go", 3, []float32{3})); err != nil {
+		t.Fatal(err)
+	}
+	l.close()
+
+	// Flip a byte in the payload of the last record.
+	data, err := os.ReadFile(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	data[len(data)-1] ^= 0xff
+	if err := os.WriteFile(path, data, 0o644); err != nil {
+		t.Fatal(err)
+	}
+	l = checkLatest(t, path, map[string]uint64{"a.go": 2})
+	if info, err := os.Stat(path); err != nil || info.Size() != intact {
+		t.Fatalf("index with a damaged tail was left at %d bytes, want %d (%v)", info.Size(), intact, err)
+	}
+
+	// Appends go after the intact records.
+	if err := l.append(testRecord("b.go", 1, nil)); err != nil {
+		t.Fatal(err)
+	}
+	l.close()
+	l = checkLatest(t, path, map[string]uint64{"a.go": 2, "b.go": 1})
+	l.close()
+}
+
+func TestIndexLogCompactsSupersededRecords(t *testing.T) {
+	path := filepath.Join(t.TempDir(), indexFileName)
+	l, err := createIndexLog(path, []*indexRecord{testRecord("small.go", 1, []float32{1})})
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer func() { l.close() }()
+
+	// Rewrite one large file until its old versions outweigh the live ones
+	// past the compaction threshold.
+	embedding := make([]float32, 1<<18)
+	for i := range embedding {
+		embedding[i] = float32(i) + 0.5
+	}
+	var hash uint64
+	for compacted := false; !compacted; {
+		hash++
+		before := l.size
+		if err := l.append(testRecord("large.go", hash, embedding)); err != nil {
+			t.Fatal(err)
+		}
+		compacted = l.size < before
+		if l.size > 4*minIndexCompactionBytes {
+			t.Fatalf("index grew to %d bytes without compacting", l.size)
+		}
+	}
+
+	if l.size != l.liveBytes {
+		t.Fatalf("compacted index holds %d bytes, %d of them live", l.size, l.liveBytes)
+	}
+	if info, err := os.Stat(path); err != nil || info.Size() != l.size {
+		t.Fatalf("compacted index file has %d bytes, want %d (%v)", info.Size(), l.size, err)
+	}
+	if rec, err := l.read("large.go"); err != nil || rec.Hash != hash {
+		t.Fatalf("read after compaction = %+v, %v", rec, err)
+	}
+	if err := l.append(testRecord("small.go", 2, []float32{2})); err != nil {
+		t.Fatal(err)
+	}
+	l.close()
+	l = checkLatest(t, path, map[string]uint64{"small.go": 2, "large.go": hash})
+}
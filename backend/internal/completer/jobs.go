@@ -0,0 +1,282 @@
+package completer
+
+import (
+	"context"
+	"errors"
+	"sync"
+	"sync/atomic"
+	"time"
+
+	"autocomplete/backend/internal/log"
+)
+
+// indexJobHistory is how many finished jobs a workspace reports.
+const indexJobHistory = 16
+
+// errIndexQueueClosed fails jobs still queued when a service is closed.
+var errIndexQueueClosed = errors.New("index queue closed")
+
+// IndexJobStatus reports one indexing job. Done and Total count the chunks
+// to embed when a directory is indexed from scratch and the changed files
+// otherwise; Total grows as the work is discovered.
+type IndexJobStatus struct {
+	ID       uint64    `json:"id"`
+	Kind     string    `json:"kind"` // "directory" or "files"
+	Path     string    `json:"path,omitempty"`
+	Files    int       `json:"files,omitempty"`
+	State    string    `json:"state"` // "queued", "running", "done" or "failed"
+	Error    string    `json:"error,omitempty"`
+	Done     int64     `json:"done"`
+	Total    int64     `json:"total"`
+	Queued   time.Time `json:"queued"`
+	Started  time.Time `json:"started,omitzero"`
+	Finished time.Time `json:"finished,omitzero"`
+}
+
+// IndexJob is a queued or running unit of indexing work.
+type IndexJob struct {
+	status IndexJobStatus // Guarded by the queue's mu
+	paths  map[string]bool
+
+	done     atomic.Int64
+	total    atomic.Int64
+	finished chan struct{}
+}
+
+// Wait blocks until the job has finished.
+func (j *IndexJob) Wait() {
+	<-j.finished
+}
+
+// indexQueue runs a service's indexing jobs one at a time, so directory
+// indexing, file re-indexing and watcher updates never overlap. Queued work
+// is coalesced: indexing a directory that is already queued joins that job,
+// as does re-indexing a file it covers, and changed files queued behind
+// each other are merged into one job whose chunks are embedded together.
+type indexQueue struct {
+	mu      sync.Mutex
+	nextID  uint64
+	pending []*IndexJob
+	running *IndexJob
+	history []*IndexJob
+	closed  bool
+	idle    chan struct{} // Closed when the worker exits; nil while none runs
+
+	// ctx is done once the queue is closed, giving up the running job.
+	ctx    context.Context
+	cancel context.CancelFunc
+}
+
+func newIndexQueue() *indexQueue {
+	ctx, cancel := context.WithCancel(context.Background())
+	return &indexQueue{ctx: ctx, cancel: cancel}
+}
+
+// QueueIndexDirectory queues indexing root, followed by watching it, unless
+// an identical job is already waiting, and returns the job.
+func (s *CompletionService) QueueIndexDirectory(root string) *IndexJob {
+	q := s.jobs
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	for _, job := range q.pending {
+		if job.status.Kind == "directory" && job.status.Path == root {
+			return job
+		}
+	}
+	job := q.add(IndexJobStatus{Kind: "directory", Path: root}, nil)
+	s.startIndexWorker()
+	return job
+}
+
+// QueueFileChanges queues re-indexing paths and returns the job. Paths
+// under a directory waiting to be indexed are covered by that job, and
+// paths joining a queued file job are merged into it.
+func (s *CompletionService) QueueFileChanges(paths []string) *IndexJob {
+	q := s.jobs
+	q.mu.Lock()
+	defer q.mu.Unlock()
+
+	var files *IndexJob
+	uncovered := paths[:0:0]
+	for _, path := range paths {
+		covered := false
+		for _, job := range q.pending {
+			if job.status.Kind == "directory" && containsPath(job.status.Path, path) {
+				covered = true
+				break
+			}
+		}
+		if !covered {
+			uncovered = append(uncovered, path)
+		}
+	}
+	for _, job := range q.pending {
+		if job.status.Kind == "directory" && len(uncovered) == 0 {
+			return job
+		}
+		if job.status.Kind == "files" {
+			files = job
+		}
+	}
+	if files == nil {
+		files = q.add(IndexJobStatus{Kind: "files"}, make(map[string]bool))
+		s.startIndexWorker()
+	}
+	for _, path := range uncovered {
+		files.paths[path] = true
+	}
+	files.status.Files = len(files.paths)
+	return files
+}
+
+// IndexJobs returns the finished, running and queued indexing jobs, oldest
+// first.
+func (s *CompletionService) IndexJobs() []IndexJobStatus {
+	q := s.jobs
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	jobs := make([]IndexJobStatus, 0, len(q.history)+1+len(q.pending))
+	for _, job := range q.history {
+		jobs = append(jobs, job.snapshot())
+	}
+	if q.running != nil {
+		jobs = append(jobs, q.running.snapshot())
+	}
+	for _, job := range q.pending {
+		jobs = append(jobs, job.snapshot())
+	}
+	return jobs
+}
+
+// add queues a new job. q.mu must be held.
+func (q *indexQueue) add(status IndexJobStatus, paths map[string]bool) *IndexJob {
+	q.nextID++
+	status.ID = q.nextID
+	status.State = "queued"
+	status.Queued = time.Now()
+	job := &IndexJob{status: status, paths: paths, finished: make(chan struct{})}
+	if q.closed {
+		q.finish(job, errIndexQueueClosed)
+		return job
+	}
+	q.pending = append(q.pending, job)
+	return job
+}
+
+// finish records the outcome of job and releases its waiters. q.mu must be
+// held.
+func (q *indexQueue) finish(job *IndexJob, err error) {
+	job.status.State = "done"
+	if err != nil {
+		job.status.State = "failed"
+		job.status.Error = err.Error()
+	}
+	job.status.Finished = time.Now()
+	q.history = append(q.history, job)
+	if len(q.history) > indexJobHistory {
+		q.history = q.history[len(q.history)-indexJobHistory:]
+	}
+	close(job.finished)
+}
+
+// snapshot returns the status of job. The queue's mu must be held.
+func (j *IndexJob) snapshot() IndexJobStatus {
+	status := j.status
+	status.Done, status.Total = j.done.Load(), j.total.Load()
+	return status
+}
+
+// startIndexWorker starts the goroutine running queued jobs unless it is
+// running already. s.jobs.mu must be held.
+func (s *CompletionService) startIndexWorker() {
+	q := s.jobs
+	if q.idle != nil || q.closed {
+		return
+	}
+	idle := make(chan struct{})
+	q.idle = idle
+	go func() {
+		defer close(idle)
+		for {
+			q.mu.Lock()
+			if len(q.pending) == 0 {
+				q.idle = nil
+				q.mu.Unlock()
+				return
+			}
+			job := q.pending[0]
+			q.pending = q.pending[1:]
+			job.status.State = "running"
+			job.status.Started = time.Now()
+			q.running = job
+			q.mu.Unlock()
+
+			err := s.runIndexJob(q.ctx, job)
+
+			q.mu.Lock()
+			q.running = nil
+			q.finish(job, err)
+			q.mu.Unlock()
+		}
+	}()
+}
+
+// runIndexJob does the work of job, giving up when ctx is done.
+func (s *CompletionService) runIndexJob(ctx context.Context, job *IndexJob) error {
+	if job.status.Kind == "directory" {
+		root := job.status.Path
+		if err := s.indexDirectory(ctx, root); err != nil {
+			log.ErrorLogger.Printf("ERROR: Failed to index directory async: %v", err)
+			return err
+		}
+		log.InfoLogger.Printf("Async indexing completed for directory: %s", root)
+		if err := s.WatchDirectory(root); err != nil {
+			log.ErrorLogger.Printf("⚠️ Failed to watch directory %s: %v", root, err)
+		}
+		return nil
+	}
+
+	// The path set is no longer shared once the job has left the queue.
+	paths := make([]string, 0, len(job.paths))
+	for path := range job.paths {
+		paths = append(paths, path)
+	}
+	s.applyFileChanges(withWorkClass(ctx, classFileIndex), paths)
+	return ctx.Err()
+}
+
+// reportProgress adds to the progress of the running job, if any.
+func (s *CompletionService) reportProgress(done, total int64) {
+	q := s.jobs
+	q.mu.Lock()
+	job := q.running
+	q.mu.Unlock()
+	if job != nil {
+		job.done.Add(done)
+		job.total.Add(total)
+	}
+}
+
+// closeJobs fails queued jobs, gives up the running one and waits for it to
+// stop.
+func (s *CompletionService) closeJobs() {
+	if idle := s.stopJobs(); idle != nil {
+		<-idle
+	}
+}
+
+// stopJobs fails queued jobs and gives up the running one without waiting
+// for it. It returns a channel closed once the running job has stopped, or
+// nil if none runs.
+func (s *CompletionService) stopJobs() <-chan struct{} {
+	q := s.jobs
+	q.mu.Lock()
+	defer q.mu.Unlock()
+	q.closed = true
+	q.cancel()
+	for _, job := range q.pending {
+		q.finish(job, errIndexQueueClosed)
+	}
+	q.pending = nil
+	return q.idle
+}
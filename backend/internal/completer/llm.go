@@ -0,0 +1,268 @@
+package completer
+
+import (
+	"context"
+	"sort"
+	"strings"
+	"sync"
+	"time"
+
+	"autocomplete/backend/internal/log"
+)
+
+// CompletionProvider generates code completions from a prompt.
+type CompletionProvider interface {
+	// Complete returns the whole completion for prompt.
+	Complete(ctx context.Context, prompt string) (string, error)
+	// GetCompletionStream sends the completion for prompt to ch as it is
+	// generated and closes ch when done. The error tells a finished
+	// completion (nil) from one cut short by a failure or by ctx.
+	GetCompletionStream(ctx context.Context, prompt string, ch chan<- string) error
+}
+
+// NewCompletionProvider returns the LLM configured to generate completions,
+// hedged to its backup when hedging is enabled. openaiAPIKey authenticates
+// requests to OpenAI.
+func NewCompletionProvider(config *Config, openaiAPIKey string) CompletionProvider {
+	newProvider := func(kind string) CompletionProvider {
+		if kind == "local" {
+			log.InfoLogger.Printf("🤖 Using local completion model %s at %s", config.Completion.LocalModel, config.Completion.LocalURL)
+			return NewOpenAICompatibleClient(config.Completion.LocalURL, "", config.Completion.LocalModel)
+		}
+		log.InfoLogger.Printf("🤖 Using OpenAI completion model %s", config.CompletionModelName())
+		return NewOpenAICompatibleClient("", openaiAPIKey, config.CompletionModelName())
+	}
+
+	primary := newProvider(config.Completion.Provider)
+	var backup CompletionProvider
+	switch config.Completion.Hedge {
+	case "":
+		return primary
+	case "primary":
+		backup = primary
+	default:
+		backup = newProvider(config.Completion.Hedge)
+	}
+	log.InfoLogger.Printf("🤖 Hedging completions to %s after p%g time to first token", config.Completion.Hedge, config.Completion.HedgePercentile)
+	return newHedgedProvider(primary, backup, config.Completion.HedgePercentile/100)
+}
+
+const (
+	// hedgeMinSamples is how many first tokens must have been timed before
+	// the hedging budget is trusted.
+	hedgeMinSamples = 20
+	// hedgeWindow is how many of the primary's latest times to first token
+	// the hedging budget is taken from.
+	hedgeWindow = 200
+)
+
+// hedgedProvider bounds tail latency when the primary provider slows down.
+// A request that has produced no token within the given quantile of observed
+// time to first token is sent to the backup as well, and whichever attempt
+// produces a token first is used while the other is cancelled. A primary
+// failing before its first token fails over to the backup at once. Only the
+// slowest few percent of requests are duplicated, so the extra cost is small.
+type hedgedProvider struct {
+	primary  CompletionProvider
+	backup   CompletionProvider
+	quantile float64
+
+	// firstToken holds the primary's recent times to first token. A primary
+	// cancelled because the backup answered first counts as taking at least
+	// the budget it overran.
+	firstToken *latencyWindow
+}
+
+func newHedgedProvider(primary, backup CompletionProvider, quantile float64) *hedgedProvider {
+	return &hedgedProvider{
+		primary:    primary,
+		backup:     backup,
+		quantile:   quantile,
+		firstToken: newLatencyWindow(hedgeWindow),
+	}
+}
+
+// budget returns how long the primary may take to its first token before
+// the request is hedged, and false while too few requests have been timed.
+func (h *hedgedProvider) budget() (time.Duration, bool) {
+	latency, samples := h.firstToken.quantile(h.quantile)
+	if samples < hedgeMinSamples {
+		return 0, false
+	}
+	return latency, true
+}
+
+// latencyWindow keeps the latest latencies of a provider, so estimates taken
+// from it follow the provider's current speed rather than its whole history.
+type latencyWindow struct {
+	mu      sync.Mutex
+	samples []time.Duration
+	next    int // Where the next sample goes once samples is full
+}
+
+func newLatencyWindow(size int) *latencyWindow {
+	return &latencyWindow{samples: make([]time.Duration, 0, size)}
+}
+
+// observe adds a latency, replacing the oldest one when the window is full.
+func (w *latencyWindow) observe(latency time.Duration) {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	if len(w.samples) < cap(w.samples) {
+		w.samples = append(w.samples, latency)
+		return
+	}
+	w.samples[w.next] = latency
+	w.next = (w.next + 1) % len(w.samples)
+}
+
+// quantile returns the q-quantile of the latencies in the window and how
+// many there are.
+func (w *latencyWindow) quantile(q float64) (time.Duration, int) {
+	w.mu.Lock()
+	sorted := append([]time.Duration(nil), w.samples...)
+	w.mu.Unlock()
+	if len(sorted) == 0 {
+		return 0, 0
+	}
+	sort.Slice(sorted, func(i, j int) bool { return sorted[i] < sorted[j] })
+	rank := int(q * float64(len(sorted)))
+	return sorted[min(max(rank, 0), len(sorted)-1)], len(sorted)
+}
+
+// hedgeAttempt is one request of a hedged completion.
+type hedgeAttempt struct {
+	tokens chan string
+	err    chan error
+	cancel context.CancelFunc
+}
+
+func startAttempt(ctx context.Context, provider CompletionProvider, prompt string) *hedgeAttempt {
+	ctx, cancel := context.WithCancel(ctx)
+	a := &hedgeAttempt{tokens: make(chan string), err: make(chan error, 1), cancel: cancel}
+	go func() { a.err <- provider.GetCompletionStream(ctx, prompt, a.tokens) }()
+	return a
+}
+
+// stop cancels an attempt that is no longer wanted and drains it so its
+// request goroutine can exit.
+func (a *hedgeAttempt) stop() {
+	a.cancel()
+	go func() {
+		for range a.tokens {
+		}
+	}()
+}
+
+func (h *hedgedProvider) GetCompletionStream(ctx context.Context, prompt string, ch chan<- string) error {
+	defer close(ch)
+
+	start := time.Now()
+	attempts := [2]*hedgeAttempt{startAttempt(ctx, h.primary, prompt)}
+	hedged := false
+	hedge := func() {
+		hedged = true
+		attempts[1] = startAttempt(ctx, h.backup, prompt)
+		completionHedges.Inc()
+	}
+	var timeout <-chan time.Time
+	budget, ok := h.budget()
+	if ok {
+		timer := time.NewTimer(budget)
+		defer timer.Stop()
+		timeout = timer.C
+	}
+
+	// Race the attempts to their first token.
+	winner := -1
+	var first string
+	empty := false
+	for winner < 0 {
+		var tokens [2]chan string
+		for i, a := range attempts {
+			if a != nil {
+				tokens[i] = a.tokens
+			}
+		}
+		var i int
+		var token string
+		var ok bool
+		select {
+		case <-timeout:
+			timeout = nil
+			if !hedged {
+				hedge()
+			}
+			continue
+		case token, ok = <-tokens[0]:
+			i = 0
+		case token, ok = <-tokens[1]:
+			i = 1
+		}
+		if ok {
+			winner, first = i, token
+			break
+		}
+
+		// Attempt i ended without a token: an empty completion, or a failure
+		// the other attempt may still make up for.
+		err := <-attempts[i].err
+		if err == nil {
+			winner, empty = i, true
+			break
+		}
+		attempts[i] = nil
+		if attempts[1-i] != nil {
+			continue
+		}
+		if i == 0 && !hedged && ctx.Err() == nil {
+			log.ErrorLogger.Printf("⚠️ Primary completion request failed, trying backup: %v", err)
+			hedge()
+			continue
+		}
+		return err
+	}
+	if loser := attempts[1-winner]; loser != nil {
+		loser.stop()
+	}
+	if winner == 0 {
+		h.firstToken.observe(time.Since(start))
+	} else {
+		completionHedgeWins.Inc()
+		if attempts[0] != nil {
+			h.firstToken.observe(max(time.Since(start), budget))
+		}
+	}
+	if empty {
+		return nil
+	}
+
+	w := attempts[winner]
+	for token := first; ; {
+		select {
+		case ch <- token:
+		case <-ctx.Done():
+			w.stop()
+			return ctx.Err()
+		}
+		var ok bool
+		if token, ok = <-w.tokens; !ok {
+			return <-w.err
+		}
+	}
+}
+
+func (h *hedgedProvider) Complete(ctx context.Context, prompt string) (string, error) {
+	tokens := make(chan string)
+	streamErr := make(chan error, 1)
+	go func() { streamErr <- h.GetCompletionStream(ctx, prompt, tokens) }()
+
+	var completion strings.Builder
+	for token := range tokens {
+		completion.WriteString(token)
+	}
+	if err := <-streamErr; err != nil {
+		return "", err
+	}
+	return completion.String(), nil
+}
@@ -0,0 +1,110 @@
+package completer
+
+import (
+	"context"
+	"errors"
+	"sync/atomic"
+	"testing"
+	"time"
+)
+
+// fakeProvider streams tokens after a delay, or fails with err.
+type fakeProvider struct {
+	delay  time.Duration
+	tokens []string
+	err    error
+
+	calls    atomic.Int64
+	canceled atomic.Int64
+}
+
+func (p *fakeProvider) Complete(ctx context.Context, prompt string) (string, error) {
+	panic("hedgedProvider completes through GetCompletionStream")
+}
+
+func (p *fakeProvider) GetCompletionStream(ctx context.Context, prompt string, ch chan<- string) error {
+	defer close(ch)
+	p.calls.Add(1)
+	select {
+	case <-time.After(p.delay):
+	case <-ctx.Done():
+		p.canceled.Add(1)
+		return ctx.Err()
+	}
+	if p.err != nil {
+		return p.err
+	}
+	for _, token := range p.tokens {
+		select {
+		case ch <- token:
+		case <-ctx.Done():
+			p.canceled.Add(1)
+			return ctx.Err()
+		}
+	}
+	return nil
+}
+
+func TestHedgedProviderFailsOverWhenPrimaryFails(t *testing.T) {
+	primary := &fakeProvider{err: errors.New("primary down")}
+	backup := &fakeProvider{tokens: []string{"return ", "1"}}
+	h := newHedgedProvider(primary, backup, 0.95)
+
+	completion, err := h.Complete(context.Background(), "prompt")
+	if err != nil || completion != "return 1" {
+		t.Fatalf("Complete with a failing primary = %q, %v, want the backup's completion", completion, err)
+	}
+	// A failed primary says nothing about its time to first token.
+	if _, samples := h.firstToken.quantile(0.5); samples != 0 {
+		t.Fatalf("%d first token times recorded for a failed primary", samples)
+	}
+}
+
+func TestHedgedProviderReturnsErrorWhenBothFail(t *testing.T) {
+	errBackup := errors.New("backup down")
+	primary := &fakeProvider{err: errors.New("primary down")}
+	backup := &fakeProvider{err: errBackup}
+	h := newHedgedProvider(primary, backup, 0.95)
+
+	if _, err := h.Complete(context.Background(), "prompt"); !errors.Is(err, errBackup) {
+		t.Fatalf("Complete with both providers failing returned %v", err)
+	}
+	if primary.calls.Load() != 1 || backup.calls.Load() != 1 {
+		t.Fatalf("primary called %d times, backup %d, want once each", primary.calls.Load(), backup.calls.Load())
+	}
+}
+
+func TestHedgedProviderHedgesPrimarySlowerThanItsBudget(t *testing.T) {
+	primary := &fakeProvider{delay: time.Minute, tokens: []string{"slow"}}
+	backup := &fakeProvider{tokens: []string{"fast"}}
+	h := newHedgedProvider(primary, backup, 0.95)
+
+	// Without enough samples the request is not hedged.
+	ctx, cancel := context.WithTimeout(context.Background(), 50*time.Millisecond)
+	defer cancel()
+	if _, err := h.Complete(ctx, "prompt"); !errors.Is(err, context.DeadlineExceeded) {
+		t.Fatalf("Complete before the budget is known returned %v, want the deadline", err)
+	}
+	if backup.calls.Load() != 0 {
+		t.Fatal("hedged before enough first tokens were timed")
+	}
+
+	const budget = 10 * time.Millisecond
+	for i := 0; i < hedgeMinSamples; i++ {
+		h.firstToken.observe(budget)
+	}
+	start := time.Now()
+	completion, err := h.Complete(context.Background(), "prompt")
+	if err != nil || completion != "fast" {
+		t.Fatalf("Complete with a slow primary = %q, %v, want the backup's completion", completion, err)
+	}
+	if elapsed := time.Since(start); elapsed > 5*time.Second {
+		t.Fatalf("hedged completion took %v", elapsed)
+	}
+	eventually(t, "the slow primary to be canceled", func() bool { return primary.canceled.Load() == 2 })
+
+	// The primary that lost counts as taking at least its budget.
+	if latency, samples := h.firstToken.quantile(1); samples != hedgeMinSamples+1 || latency < budget {
+		t.Fatalf("first token window holds %d samples up to %v after a hedge win", samples, latency)
+	}
+}
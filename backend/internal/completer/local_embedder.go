@@ -3,13 +3,19 @@ package completer
 import (
 	"autocomplete/backend/internal/log"
 	"bytes"
+	"context"
 	"encoding/json"
 	"fmt"
 	"io"
 	"net/http"
+	"sync"
 	"time"
 )
 
+// ollamaFanOutConcurrency bounds concurrent requests when batching against
+// Ollama, which only embeds a single prompt per request.
+const ollamaFanOutConcurrency = 4
+
 // LocalEmbedder implements the Embedder interface using a local embedding server
 type LocalEmbedder struct {
 	config     LocalConfig
@@ -38,13 +44,76 @@ func NewLocalEmbedder(config LocalConfig) (*LocalEmbedder, error) {
 }
 
 // Embed creates a vector embedding for the given text using the local server
-func (e *LocalEmbedder) Embed(text string) ([]float32, error) {
-	requestBody, err := e.createRequestBody([]string{text})
+func (e *LocalEmbedder) Embed(ctx context.Context, text string) ([]float32, error) {
+	embeddings, err := e.requestEmbeddings(ctx, []string{text})
+	if err != nil {
+		return nil, err
+	}
+	return embeddings[0], nil
+}
+
+// BatchEmbed creates embeddings for several texts. TEI and custom servers
+// accept all texts in one request; Ollama only embeds one prompt per request,
+// so its batches fan out over a small number of concurrent requests.
+func (e *LocalEmbedder) BatchEmbed(ctx context.Context, texts []string) ([][]float32, error) {
+	if len(texts) == 0 {
+		return nil, nil
+	}
+	if e.config.ServerType == "ollama" {
+		return e.fanOutEmbed(ctx, texts)
+	}
+
+	embeddings, err := e.requestEmbeddings(ctx, texts)
+	if err != nil {
+		return nil, err
+	}
+	if len(embeddings) != len(texts) {
+		return nil, fmt.Errorf("local embedding server returned %d embeddings for %d texts", len(embeddings), len(texts))
+	}
+	return embeddings, nil
+}
+
+// fanOutEmbed embeds texts one request each, with at most
+// ollamaFanOutConcurrency requests in flight.
+func (e *LocalEmbedder) fanOutEmbed(ctx context.Context, texts []string) ([][]float32, error) {
+	embeddings := make([][]float32, len(texts))
+	errs := make([]error, len(texts))
+	semaphore := make(chan struct{}, ollamaFanOutConcurrency)
+	var wg sync.WaitGroup
+
+	for i, text := range texts {
+		wg.Add(1)
+		semaphore <- struct{}{}
+		go func(i int, text string) {
+			defer wg.Done()
+			defer func() { <-semaphore }()
+			embeddings[i], errs[i] = e.Embed(ctx, text)
+		}(i, text)
+	}
+	wg.Wait()
+
+	for i, err := range errs {
+		if err != nil {
+			return nil, fmt.Errorf("failed to embed text %d: %w", i, err)
+		}
+	}
+	return embeddings, nil
+}
+
+// requestEmbeddings sends one embedding request for texts and returns the
+// parsed embeddings.
+func (e *LocalEmbedder) requestEmbeddings(ctx context.Context, texts []string) ([][]float32, error) {
+	requestBody, err := e.createRequestBody(texts)
 	if err != nil {
 		return nil, fmt.Errorf("failed to create request body: %w", err)
 	}
 
-	resp, err := e.httpClient.Post(e.getEmbedEndpoint(), "application/json", bytes.NewBuffer(requestBody))
+	req, err := http.NewRequestWithContext(ctx, http.MethodPost, e.getEmbedEndpoint(), bytes.NewBuffer(requestBody))
+	if err != nil {
+		return nil, fmt.Errorf("failed to create request: %w", err)
+	}
+	req.Header.Set("Content-Type", "application/json")
+	resp, err := e.httpClient.Do(req)
 	if err != nil {
 		return nil, fmt.Errorf("failed to make request to local embedding server: %w", err)
 	}
@@ -55,16 +124,16 @@ func (e *LocalEmbedder) Embed(text string) ([]float32, error) {
 		return nil, fmt.Errorf("local embedding server returned status %d: %s", resp.StatusCode, string(bodyBytes))
 	}
 
-	embedding, err := e.parseResponse(resp.Body)
+	embeddings, err := e.parseResponse(resp.Body)
 	if err != nil {
 		return nil, fmt.Errorf("failed to parse embedding response: %w", err)
 	}
 
-	if len(embedding) == 0 {
+	if len(embeddings) == 0 {
 		return nil, fmt.Errorf("received empty embedding from local server")
 	}
 
-	return embedding[0], nil
+	return embeddings, nil
 }
 
 // GetDimensions returns the embedding dimensions
@@ -77,7 +146,7 @@ func (e *LocalEmbedder) detectDimensions() (int, error) {
 	log.InfoLogger.Printf("🔍 Auto-detecting embedding dimensions for local server at %s", e.config.ServerURL)
 
 	testText := "test"
-	embedding, err := e.embedSingle(testText)
+	embedding, err := e.Embed(context.Background(), testText)
 	if err != nil {
 		return 0, fmt.Errorf("failed to make test embedding request: %w", err)
 	}
@@ -91,36 +160,6 @@ func (e *LocalEmbedder) detectDimensions() (int, error) {
 	return dimensions, nil
 }
 
-// embedSingle makes a single embedding request (used for dimension detection)
-func (e *LocalEmbedder) embedSingle(text string) ([]float32, error) {
-	requestBody, err := e.createRequestBody([]string{text})
-	if err != nil {
-		return nil, err
-	}
-
-	resp, err := e.httpClient.Post(e.getEmbedEndpoint(), "application/json", bytes.NewBuffer(requestBody))
-	if err != nil {
-		return nil, err
-	}
-	defer resp.Body.Close()
-
-	if resp.StatusCode != http.StatusOK {
-		bodyBytes, _ := io.ReadAll(resp.Body)
-		return nil, fmt.Errorf("server returned status %d: %s", resp.StatusCode, string(bodyBytes))
-	}
-
-	embeddings, err := e.parseResponse(resp.Body)
-	if err != nil {
-		return nil, err
-	}
-
-	if len(embeddings) == 0 {
-		return nil, fmt.Errorf("received empty embeddings")
-	}
-
-	return embeddings[0], nil
-}
-
 // getEmbedEndpoint returns the embedding endpoint URL based on server type
 func (e *LocalEmbedder) getEmbedEndpoint() string {
 	baseURL := e.config.ServerURL
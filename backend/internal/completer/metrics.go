@@ -0,0 +1,75 @@
+package completer
+
+import "autocomplete/backend/internal/metrics"
+
+// Per-stage instrumentation of the completion pipeline, served on /metrics.
+var (
+	completionLatency = metrics.NewHistogram("completion_seconds",
+		"End-to-end latency of completion requests.", metrics.LatencyBuckets)
+	queryEmbedLatency = metrics.NewHistogram("completion_embed_seconds",
+		"Latency of embedding the completion query.", metrics.LatencyBuckets)
+	vectorSearchLatency = metrics.NewHistogram("completion_vector_search_seconds",
+		"Latency of the vector store query.", metrics.LatencyBuckets)
+	queryWindowBytes = metrics.NewHistogram("completion_query_window_bytes",
+		"Size of the code window embedded as the retrieval query.", metrics.ExponentialBuckets(64, 2, 10))
+	promptBuildLatency = metrics.NewHistogram("completion_prompt_build_seconds",
+		"Latency of building the LLM prompt.", metrics.LatencyBuckets)
+	promptBytes = metrics.NewHistogram("completion_prompt_bytes",
+		"Size of the LLM prompt in bytes.", metrics.ExponentialBuckets(256, 2, 14))
+	promptTokens = metrics.NewHistogram("completion_prompt_tokens",
+		"Estimated size of the LLM prompt in tokens.", metrics.ExponentialBuckets(64, 2, 14))
+	llmTimeToFirstToken = metrics.NewHistogram("completion_llm_time_to_first_token_seconds",
+		"Time from sending the LLM request to receiving the first token.", metrics.LatencyBuckets)
+	llmLatency = metrics.NewHistogram("completion_llm_seconds",
+		"Total latency of the LLM request.", metrics.LatencyBuckets)
+
+	embeddingCacheHits = metrics.NewCounter("embedding_cache_hits_total",
+		"Chunk embedding lookups served from the cache.")
+	embeddingCacheMisses = metrics.NewCounter("embedding_cache_misses_total",
+		"Chunk embedding lookups that required an embedding call.")
+	queryCacheHits = metrics.NewCounter("query_embedding_cache_hits_total",
+		"Completion query embeddings served from the cache.")
+	queryCacheMisses = metrics.NewCounter("query_embedding_cache_misses_total",
+		"Completion query embeddings that required an embedding call.")
+	completionsSuperseded = metrics.NewCounter("completion_superseded_total",
+		"Completion requests cancelled by a newer request for the same file.")
+	streamEarlyStops = metrics.NewCounter("completion_stream_early_stops_total",
+		"Streamed completions cut off after their first statement or block.")
+	typeaheadHits = metrics.NewCounter("completion_typeahead_hits_total",
+		"Completions answered from the previous completion the user typed into.")
+	typeaheadMisses = metrics.NewCounter("completion_typeahead_misses_total",
+		"Completions that ran the retrieval and LLM pipeline.")
+	completionHedges = metrics.NewCounter("completion_hedges_total",
+		"LLM requests sent to the backup after the primary missed its time to first token budget or failed.")
+	completionHedgeWins = metrics.NewCounter("completion_hedge_wins_total",
+		"Hedged LLM requests answered by the backup first.")
+	// Time embedding requests spend waiting for the scheduler, by class.
+	schedulerWait = [workClasses]*metrics.Histogram{
+		classInteractive: metrics.NewHistogram("embedding_wait_interactive_seconds",
+			"Time completion query embeddings waited to be scheduled.", metrics.LatencyBuckets),
+		classFileIndex: metrics.NewHistogram("embedding_wait_file_index_seconds",
+			"Time file re-indexing embeddings waited to be scheduled.", metrics.LatencyBuckets),
+		classBulkIndex: metrics.NewHistogram("embedding_wait_bulk_index_seconds",
+			"Time directory indexing embeddings waited to be scheduled.", metrics.LatencyBuckets),
+	}
+	// Time vector store operations spend waiting for the scheduler, by class.
+	storeWait = [workClasses]*metrics.Histogram{
+		classInteractive: metrics.NewHistogram("vector_store_wait_interactive_seconds",
+			"Time completion query searches waited to be scheduled.", metrics.LatencyBuckets),
+		classFileIndex: metrics.NewHistogram("vector_store_wait_file_index_seconds",
+			"Time vector store updates from file re-indexing waited to be scheduled.", metrics.LatencyBuckets),
+		classBulkIndex: metrics.NewHistogram("vector_store_wait_bulk_index_seconds",
+			"Time vector store loads from directory indexing waited to be scheduled.", metrics.LatencyBuckets),
+	}
+
+	workspaceLoads = metrics.NewCounter("workspace_loads_total",
+		"Workspace indexes loaded, including reloads after eviction.")
+	workspaceEvictions = metrics.NewCounter("workspace_evictions_total",
+		"Workspace indexes unloaded to stay within the memory budget.")
+)
+
+// estimateTokens approximates the token count of text for GPT-style
+// tokenizers, which average about four bytes per token on source code.
+func estimateTokens(text string) int {
+	return (len(text) + 3) / 4
+}
@@ -4,7 +4,10 @@ import (
 	"autocomplete/backend/internal/log"
 	"context"
 	"errors"
+	"fmt"
 	"io"
+	"strings"
+	"time"
 
 	"github.com/sashabaranov/go-openai"
 )
@@ -12,33 +15,56 @@ import (
 // Default embedding model - can be overridden via configuration
 const DefaultEmbeddingModel openai.EmbeddingModel = "text-embedding-3-small"
 
-// OpenAIClient is a client for interacting with the OpenAI API.
-// It implements the Embedder interface.
+// Default completion model - can be overridden via configuration
+const DefaultCompletionModel = "gpt-4.1-nano"
+
+// OpenAIClient is a client for interacting with the OpenAI API or any server
+// exposing the same API. It implements the Embedder and CompletionProvider
+// interfaces.
 type OpenAIClient struct {
-	client         *openai.Client
-	embeddingModel openai.EmbeddingModel
+	client          *openai.Client
+	embeddingModel  openai.EmbeddingModel
+	completionModel string
 }
 
 // NewOpenAIClient creates a new OpenAI client with default embedding model.
 func NewOpenAIClient(apiKey string) *OpenAIClient {
 	return &OpenAIClient{
-		client:         openai.NewClient(apiKey),
-		embeddingModel: DefaultEmbeddingModel,
+		client:          openai.NewClient(apiKey),
+		embeddingModel:  DefaultEmbeddingModel,
+		completionModel: DefaultCompletionModel,
 	}
 }
 
 // NewOpenAIClientWithModel creates a new OpenAI client with a specific embedding model.
 func NewOpenAIClientWithModel(apiKey string, model string) *OpenAIClient {
 	return &OpenAIClient{
-		client:         openai.NewClient(apiKey),
-		embeddingModel: openai.EmbeddingModel(model),
+		client:          openai.NewClient(apiKey),
+		embeddingModel:  openai.EmbeddingModel(model),
+		completionModel: DefaultCompletionModel,
+	}
+}
+
+// NewOpenAICompatibleClient creates a client generating completions with
+// model. An empty baseURL talks to OpenAI; otherwise it names the /v1
+// endpoint of an OpenAI-compatible server such as llama.cpp's server or
+// Ollama, which need no API key.
+func NewOpenAICompatibleClient(baseURL, apiKey, model string) *OpenAIClient {
+	clientConfig := openai.DefaultConfig(apiKey)
+	if baseURL != "" {
+		clientConfig.BaseURL = baseURL
+	}
+	return &OpenAIClient{
+		client:          openai.NewClientWithConfig(clientConfig),
+		embeddingModel:  DefaultEmbeddingModel,
+		completionModel: model,
 	}
 }
 
 // Embed creates a vector embedding for the given text using the specified model.
-func (c *OpenAIClient) Embed(text string) ([]float32, error) {
+func (c *OpenAIClient) Embed(ctx context.Context, text string) ([]float32, error) {
 	resp, err := c.client.CreateEmbeddings(
-		context.Background(),
+		ctx,
 		openai.EmbeddingRequest{
 			Input: []string{text},
 			Model: c.embeddingModel,
@@ -50,32 +76,87 @@ func (c *OpenAIClient) Embed(text string) ([]float32, error) {
 	return resp.Data[0].Embedding, nil
 }
 
+// BatchEmbed creates embeddings for several texts in a single API request.
+func (c *OpenAIClient) BatchEmbed(ctx context.Context, texts []string) ([][]float32, error) {
+	if len(texts) == 0 {
+		return nil, nil
+	}
+	resp, err := c.client.CreateEmbeddings(
+		ctx,
+		openai.EmbeddingRequest{
+			Input: texts,
+			Model: c.embeddingModel,
+		},
+	)
+	if err != nil {
+		return nil, err
+	}
+	if len(resp.Data) != len(texts) {
+		return nil, fmt.Errorf("expected %d embeddings, got %d", len(texts), len(resp.Data))
+	}
+
+	// The API reports each embedding's input position; don't rely on ordering.
+	embeddings := make([][]float32, len(texts))
+	for _, item := range resp.Data {
+		if item.Index < 0 || item.Index >= len(texts) {
+			return nil, fmt.Errorf("embedding index %d out of range", item.Index)
+		}
+		embeddings[item.Index] = item.Embedding
+	}
+	return embeddings, nil
+}
+
 // Complete generates a code completion for the given prompt.
-func (c *OpenAIClient) Complete(prompt string) (string, error) {
-	resp, err := c.client.CreateChatCompletion(
-		context.Background(),
+// The response is streamed internally so time-to-first-token can be measured,
+// and generation stops when ctx is done.
+func (c *OpenAIClient) Complete(ctx context.Context, prompt string) (string, error) {
+	start := time.Now()
+	stream, err := c.client.CreateChatCompletionStream(
+		ctx,
 		openai.ChatCompletionRequest{
-			Model: "gpt-4.1-nano",
+			Model: c.completionModel,
 			Messages: []openai.ChatCompletionMessage{
 				{
 					Role:    openai.ChatMessageRoleUser,
 					Content: prompt,
 				},
 			},
+			Stream: true,
 		},
 	)
 	if err != nil {
 		return "", err
 	}
-	return resp.Choices[0].Message.Content, nil
+	defer stream.Close()
+
+	var completion strings.Builder
+	for {
+		response, err := stream.Recv()
+		if errors.Is(err, io.EOF) {
+			llmLatency.ObserveSince(start)
+			return completion.String(), nil
+		}
+		if err != nil {
+			return "", err
+		}
+		if len(response.Choices) == 0 || response.Choices[0].Delta.Content == "" {
+			continue
+		}
+		if completion.Len() == 0 {
+			llmTimeToFirstToken.ObserveSince(start)
+		}
+		completion.WriteString(response.Choices[0].Delta.Content)
+	}
 }
 
 // GetCompletionStream generates a code completion for the given prompt and streams the response.
-func (c *OpenAIClient) GetCompletionStream(prompt string, ch chan<- string) {
+// ch is closed when the stream ends; the error tells a finished completion
+// (nil) from one cut short by a failure or by ctx.
+func (c *OpenAIClient) GetCompletionStream(ctx context.Context, prompt string, ch chan<- string) error {
 	defer close(ch)
 
 	req := openai.ChatCompletionRequest{
-		Model: "gpt-4.1-nano",
+		Model: c.completionModel,
 		Messages: []openai.ChatCompletionMessage{
 			{
 				Role:    openai.ChatMessageRoleUser,
@@ -85,28 +166,40 @@ func (c *OpenAIClient) GetCompletionStream(prompt string, ch chan<- string) {
 		Stream: true,
 	}
 
-	stream, err := c.client.CreateChatCompletionStream(context.Background(), req)
+	start := time.Now()
+	stream, err := c.client.CreateChatCompletionStream(ctx, req)
 	if err != nil {
 		log.ErrorLogger.Printf("CreateChatCompletionStream error: %v", err)
-		return
+		return err
 	}
 	defer stream.Close()
 
+	receivedFirstToken := false
 	for {
 		response, err := stream.Recv()
 		if errors.Is(err, io.EOF) {
+			llmLatency.ObserveSince(start)
 			log.InfoLogger.Println("Stream finished.")
-			return
+			return nil
 		}
 
 		if err != nil {
-			log.ErrorLogger.Printf("Stream error: %v", err)
-			return
+			if ctx.Err() == nil {
+				log.ErrorLogger.Printf("Stream error: %v", err)
+			}
+			return err
 		}
 
-		if len(response.Choices) > 0 {
-			log.InfoLogger.Printf("Received chunk: %s", response.Choices[0].Delta.Content)
-			ch <- response.Choices[0].Delta.Content
+		if len(response.Choices) > 0 && response.Choices[0].Delta.Content != "" {
+			if !receivedFirstToken {
+				receivedFirstToken = true
+				llmTimeToFirstToken.ObserveSince(start)
+			}
+			select {
+			case ch <- response.Choices[0].Delta.Content:
+			case <-ctx.Done():
+				return ctx.Err()
+			}
 		}
 	}
 }
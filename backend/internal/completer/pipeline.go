@@ -0,0 +1,239 @@
+package completer
+
+import (
+	"context"
+	"io/fs"
+	"os"
+	"runtime"
+	"strings"
+	"sync"
+
+	"autocomplete/backend/internal/cache"
+	"autocomplete/backend/internal/indexer"
+	"autocomplete/backend/internal/log"
+)
+
+// ignoredDirs are never descended into when indexing a directory.
+var ignoredDirs = map[string]bool{
+	"node_modules": true,
+	"vendor":       true,
+	"dist":         true,
+	"build":        true,
+	"__pycache__":  true,
+	"venv":         true,
+}
+
+// embeddedChunk pairs a chunk with its embedding; embedding is nil when the
+// chunk could not be embedded. Chunks reach the writer out of order, so each
+// carries its position in the file's chunk list, which Chunk.Parent refers
+// to, and the length of that list.
+type embeddedChunk struct {
+	chunk      indexer.Chunk
+	position   int
+	fileChunks int
+	embedding  []float32
+}
+
+// chunkedFile is a parsed file on its way to the embedders.
+type chunkedFile struct {
+	path   string
+	meta   fileMeta
+	chunks []indexer.Chunk
+}
+
+// runIndexPipeline indexes every file under root through a staged pipeline:
+// a parallel directory walker, a pool of chunkers, a pool of rate-limited
+// embedders and a single writer, connected by bounded channels. Stages run
+// concurrently, so cold indexing takes roughly as long as the slowest stage
+// rather than the sum of all of them, and a slow stage backs up the ones
+// before it instead of buffering the whole workspace in memory.
+//
+// It returns one index record per file, holding the file's version, chunks
+// and embeddings, or ctx's error if ctx is done before every file is
+// embedded.
+func (s *CompletionService) runIndexPipeline(ctx context.Context, root string) ([]*indexRecord, error) {
+	chunkWorkers := runtime.NumCPU()
+	budget := s.config.ChunkBudget()
+	embedWorkers := s.config.EmbeddingConcurrency()
+	batchSize := s.config.EmbeddingBatchSize()
+	ctx = withWorkClass(ctx, classBulkIndex)
+	log.InfoLogger.Printf("🏭 Indexing pipeline: %d chunkers, %d embedders, batch size %d", chunkWorkers, embedWorkers, batchSize)
+
+	paths := make(chan string, chunkWorkers*4)
+	chunked := make(chan chunkedFile, chunkWorkers*2)
+	batches := make(chan []embeddedChunk, embedWorkers)
+	results := make(chan []embeddedChunk, embedWorkers*2)
+
+	// Stage 1: walk the tree, reading several directories at once.
+	var walkErr error
+	go func() {
+		defer close(paths)
+		walkErr = indexer.WalkParallel(root, chunkWorkers, s.skipEntry, paths)
+	}()
+
+	// Stage 2: parse and chunk files on every core.
+	var chunkers sync.WaitGroup
+	for i := 0; i < chunkWorkers; i++ {
+		chunkers.Add(1)
+		go func() {
+			defer chunkers.Done()
+			for path := range paths {
+				if ctx.Err() != nil {
+					continue // Drain the walk without doing its work
+				}
+				log.InfoLogger.Printf("📄 Staging file for indexing: %s", path)
+				// Stat before reading: if the file changes in between, the
+				// recorded mtime is older and the next start re-checks it.
+				info, err := os.Stat(path)
+				if err != nil {
+					log.ErrorLogger.Printf("⚠️ Could not stat file %s: %v. Skipping.", path, err)
+					continue
+				}
+				content, err := os.ReadFile(path)
+				if err != nil {
+					log.ErrorLogger.Printf("⚠️ Could not read file %s: %v. Skipping.", path, err)
+					continue
+				}
+				chunks, err := indexer.ChunkSourceWithTreeSitter(path, content, budget)
+				if err != nil {
+					log.ErrorLogger.Printf("⚠️ Could not chunk file %s: %v. Skipping.", path, err)
+					continue
+				}
+				meta := statMeta(info)
+				meta.hash = cache.HashBytes(content)
+				chunked <- chunkedFile{path: path, meta: meta, chunks: chunks}
+			}
+		}()
+	}
+	go func() {
+		chunkers.Wait()
+		close(chunked)
+	}()
+
+	// Stage 3: send cache hits straight to the writer and group misses into
+	// batches for a pool of embedders sharing one provider rate limit.
+	// File versions are owned by this stage until every producer is done.
+	metas := make(map[string]fileMeta)
+	var producers sync.WaitGroup
+	producers.Add(1)
+	go func() {
+		defer producers.Done()
+		defer close(batches)
+		var batch []embeddedChunk
+		for file := range chunked {
+			metas[file.path] = file.meta
+			s.reportProgress(0, int64(len(file.chunks)))
+			var hits []embeddedChunk
+			for i, chunk := range file.chunks {
+				item := embeddedChunk{chunk: chunk, position: i, fileChunks: len(file.chunks)}
+				if emb, found := s.cache.Get(s.keyer.Key(chunk.FilePath, chunk.Content)); found {
+					embeddingCacheHits.Inc()
+					item.embedding = emb
+					hits = append(hits, item)
+					continue
+				}
+				embeddingCacheMisses.Inc()
+				batch = append(batch, item)
+				if len(batch) == batchSize {
+					batches <- batch
+					batch = nil
+				}
+			}
+			if len(hits) > 0 {
+				results <- hits
+			}
+		}
+		if len(batch) > 0 {
+			batches <- batch
+		}
+	}()
+	for i := 0; i < embedWorkers; i++ {
+		producers.Add(1)
+		go func() {
+			defer producers.Done()
+			for batch := range batches {
+				chunks := make([]indexer.Chunk, len(batch))
+				for j, item := range batch {
+					chunks[j] = item.chunk
+				}
+				for j, emb := range s.embedBatch(ctx, chunks) {
+					batch[j].embedding = emb
+				}
+				results <- batch
+			}
+		}()
+	}
+	go func() {
+		producers.Wait()
+		close(results)
+	}()
+
+	// Stage 4: a single writer owns the collected index data and puts every
+	// chunk back at its position in the file.
+	records := make(map[string]*indexRecord)
+	chunkCount := 0
+	for embedded := range results {
+		for _, item := range embedded {
+			path := item.chunk.FilePath
+			rec := records[path]
+			if rec == nil {
+				rec = &indexRecord{
+					Path:       path,
+					Chunks:     make([]indexer.Chunk, item.fileChunks),
+					Embeddings: make([][]float32, item.fileChunks),
+				}
+				records[path] = rec
+			}
+			rec.Chunks[item.position] = item.chunk
+			rec.Embeddings[item.position] = item.embedding
+			chunkCount++
+		}
+		s.reportProgress(int64(len(embedded)), 0)
+	}
+	if walkErr != nil {
+		return nil, walkErr
+	}
+	if err := ctx.Err(); err != nil {
+		return nil, err
+	}
+
+	// Files without chunks are recorded too, so their version is known.
+	result := make([]*indexRecord, 0, len(metas))
+	for path, meta := range metas {
+		var chunks []indexer.Chunk
+		var embeddings [][]float32
+		if rec := records[path]; rec != nil {
+			chunks, embeddings = rec.Chunks, rec.Embeddings
+		}
+		result = append(result, meta.record(path, chunks, embeddings))
+	}
+
+	log.InfoLogger.Printf("📝 Pipeline indexed %d chunks from %d files.", chunkCount, len(result))
+	return result, nil
+}
+
+// skipEntry applies the directory indexing ignore rules: hidden entries,
+// dependency and build output directories, and excluded files.
+func (s *CompletionService) skipEntry(path string, entry fs.DirEntry) bool {
+	name := entry.Name()
+	if entry.IsDir() {
+		if strings.HasPrefix(name, ".") {
+			log.InfoLogger.Printf("🙈 Ignoring hidden directory: %s", path)
+			return true
+		}
+		if ignoredDirs[name] {
+			log.InfoLogger.Printf("🙈 Ignoring directory: %s", path)
+			return true
+		}
+		return false
+	}
+	if strings.HasPrefix(name, ".") {
+		log.InfoLogger.Printf("🙈 Ignoring hidden file: %s", path)
+		return true
+	}
+	if s.isExcluded(name) {
+		log.InfoLogger.Printf("🙈 Ignoring file: %s", path)
+		return true
+	}
+	return false
+}
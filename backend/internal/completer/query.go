@@ -0,0 +1,165 @@
+package completer
+
+import (
+	"container/list"
+	"strings"
+	"sync"
+
+	"autocomplete/backend/internal/cache"
+)
+
+// queryWindowMaxBytes caps the query window when its lines are very long,
+// such as in minified code.
+const queryWindowMaxBytes = 8 << 10
+
+// queryWindow returns the part of the code before the cursor that the
+// retrieval query is embedded from: the last lines lines, preceded by the
+// first line of the enclosing top-level declaration when that starts
+// earlier. The identifier being typed at the cursor is left out, unless it
+// is all there is, so the keystrokes completing a word share one window and
+// one embedding.
+func queryWindow(content string, lines int) string {
+	if trimmed := strings.TrimRightFunc(content, isIdentifierRune); strings.TrimSpace(trimmed) != "" {
+		content = trimmed
+	}
+
+	// Find the start of the last lines lines.
+	tailStart := len(content)
+	for n := 0; n < lines && tailStart > 0; n++ {
+		tailStart = strings.LastIndexByte(content[:tailStart-1], '\n') + 1
+	}
+	if len(content)-tailStart > queryWindowMaxBytes {
+		tailStart = len(content) - queryWindowMaxBytes
+		if newline := strings.IndexByte(content[tailStart:], '\n'); newline >= 0 && tailStart+newline+1 < len(content) {
+			tailStart += newline + 1
+		}
+	}
+	tail := content[tailStart:]
+	if tailStart == 0 || declarationStartsIn(tail) {
+		return tail
+	}
+	if header := enclosingDeclaration(content[:tailStart]); header != "" {
+		return header + "\n" + tail
+	}
+	return tail
+}
+
+// enclosingDeclaration returns the first line of the top-level declaration
+// that is still open at the end of code, or "" if code ends at top level.
+// Declarations are recognised by indentation alone: the last unindented
+// line is taken as the header unless it closes a block.
+func enclosingDeclaration(code string) string {
+	end := len(code)
+	for end > 0 {
+		start := strings.LastIndexByte(code[:end-1], '\n') + 1
+		line := strings.TrimRight(code[start:end], "\r\n")
+		end = start
+		switch {
+		case isTopLevelCloser(line):
+			return ""
+		case isTopLevelHeader(line):
+			if len(line) > queryWindowMaxBytes/8 {
+				line = line[:queryWindowMaxBytes/8]
+			}
+			return line
+		}
+	}
+	return ""
+}
+
+// declarationStartsIn reports whether code has an unindented line that
+// starts a declaration, in which case it already holds its own context.
+func declarationStartsIn(code string) bool {
+	for _, line := range strings.Split(code, "\n") {
+		if isTopLevelHeader(line) {
+			return true
+		}
+	}
+	return false
+}
+
+func isTopLevelHeader(line string) bool {
+	if line == "" || line[0] == ' ' || line[0] == '\t' || line[0] == '\r' || isTopLevelCloser(line) {
+		return false
+	}
+	for _, comment := range []string{"//", "/*", "*", "#"} {
+		if strings.HasPrefix(line, comment) {
+			return false
+		}
+	}
+	return true
+}
+
+func isTopLevelCloser(line string) bool {
+	return line != "" && strings.ContainsRune("})]", rune(line[0]))
+}
+
+func isIdentifierRune(r rune) bool {
+	return r == '_' || r >= '0' && r <= '9' || r >= 'a' && r <= 'z' || r >= 'A' && r <= 'Z'
+}
+
+// queryEmbeddingCache is a small LRU of query embeddings keyed by the hash of
+// their query window. Debounced requests while typing mostly repeat a
+// window, and the cache saves their embedding call.
+type queryEmbeddingCache struct {
+	mu       sync.Mutex
+	capacity int
+	order    *list.List // Of *queryEmbedding, most recently used first
+	entries  map[uint64]*list.Element
+}
+
+type queryEmbedding struct {
+	key       uint64
+	embedding []float32
+}
+
+// newQueryEmbeddingCache returns a cache of up to capacity embeddings, or nil
+// (which caches nothing) when capacity is not positive.
+func newQueryEmbeddingCache(capacity int) *queryEmbeddingCache {
+	if capacity <= 0 {
+		return nil
+	}
+	return &queryEmbeddingCache{
+		capacity: capacity,
+		order:    list.New(),
+		entries:  make(map[uint64]*list.Element),
+	}
+}
+
+// get returns the embedding cached for window. The embedding is shared and
+// must not be modified.
+func (c *queryEmbeddingCache) get(window string) ([]float32, bool) {
+	if c == nil {
+		return nil, false
+	}
+	key := cache.HashString(window)
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	element, found := c.entries[key]
+	if !found {
+		return nil, false
+	}
+	c.order.MoveToFront(element)
+	return element.Value.(*queryEmbedding).embedding, true
+}
+
+// set caches the embedding of window, evicting the least recently used
+// embedding beyond capacity.
+func (c *queryEmbeddingCache) set(window string, embedding []float32) {
+	if c == nil {
+		return
+	}
+	key := cache.HashString(window)
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if element, found := c.entries[key]; found {
+		element.Value.(*queryEmbedding).embedding = embedding
+		c.order.MoveToFront(element)
+		return
+	}
+	c.entries[key] = c.order.PushFront(&queryEmbedding{key: key, embedding: embedding})
+	for c.order.Len() > c.capacity {
+		oldest := c.order.Remove(c.order.Back()).(*queryEmbedding)
+		delete(c.entries, oldest.key)
+	}
+}
@@ -0,0 +1,78 @@
+package completer
+
+import (
+	"context"
+	"os"
+	"runtime"
+	"sync"
+	"time"
+
+	"autocomplete/backend/internal/indexer"
+	"autocomplete/backend/internal/log"
+)
+
+// refreshIndex brings an index loaded from disk in line with the tree under
+// root. A parallel stat walk compares every file's size and modification
+// time with the manifest in the index; only files that differ, new files and
+// files that disappeared are re-chunked, re-embedded or removed. It gives up
+// when ctx is done.
+func (s *CompletionService) refreshIndex(ctx context.Context, root string) {
+	start := time.Now()
+	workers := runtime.NumCPU()
+
+	paths := make(chan string, workers*4)
+	var walkErr error
+	go func() {
+		defer close(paths)
+		walkErr = indexer.WalkParallel(root, workers, s.skipEntry, paths)
+	}()
+
+	var mu sync.Mutex
+	seen := make(map[string]bool)
+	var stale []string
+	var wg sync.WaitGroup
+	for i := 0; i < workers; i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for path := range paths {
+				info, err := os.Stat(path)
+				if err != nil {
+					continue
+				}
+				meta := statMeta(info)
+
+				s.mu.Lock()
+				file := s.files[path]
+				s.mu.Unlock()
+				mu.Lock()
+				seen[path] = true
+				if file == nil || file.size != meta.size || file.modTime != meta.modTime {
+					stale = append(stale, path)
+				}
+				mu.Unlock()
+			}
+		}()
+	}
+	wg.Wait()
+	if walkErr != nil {
+		// A partial walk cannot tell deleted files from unvisited ones.
+		log.ErrorLogger.Printf("⚠️ Could not check index against %s: %v", root, walkErr)
+		return
+	}
+
+	s.mu.Lock()
+	for path := range s.files {
+		if !seen[path] {
+			stale = append(stale, path)
+		}
+	}
+	total := len(s.files)
+	s.mu.Unlock()
+
+	log.InfoLogger.Printf("🔍 Checked %d indexed files against %s in %v: %d changed, added or removed",
+		total, root, time.Since(start), len(stale))
+	if len(stale) > 0 {
+		s.applyFileChanges(withWorkClass(ctx, classBulkIndex), stale)
+	}
+}
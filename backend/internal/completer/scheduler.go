@@ -0,0 +1,251 @@
+package completer
+
+import (
+	"context"
+	"runtime"
+	"sync"
+	"time"
+
+	"autocomplete/backend/internal/metrics"
+	"autocomplete/backend/internal/storage"
+)
+
+// workClass is the kind of work an embedding request or vector store
+// operation is done for, most urgent first.
+type workClass int
+
+const (
+	// classInteractive embeds and searches completion queries while the
+	// user waits.
+	classInteractive workClass = iota
+	// classFileIndex re-embeds files changed in the editor or on disk.
+	classFileIndex
+	// classBulkIndex embeds a whole directory being indexed.
+	classBulkIndex
+
+	workClasses
+)
+
+type workClassKey struct{}
+
+// withWorkClass marks ctx as belonging to work of class. Requests made
+// without a class are interactive.
+func withWorkClass(ctx context.Context, class workClass) context.Context {
+	return context.WithValue(ctx, workClassKey{}, class)
+}
+
+func workClassOf(ctx context.Context) workClass {
+	if class, ok := ctx.Value(workClassKey{}).(workClass); ok {
+		return class
+	}
+	return classInteractive
+}
+
+// scheduler admits embedding requests by class. Every class has its own
+// concurrency limit, and waiting requests are admitted most urgent class
+// first, so a completion query arriving while a directory is being indexed
+// goes ahead of every queued bulk batch instead of waiting behind them. Bulk
+// batches also hold back while a query is running, leaving the embedding
+// provider to the query; batches already sent are not interrupted.
+type scheduler struct {
+	mu      sync.Mutex
+	limits  [workClasses]int
+	running [workClasses]int
+	queues  [workClasses][]*schedulerWaiter
+	waits   [workClasses]*metrics.Histogram // Time spent in acquire, by class
+}
+
+type schedulerWaiter struct {
+	ready   chan struct{}
+	granted bool
+}
+
+// newScheduler returns a scheduler of embedding requests with a concurrency
+// limit per class.
+func newScheduler(interactive, fileIndex, bulkIndex int) *scheduler {
+	return &scheduler{
+		limits: [workClasses]int{
+			classInteractive: max(interactive, 1),
+			classFileIndex:   max(fileIndex, 1),
+			classBulkIndex:   max(bulkIndex, 1),
+		},
+		waits: schedulerWait,
+	}
+}
+
+// acquire waits until a request of class may run, or until ctx is done.
+// release must be called when an acquired request is finished.
+func (s *scheduler) acquire(ctx context.Context, class workClass) error {
+	start := time.Now()
+	s.mu.Lock()
+	if len(s.queues[class]) == 0 && s.admits(class) {
+		s.running[class]++
+		s.mu.Unlock()
+		s.waits[class].ObserveSince(start)
+		return nil
+	}
+	waiter := &schedulerWaiter{ready: make(chan struct{})}
+	s.queues[class] = append(s.queues[class], waiter)
+	s.mu.Unlock()
+
+	select {
+	case <-waiter.ready:
+		s.waits[class].ObserveSince(start)
+		return nil
+	case <-ctx.Done():
+		s.mu.Lock()
+		defer s.mu.Unlock()
+		if waiter.granted {
+			s.running[class]--
+		} else {
+			queue := s.queues[class]
+			for i, queued := range queue {
+				if queued == waiter {
+					s.queues[class] = append(queue[:i:i], queue[i+1:]...)
+					break
+				}
+			}
+		}
+		s.dispatch()
+		return ctx.Err()
+	}
+}
+
+// release ends a request of class and admits whatever may run next.
+func (s *scheduler) release(class workClass) {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	s.running[class]--
+	s.dispatch()
+}
+
+// admits reports whether a request of class may start now: its class is
+// under its limit, no more urgent request is waiting, and for bulk work no
+// query is running. s.mu must be held.
+func (s *scheduler) admits(class workClass) bool {
+	if s.running[class] >= s.limits[class] {
+		return false
+	}
+	for more := classInteractive; more < class; more++ {
+		if len(s.queues[more]) > 0 {
+			return false
+		}
+	}
+	return class != classBulkIndex || s.running[classInteractive] == 0
+}
+
+// dispatch admits waiting requests, most urgent class first. s.mu must be
+// held.
+func (s *scheduler) dispatch() {
+	for class := classInteractive; class < workClasses; class++ {
+		for len(s.queues[class]) > 0 && s.admits(class) {
+			waiter := s.queues[class][0]
+			s.queues[class] = s.queues[class][1:]
+			waiter.granted = true
+			s.running[class]++
+			close(waiter.ready)
+		}
+	}
+}
+
+// scheduledEmbedder sends every embedding request through a scheduler,
+// using the class of the request's context, and then through the rate
+// limit of the embedding provider.
+type scheduledEmbedder struct {
+	EmbedderWithDimensions
+	scheduler *scheduler
+	limiter   *rateLimiter
+}
+
+// NewScheduledEmbedder puts a scheduler in front of embedder that serves
+// completion queries before file re-indexing and file re-indexing before
+// directory indexing, each with its own concurrency limit from config.
+// Admitted requests of every class share one EMBEDDING_REQUESTS_PER_SECOND
+// budget. One scheduled embedder is shared by all workspaces, so the budget
+// holds for the whole process.
+func NewScheduledEmbedder(embedder EmbedderWithDimensions, config *Config) EmbedderWithDimensions {
+	return &scheduledEmbedder{
+		EmbedderWithDimensions: embedder,
+		scheduler: newScheduler(
+			config.Embedding.InteractiveConcurrency,
+			config.Embedding.FileConcurrency,
+			config.EmbeddingConcurrency(),
+		),
+		limiter: newRateLimiter(config.Embedding.RequestsPerSecond),
+	}
+}
+
+func (e *scheduledEmbedder) Embed(ctx context.Context, text string) ([]float32, error) {
+	class := workClassOf(ctx)
+	if err := e.scheduler.acquire(ctx, class); err != nil {
+		return nil, err
+	}
+	defer e.scheduler.release(class)
+	e.limiter.Wait()
+	return e.EmbedderWithDimensions.Embed(ctx, text)
+}
+
+func (e *scheduledEmbedder) BatchEmbed(ctx context.Context, texts []string) ([][]float32, error) {
+	class := workClassOf(ctx)
+	if err := e.scheduler.acquire(ctx, class); err != nil {
+		return nil, err
+	}
+	defer e.scheduler.release(class)
+	e.limiter.Wait()
+	return e.EmbedderWithDimensions.BatchEmbed(ctx, texts)
+}
+
+// VectorStoreScheduler admits the vector store operations of every workspace
+// by work class, like the scheduled embedder does for embedding requests:
+// searches for completion queries go ahead of updates from re-indexing
+// files, and those ahead of loading a whole directory, which also holds back
+// while a search is running. Searches run up to one per core; updates, which
+// take a store's write lock, run one at a time per class.
+type VectorStoreScheduler struct {
+	scheduler *scheduler
+}
+
+// NewVectorStoreScheduler returns a scheduler to share between the vector
+// stores of all workspaces.
+func NewVectorStoreScheduler() *VectorStoreScheduler {
+	scheduler := newScheduler(runtime.NumCPU(), 1, 1)
+	scheduler.waits = storeWait
+	return &VectorStoreScheduler{scheduler: scheduler}
+}
+
+// Schedule returns store with its searches admitted in the class of their
+// context. Updates take no context, so the completion service admits them
+// itself in the class of the work they are done for.
+func (v *VectorStoreScheduler) Schedule(store storage.VectorStore) storage.VectorStore {
+	return &scheduledStore{VectorStore: store, scheduler: v.scheduler}
+}
+
+type scheduledStore struct {
+	storage.VectorStore
+	scheduler *scheduler
+}
+
+func (s *scheduledStore) Query(ctx context.Context, vector []float32, k int) ([]int, error) {
+	class := workClassOf(ctx)
+	if err := s.scheduler.acquire(ctx, class); err != nil {
+		return nil, err
+	}
+	defer s.scheduler.release(class)
+	return s.VectorStore.Query(ctx, vector, k)
+}
+
+// updateStore runs update, which changes the service's vector store, once
+// the store's scheduler admits work of the class of ctx. Unscheduled stores
+// are updated at once.
+func (s *CompletionService) updateStore(ctx context.Context, update func() error) error {
+	store, scheduled := s.db.(*scheduledStore)
+	if !scheduled {
+		return update()
+	}
+	class := workClassOf(ctx)
+	if err := store.scheduler.acquire(ctx, class); err != nil {
+		return err
+	}
+	defer store.scheduler.release(class)
+	return update()
+}
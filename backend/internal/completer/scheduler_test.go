@@ -0,0 +1,121 @@
+package completer
+
+import (
+	"context"
+	"errors"
+	"testing"
+	"time"
+)
+
+// queued returns how many requests of class wait in s.
+func (s *scheduler) queued(class workClass) int {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	return len(s.queues[class])
+}
+
+// acquireAsync starts acquiring class in s and returns the result of
+// acquire once it is admitted or fails.
+func acquireAsync(ctx context.Context, s *scheduler, class workClass) <-chan error {
+	admitted := make(chan error, 1)
+	go func() { admitted <- s.acquire(ctx, class) }()
+	return admitted
+}
+
+// checkWaiting fails the test if admitted has been admitted.
+func checkWaiting(t *testing.T, what string, admitted <-chan error) {
+	t.Helper()
+	select {
+	case err := <-admitted:
+		t.Fatalf("%s was admitted (%v) while it should wait", what, err)
+	case <-time.After(20 * time.Millisecond):
+	}
+}
+
+func TestSchedulerAdmitsQueriesAheadOfQueuedIndexing(t *testing.T) {
+	s := newScheduler(1, 1, 1)
+	ctx := context.Background()
+	if err := s.acquire(ctx, classInteractive); err != nil {
+		t.Fatal(err)
+	}
+
+	bulk := acquireAsync(ctx, s, classBulkIndex)
+	eventually(t, "the bulk request to queue", func() bool { return s.queued(classBulkIndex) == 1 })
+	// A file request may start: it is under its limit and only bulk work
+	// yields to a running query.
+	if err := s.acquire(ctx, classFileIndex); err != nil {
+		t.Fatal(err)
+	}
+	query := acquireAsync(ctx, s, classInteractive)
+	eventually(t, "the query to queue", func() bool { return s.queued(classInteractive) == 1 })
+
+	s.release(classInteractive)
+	if err := <-query; err != nil {
+		t.Fatal(err)
+	}
+	checkWaiting(t, "bulk indexing during a query", bulk)
+
+	s.release(classInteractive)
+	if err := <-bulk; err != nil {
+		t.Fatal(err)
+	}
+	s.release(classFileIndex)
+	s.release(classBulkIndex)
+}
+
+func TestSchedulerHoldsBackLessUrgentWorkBehindQueuedQueries(t *testing.T) {
+	s := newScheduler(1, 2, 2)
+	ctx := context.Background()
+	if err := s.acquire(ctx, classInteractive); err != nil {
+		t.Fatal(err)
+	}
+	query := acquireAsync(ctx, s, classInteractive)
+	eventually(t, "the query to queue", func() bool { return s.queued(classInteractive) == 1 })
+
+	// A file request arriving while a query waits queues behind it, even
+	// though its own class has room.
+	file := acquireAsync(ctx, s, classFileIndex)
+	checkWaiting(t, "file indexing behind a queued query", file)
+
+	s.release(classInteractive)
+	if err := <-query; err != nil {
+		t.Fatal(err)
+	}
+	if err := <-file; err != nil {
+		t.Fatal(err)
+	}
+	s.release(classInteractive)
+	s.release(classFileIndex)
+}
+
+func TestSchedulerDropsCanceledWaiters(t *testing.T) {
+	s := newScheduler(1, 1, 1)
+	if err := s.acquire(context.Background(), classFileIndex); err != nil {
+		t.Fatal(err)
+	}
+
+	ctx, cancel := context.WithCancel(context.Background())
+	canceled := acquireAsync(ctx, s, classFileIndex)
+	eventually(t, "the request to queue", func() bool { return s.queued(classFileIndex) == 1 })
+	next := acquireAsync(context.Background(), s, classFileIndex)
+	eventually(t, "the second request to queue", func() bool { return s.queued(classFileIndex) == 2 })
+	cancel()
+	if err := <-canceled; !errors.Is(err, context.Canceled) {
+		t.Fatalf("acquire with a canceled context returned %v", err)
+	}
+	if got := s.queued(classFileIndex); got != 1 {
+		t.Fatalf("%d requests queued after cancellation, want 1", got)
+	}
+
+	// The slot goes to the request still waiting, not the canceled one.
+	s.release(classFileIndex)
+	if err := <-next; err != nil {
+		t.Fatal(err)
+	}
+	s.release(classFileIndex)
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	if s.running != [workClasses]int{} {
+		t.Fatalf("requests still running after every release: %v", s.running)
+	}
+}
@@ -1,13 +1,17 @@
 package completer
 
 import (
+	"context"
 	"crypto/sha256"
-	"encoding/gob"
 	"encoding/hex"
+	"errors"
 	"fmt"
 	"os"
 	"path/filepath"
 	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
 
 	"autocomplete/backend/internal/cache"
 	"autocomplete/backend/internal/indexer"
@@ -18,32 +22,113 @@ import (
 // CompletionService provides core logic for directory/file indexing,
 // embedding generation (with caching), and vector store management.
 type CompletionService struct {
-	db          storage.VectorStore
-	embedder    Embedder
-	llm         *OpenAIClient
-	cache       cache.EmbeddingCache
-	indexedData map[string][]indexer.Chunk
+	db       storage.VectorStore
+	embedder Embedder
+	llm      CompletionProvider
+	cache    cache.EmbeddingCache
+	keyer    cache.Keyer
+
+	// mu guards the per-file index state, the on-disk index log and the
+	// file watcher.
+	mu       sync.Mutex
+	files    map[string]*indexedFile
+	indexLog *indexLog
+	watcher  *indexer.Watcher
+
+	// parses keeps the trees of recently changed files so the next change
+	// to one of them is reparsed incrementally.
+	parses *indexer.ParseCache
+
+	// queries caches the embeddings of recent completion query windows.
+	queries *queryEmbeddingCache
+
+	// typeahead keeps the last completion of each file for the user to
+	// type through.
+	typeahead *typeaheadCache
+
+	// inflight cancels a file's pending completion when a newer request
+	// for the file arrives.
+	inflight *supersession
+
+	// editors mirrors the documents open in the editor.
+	editors *documentMirror
+
+	// jobs runs directory and file indexing one job at a time.
+	jobs *indexQueue
+
+	// docs holds the text of every indexed chunk by vector id. It is
+	// replaced whenever the vector store is reloaded and read without mu.
+	docs atomic.Pointer[storage.DocStore]
 
 	// Add config to access exclusion settings
 	config *Config
 }
 
+// fileMeta identifies the version of a file that was indexed. Size and
+// modification time let a restart skip unchanged files without reading them;
+// the content hash decides whether a file whose metadata changed really did.
+type fileMeta struct {
+	hash    uint64
+	size    int64
+	modTime int64 // Unix nanoseconds
+}
+
+// statMeta returns the size and modification time part of a fileMeta.
+func statMeta(info os.FileInfo) fileMeta {
+	return fileMeta{size: info.Size(), modTime: info.ModTime().UnixNano()}
+}
+
+// indexedFile is the indexed state of one file: the version it was chunked
+// from, the content hash of each chunk, and the vector store id of each
+// chunk (-1 where embedding failed). Together they let a change to the file
+// be applied as a diff instead of rebuilding the index, without keeping the
+// chunk text in memory.
+type indexedFile struct {
+	fileMeta
+	hashes []uint64
+	ids    []int
+}
+
+// without returns a copy of f that no longer holds the vectors with the given
+// ids; their chunks are left without a vector.
+func (f *indexedFile) without(ids []int) *indexedFile {
+	dropped := make(map[int]bool, len(ids))
+	for _, id := range ids {
+		dropped[id] = true
+	}
+	file := &indexedFile{fileMeta: f.fileMeta, hashes: f.hashes, ids: make([]int, len(f.ids))}
+	for i, id := range f.ids {
+		if dropped[id] {
+			id = -1
+		}
+		file.ids[i] = id
+	}
+	return file
+}
+
 // NewCompletionService constructs a CompletionService with the given
 // vector store, embedder, LLM client, and embedding cache.
 func NewCompletionService(
 	db storage.VectorStore,
 	embedder Embedder,
-	llm *OpenAIClient,
+	llm CompletionProvider,
 	embCache cache.EmbeddingCache,
 	config *Config,
 ) *CompletionService {
 	return &CompletionService{
-		db:          db,
-		embedder:    embedder,
-		llm:         llm,
-		cache:       embCache,
-		indexedData: make(map[string][]indexer.Chunk),
-		config:      config,
+		db:        db,
+		embedder:  embedder,
+		llm:       llm,
+		cache:     embCache,
+		keyer:     cache.NewKeyer(cache.KeyMode(config.Embedding.CacheKeyMode), config.EmbeddingModelID(), config.GetEmbeddingDimensions()),
+		files:     make(map[string]*indexedFile),
+		parses:    indexer.NewParseCache(parseCacheFiles, config.ChunkBudget()),
+		queries:   newQueryEmbeddingCache(config.QueryCacheEntries),
+		typeahead: newTypeaheadCache(completionCacheFiles),
+		inflight:  newSupersession(),
+		editors:   newDocumentMirror(),
+		jobs:      newIndexQueue(),
+		config:    config,
 	}
 }
 
@@ -89,6 +174,12 @@ func (s *CompletionService) isExcluded(name string) bool {
 // IndexDirectory walks the given root directory, chunks files,
 // builds/loads index, and persists it for future runs.
 func (s *CompletionService) IndexDirectory(root string) error {
+	return s.indexDirectory(context.Background(), root)
+}
+
+// indexDirectory is IndexDirectory, given up when ctx is done. An index
+// built only in part is neither loaded nor saved.
+func (s *CompletionService) indexDirectory(ctx context.Context, root string) error {
 	cacheDir, err := userCacheDirForRoot(root)
 	if err != nil {
 		log.ErrorLogger.Printf("⚠️ Failed to get cache dir: %v", err)
@@ -102,67 +193,30 @@ func (s *CompletionService) IndexDirectory(root string) error {
 		cacheDir = root
 	}
 	log.InfoLogger.Printf("🗂 Final cache directory path: %s", cacheDir)
-	indexFile := filepath.Join(cacheDir, "index.gob")
+	indexFile := filepath.Join(cacheDir, indexFileName)
 	log.InfoLogger.Printf("🗂 Index file path: %s", indexFile)
 	if _, err := os.Stat(indexFile); err == nil {
 		log.InfoLogger.Printf("💾 Index file found, loading: %s", indexFile)
-		return s.LoadIndex(indexFile)
+		if err := s.LoadIndex(indexFile); err == nil {
+			s.refreshIndex(ctx, root)
+			return ctx.Err()
+		}
+		log.ErrorLogger.Printf("⚠️ Failed to load index %s, rebuilding: %v", indexFile, err)
 	}
 
 	log.InfoLogger.Printf("📂 Starting to index directory: %s", root)
-	ignoredDirs := map[string]bool{
-		"node_modules": true,
-		"vendor":       true,
-		"dist":         true,
-		"build":        true,
-		"__pycache__":  true,
-		"venv":         true,
-	}
-
-	var allChunks []indexer.Chunk
-	err = filepath.Walk(root, func(path string, info os.FileInfo, err error) error {
-		if err != nil {
-			return err
-		}
-		// Skip hidden
-		if strings.HasPrefix(info.Name(), ".") {
-			if info.IsDir() {
-				log.InfoLogger.Printf("🙈 Ignoring hidden directory: %s", path)
-				return filepath.SkipDir
-			}
-			log.InfoLogger.Printf("🙈 Ignoring hidden file: %s", path)
-			return nil
-		}
-		if info.IsDir() {
-			if ignoredDirs[info.Name()] {
-				log.InfoLogger.Printf("🙈 Ignoring directory: %s", path)
-				return filepath.SkipDir
-			}
-		} else {
-			if s.isExcluded(info.Name()) {
-				log.InfoLogger.Printf("🙈 Ignoring file: %s", path)
-				return nil
-			}
-			log.InfoLogger.Printf("📄 Staging file for indexing: %s", path)
-			chunks, err := indexer.ChunkFileWithTreeSitter(path)
-			if err != nil {
-				log.ErrorLogger.Printf("⚠️ Could not chunk file %s: %v. Skipping.", path, err)
-				return nil
-			}
-			allChunks = append(allChunks, chunks...)
-		}
-		return nil
-	})
-	log.InfoLogger.Printf("📝 Found %d chunks to stage for indexing.", len(allChunks))
-	for _, chunk := range allChunks {
-		s.indexedData[chunk.FilePath] = append(s.indexedData[chunk.FilePath], chunk)
+	records, err := s.runIndexPipeline(ctx, root)
+	if err != nil {
+		return fmt.Errorf("failed to index directory %s: %w", root, err)
 	}
 
-	if err := s.reIndex(); err != nil {
-		return err
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	if err := s.loadRecords(cacheDir, records); err != nil {
+		return fmt.Errorf("failed to add batch: %w", err)
 	}
 
-	if err := s.SaveIndex(indexFile); err != nil {
+	if err := s.saveIndex(indexFile, records); err != nil {
 		log.ErrorLogger.Printf("⚠️ Failed to save index to %s: %v", indexFile, err)
 	} else {
 		log.InfoLogger.Printf("💾 Index saved to %s", indexFile)
@@ -172,178 +226,719 @@ func (s *CompletionService) IndexDirectory(root string) error {
 	return nil
 }
 
-// reIndex rebuilds the vector store index from staged data, using cache.
-func (s *CompletionService) reIndex() error {
-	log.InfoLogger.Println("🔄 Rebuilding vector index...")
-	var allChunks []indexer.Chunk
-	for _, list := range s.indexedData {
-		allChunks = append(allChunks, list...)
+// embedChunks returns an embedding per chunk, in order, from the cache where
+// possible. Misses are embedded in requests of the configured batch size and
+// cached; chunks that could not be embedded get nil. Requests are scheduled
+// with the work class of ctx.
+func (s *CompletionService) embedChunks(ctx context.Context, chunks []indexer.Chunk) [][]float32 {
+	embeddings := make([][]float32, len(chunks))
+	var pending []indexer.Chunk
+	pendingAt := make(map[string][]int)
+	for i, chunk := range chunks {
+		key := s.keyer.Key(chunk.FilePath, chunk.Content)
+		if waiting, queued := pendingAt[key]; queued {
+			pendingAt[key] = append(waiting, i)
+			continue
+		}
+		if emb, found := s.cache.Get(key); found {
+			embeddingCacheHits.Inc()
+			embeddings[i] = emb
+			continue
+		}
+		embeddingCacheMisses.Inc()
+		pendingAt[key] = []int{i}
+		pending = append(pending, chunk)
 	}
-	if len(allChunks) == 0 {
-		log.InfoLogger.Println("No data to index.")
-		return s.db.Add(nil, nil)
+	if len(pending) == 0 {
+		return embeddings
 	}
 
-	var embeddings [][]float32
-	var documents []string
-	for _, chunk := range allChunks {
-		key := cache.ComputeKey(chunk.FilePath, chunk.Content)
-		var emb []float32
-		if cached, found := s.cache.Get(key); found {
-			emb = cached
-		} else {
-			newEmb, err := s.embedder.Embed(chunk.Content)
-			if err != nil {
-				log.ErrorLogger.Printf("⚠️ Could not create embedding for chunk from %s: %v. Skipping.", chunk.FilePath, err)
-				continue
+	batchSize := s.config.EmbeddingBatchSize()
+	log.InfoLogger.Printf("🧮 Embedding %d uncached chunks in batches of %d", len(pending), batchSize)
+	for start := 0; start < len(pending); start += batchSize {
+		batch := pending[start:min(start+batchSize, len(pending))]
+		for j, emb := range s.embedBatch(ctx, batch) {
+			for _, i := range pendingAt[s.keyer.Key(batch[j].FilePath, batch[j].Content)] {
+				embeddings[i] = emb
 			}
-			s.cache.Set(key, newEmb)
-			emb = newEmb
 		}
-		embeddings = append(embeddings, emb)
-		documents = append(documents, chunk.Content)
 	}
+	return embeddings
+}
 
-	if len(embeddings) == 0 {
-		log.InfoLogger.Println("No embeddings were generated. Nothing to add.")
-		return nil
+// embedBatch embeds one batch of chunks, stores the results in the cache and
+// returns them in batch order. If the batch request fails, its chunks are
+// retried one at a time so a single bad input only drops itself; failed
+// chunks get a nil embedding.
+func (s *CompletionService) embedBatch(ctx context.Context, batch []indexer.Chunk) [][]float32 {
+	texts := make([]string, len(batch))
+	for i, chunk := range batch {
+		texts[i] = chunk.Content
 	}
 
-	log.InfoLogger.Printf("💾 Adding %d embeddings to the vector store.", len(embeddings))
-	if err := s.db.Add(embeddings, documents); err != nil {
-		return fmt.Errorf("failed to add batch: %w", err)
+	embeddings, err := s.embedder.BatchEmbed(ctx, texts)
+	if err == nil {
+		for i, chunk := range batch {
+			s.cache.Set(s.keyer.Key(chunk.FilePath, chunk.Content), embeddings[i])
+		}
+		return embeddings
+	}
+	if ctx.Err() != nil {
+		// Given up: retrying chunk by chunk would fail the same way.
+		return make([][]float32, len(batch))
 	}
-	log.InfoLogger.Println("✅ Vector index rebuilt.")
-	return nil
-}
 
-// SaveIndex writes the in-memory index, including cached embeddings, to disk.
-func (s *CompletionService) SaveIndex(filePath string) error {
-	var allChunks []indexer.Chunk
-	for _, list := range s.indexedData {
-		allChunks = append(allChunks, list...)
+	log.ErrorLogger.Printf("⚠️ Batch embedding of %d chunks failed: %v. Retrying individually.", len(batch), err)
+	embeddings = make([][]float32, len(batch))
+	for i, chunk := range batch {
+		emb, err := s.embedder.Embed(ctx, chunk.Content)
+		if err != nil {
+			log.ErrorLogger.Printf("⚠️ Could not create embedding for chunk from %s: %v. Skipping.", chunk.FilePath, err)
+			continue
+		}
+		s.cache.Set(s.keyer.Key(chunk.FilePath, chunk.Content), emb)
+		embeddings[i] = emb
 	}
+	return embeddings
+}
 
+// loadRecords replaces the vector store, the document store in dir and the
+// per-file state with the given index records. s.mu must be held.
+func (s *CompletionService) loadRecords(dir string, records []*indexRecord) error {
 	var embeddings [][]float32
+	var ids []int
 	var documents []string
-	for _, chunk := range allChunks {
-		key := cache.ComputeKey(chunk.FilePath, chunk.Content)
-		var emb []float32
-		if cached, found := s.cache.Get(key); found {
-			emb = cached
-		} else {
-			newEmb, err := s.embedder.Embed(chunk.Content)
-			if err != nil {
-				log.ErrorLogger.Printf("⚠️ Could not create embedding for chunk from %s: %v. Skipping.", chunk.FilePath, err)
+	files := make(map[string]*indexedFile, len(records))
+	for _, rec := range records {
+		file := &indexedFile{fileMeta: rec.meta(), hashes: make([]uint64, len(rec.Chunks)), ids: make([]int, len(rec.Chunks))}
+		for i, chunk := range rec.Chunks {
+			file.hashes[i] = cache.HashString(chunk.Content)
+			if i >= len(rec.Embeddings) || rec.Embeddings[i] == nil {
+				file.ids[i] = -1
 				continue
 			}
-			s.cache.Set(key, newEmb)
-			emb = newEmb
+			file.ids[i] = len(embeddings)
+			embeddings = append(embeddings, rec.Embeddings[i])
+			ids = append(ids, file.ids[i])
+			documents = append(documents, chunk.Content)
 		}
-		embeddings = append(embeddings, emb)
-		documents = append(documents, chunk.Content)
+		files[rec.Path] = file
 	}
 
-	f, err := os.Create(filePath)
+	docs, err := storage.NewDocStore(dir)
 	if err != nil {
 		return err
 	}
-	defer f.Close()
+	if err := docs.Put(ids, documents); err != nil {
+		docs.Close()
+		return err
+	}
+	log.InfoLogger.Printf("💾 Adding %d embeddings to the vector store.", len(embeddings))
+	add := func() error { return s.db.Add(embeddings) }
+	if err := s.updateStore(withWorkClass(context.Background(), classBulkIndex), add); err != nil {
+		docs.Close()
+		return err
+	}
+	if previous := s.docs.Swap(docs); previous != nil {
+		previous.Close()
+	}
+	s.files = files
+	return nil
+}
 
-	enc := gob.NewEncoder(f)
-	payload := struct {
-		IndexedData map[string][]indexer.Chunk
-		Embeddings  [][]float32
-		Documents   []string
-	}{
-		IndexedData: s.indexedData,
-		Embeddings:  embeddings,
-		Documents:   documents,
+// documents returns the document store, creating one in the temporary
+// directory for files indexed before any directory was loaded. s.mu must be
+// held.
+func (s *CompletionService) documents() (*storage.DocStore, error) {
+	if docs := s.docs.Load(); docs != nil {
+		return docs, nil
 	}
-	return enc.Encode(&payload)
+	docs, err := storage.NewDocStore(os.TempDir())
+	if err != nil {
+		return nil, err
+	}
+	s.docs.Store(docs)
+	return docs, nil
 }
 
-// LoadIndex restores staged chunks and vector store from a saved index file.
-func (s *CompletionService) LoadIndex(filePath string) error {
-	f, err := os.Open(filePath)
+// Close stops watching for changes and releases the index, failing queued
+// indexing jobs and waiting for the running one. The service must not be
+// used afterwards.
+func (s *CompletionService) Close() error {
+	s.closeJobs()
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	if s.watcher != nil {
+		s.watcher.Close()
+		s.watcher = nil
+	}
+	if s.indexLog != nil {
+		s.indexLog.close()
+		s.indexLog = nil
+	}
+	if docs := s.docs.Swap(nil); docs != nil {
+		docs.Close()
+	}
+	return s.db.Close()
+}
+
+// saveIndex writes a fresh on-disk index holding records and keeps it open
+// for incremental appends. s.mu must be held.
+func (s *CompletionService) saveIndex(filePath string, records []*indexRecord) error {
+	if s.indexLog != nil {
+		s.indexLog.close()
+		s.indexLog = nil
+	}
+	indexLog, err := createIndexLog(filePath, records)
 	if err != nil {
 		return err
 	}
-	defer f.Close()
+	s.indexLog = indexLog
+	return nil
+}
 
-	payload := struct {
-		IndexedData map[string][]indexer.Chunk
-		Embeddings  [][]float32
-		Documents   []string
-	}{}
-	if err := gob.NewDecoder(f).Decode(&payload); err != nil {
+// LoadIndex restores per-file state and the vector store from a saved index
+// file, keeping it open for incremental appends.
+func (s *CompletionService) LoadIndex(filePath string) error {
+	indexLog, latest, err := openIndexLog(filePath)
+	if err != nil {
 		return err
 	}
+	records := make([]*indexRecord, 0, len(latest))
+	for _, rec := range latest {
+		records = append(records, rec)
+	}
 
-	s.indexedData = payload.IndexedData
-	if err := s.db.Add(payload.Embeddings, payload.Documents); err != nil {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	if err := s.loadRecords(filepath.Dir(filePath), records); err != nil {
+		indexLog.close()
 		return err
 	}
-	log.InfoLogger.Printf("✅ Index loaded from %s with %d documents.", filePath, len(payload.Documents))
+	if s.indexLog != nil {
+		s.indexLog.close()
+	}
+	s.indexLog = indexLog
+	log.InfoLogger.Printf("✅ Index loaded from %s with %d files.", filePath, len(records))
 	return nil
 }
 
-// IndexFile stages and re-indexes a single file path.
+// IndexFile re-indexes a single file. Unchanged content is skipped by hash;
+// otherwise only chunks whose text changed are embedded and swapped in the
+// vector store, and one record is appended to the on-disk index.
 func (s *CompletionService) IndexFile(path string) error {
 	log.InfoLogger.Printf("📄 Indexing single file: %s", path)
-	delete(s.indexedData, path)
-	chunks, err := indexer.ChunkFileWithTreeSitter(path)
+	file, err := s.rechunk(path)
 	if err != nil {
-		return fmt.Errorf("could not chunk file %s: %w", path, err)
+		return fmt.Errorf("could not index file %s: %w", path, err)
+	}
+	if file == nil {
+		log.InfoLogger.Printf("⏭️ %s is unchanged, skipping", path)
+		return nil
+	}
+	ctx := withWorkClass(context.Background(), classFileIndex)
+	return s.applyChanges(ctx, nil, []*changedFile{file})
+}
+
+// errUnembedded stops updating a file whose indexed version changed after
+// its new chunks were embedded, leaving some of the chunks it now adds
+// without an embedding.
+var errUnembedded = errors.New("new chunks not embedded")
+
+// applyChanges removes the removed paths from the index and applies the
+// re-chunked files to it, scheduling its work in the class of ctx. Embedding
+// requests are never made with s.mu held: new chunks are embedded before the
+// lock is taken, and files whose indexed version changed meanwhile are
+// embedded again after releasing it and retried. It returns the errors of
+// the files that could not be applied, or ctx's error if it gave up first.
+func (s *CompletionService) applyChanges(ctx context.Context, removed []string, files []*changedFile) error {
+	s.embedNewChunks(ctx, files)
+	if err := ctx.Err(); err != nil {
+		return err
+	}
+
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	for _, path := range removed {
+		s.removeTree(ctx, path)
+	}
+	var errs []error
+	for len(files) > 0 {
+		var stale []*changedFile
+		for _, file := range files {
+			err := s.applyChange(ctx, file)
+			if errors.Is(err, errUnembedded) {
+				stale = append(stale, file)
+			} else if err != nil {
+				errs = append(errs, err)
+			}
+		}
+		if len(stale) == 0 {
+			break
+		}
+		s.mu.Unlock()
+		s.embedNewChunks(ctx, stale)
+		s.mu.Lock()
+		if err := ctx.Err(); err != nil {
+			return err
+		}
+		files = stale
+	}
+	return errors.Join(errs...)
+}
+
+// applyChange applies a re-chunked file to the index, scheduling its work in
+// the class of ctx. s.mu must be held.
+func (s *CompletionService) applyChange(ctx context.Context, file *changedFile) error {
+	if file.touched {
+		s.touchFile(file.path, file.meta)
+		return nil
+	}
+	return s.updateFile(ctx, file)
+}
+
+// touchFile records new size and modification time for a file whose content
+// is unchanged, so the next start does not read it again. s.mu must be held.
+func (s *CompletionService) touchFile(path string, meta fileMeta) {
+	file := s.files[path]
+	if file == nil {
+		return
+	}
+	file.fileMeta = meta
+	if s.indexLog == nil {
+		return
+	}
+	// Re-stamp the stored record rather than fetching the embeddings again.
+	rec, err := s.indexLog.read(path)
+	if err != nil || rec == nil {
+		log.ErrorLogger.Printf("⚠️ Could not read index record for %s: %v", path, err)
+		return
+	}
+	rec.Size, rec.ModTime = meta.size, meta.modTime
+	s.appendIndexRecord(rec)
+}
+
+// chunkDiff tells which chunks of a file's new version are already in the
+// index and which need new vectors.
+type chunkDiff struct {
+	ids     []int    // Vector id per chunk: kept ids are filled in, added ones are not
+	hashes  []uint64 // Content hash per chunk
+	addedAt []int    // Positions of chunks whose text the indexed version lacks
+	removed []int    // Ids of indexed chunks the new version no longer has
+}
+
+// diffChunks matches chunks against the indexed version of their file,
+// which may be nil, by content hash.
+func diffChunks(previous *indexedFile, chunks []indexer.Chunk) chunkDiff {
+	reusable := make(map[uint64][]int)
+	if previous != nil {
+		for i, hash := range previous.hashes {
+			if id := previous.ids[i]; id >= 0 {
+				reusable[hash] = append(reusable[hash], id)
+			}
+		}
+	}
+
+	diff := chunkDiff{ids: make([]int, len(chunks)), hashes: make([]uint64, len(chunks))}
+	for i, chunk := range chunks {
+		diff.hashes[i] = cache.HashString(chunk.Content)
+		if candidates := reusable[diff.hashes[i]]; len(candidates) > 0 {
+			diff.ids[i] = candidates[len(candidates)-1]
+			reusable[diff.hashes[i]] = candidates[:len(candidates)-1]
+			continue
+		}
+		diff.addedAt = append(diff.addedAt, i)
+	}
+	for _, candidates := range reusable {
+		diff.removed = append(diff.removed, candidates...)
 	}
-	s.indexedData[path] = chunks
-	log.InfoLogger.Printf("📝 Staged %d chunks from %s", len(chunks), path)
-	return s.reIndex()
+	return diff
 }
 
-// DeleteFile removes a file's staged chunks and re-builds the index.
+// embedNewChunks embeds the chunks of changed files that their indexed
+// versions do not have, in one batched pass and without holding s.mu, and
+// keeps the results on the files for updateFile. Chunks with unchanged text
+// keep their vectors, and chunks embedded by an earlier call, and are not
+// embedded again.
+func (s *CompletionService) embedNewChunks(ctx context.Context, files []*changedFile) {
+	type position struct {
+		file  *changedFile
+		chunk int
+	}
+	var chunks []indexer.Chunk
+	var positions []position
+	s.mu.Lock()
+	for _, file := range files {
+		if file.touched {
+			continue
+		}
+		if file.embeddings == nil {
+			file.embeddings = make(map[int][]float32)
+		}
+		for _, i := range diffChunks(s.files[file.path], file.chunks).addedAt {
+			if _, embedded := file.embeddings[i]; embedded {
+				continue
+			}
+			chunks = append(chunks, file.chunks[i])
+			positions = append(positions, position{file, i})
+		}
+	}
+	s.mu.Unlock()
+
+	for j, emb := range s.embedChunks(ctx, chunks) {
+		positions[j].file.embeddings[positions[j].chunk] = emb
+	}
+}
+
+// updateFile diffs a file's new chunks against its indexed ones: chunks with
+// unchanged text keep their vectors, vanished ones are removed and new ones
+// are inserted with the embeddings from embedNewChunks. It returns
+// errUnembedded, changing nothing, if any new chunk lacks one. s.mu must be
+// held.
+func (s *CompletionService) updateFile(ctx context.Context, file *changedFile) error {
+	path, chunks := file.path, file.chunks
+	docs, err := s.documents()
+	if err != nil {
+		return err
+	}
+	previous := s.files[path]
+	diff := diffChunks(previous, chunks)
+	ids, removed := diff.ids, diff.removed
+
+	// The file may have changed in the index since its new chunks were
+	// embedded. Embedding what that left out is up to the caller, which
+	// must not do it with s.mu held.
+	for _, i := range diff.addedAt {
+		if _, found := file.embeddings[i]; !found {
+			return errUnembedded
+		}
+	}
+
+	var embeddings [][]float32
+	var documents []string
+	var insertAt []int
+	for _, i := range diff.addedAt {
+		if file.embeddings[i] == nil {
+			ids[i] = -1
+			continue
+		}
+		embeddings = append(embeddings, file.embeddings[i])
+		documents = append(documents, chunks[i].Content)
+		insertAt = append(insertAt, i)
+	}
+
+	if len(removed) > 0 {
+		remove := func() error { return s.db.Remove(removed) }
+		if err := s.updateStore(ctx, remove); err != nil {
+			return fmt.Errorf("failed to remove stale chunks of %s: %w", path, err)
+		}
+		docs.Delete(removed)
+		// The store hands the removed ids out again, so the file must stop
+		// claiming them even if inserting its new chunks fails below. It
+		// keeps its previous version, so the next change re-adds them.
+		s.files[path] = previous.without(removed)
+	}
+	if len(embeddings) > 0 {
+		var newIDs []int
+		insert := func() (err error) {
+			newIDs, err = s.db.Insert(embeddings)
+			return err
+		}
+		if err := s.updateStore(ctx, insert); err != nil {
+			return fmt.Errorf("failed to insert chunks of %s: %w", path, err)
+		}
+		if err := docs.Put(newIDs, documents); err != nil {
+			// Take the vectors out again rather than leave search results
+			// without text; this must happen even if ctx is done by now.
+			rollback := func() error { return s.db.Remove(newIDs) }
+			if err := s.updateStore(context.WithoutCancel(ctx), rollback); err != nil {
+				log.ErrorLogger.Printf("⚠️ Could not remove unstored chunks of %s: %v", path, err)
+			}
+			return fmt.Errorf("failed to store chunks of %s: %w", path, err)
+		}
+		for j, id := range newIDs {
+			ids[insertAt[j]] = id
+		}
+	}
+	s.files[path] = &indexedFile{fileMeta: file.meta, hashes: diff.hashes, ids: ids}
+	log.InfoLogger.Printf("📝 %s: %d chunks kept, %d embedded, %d removed", path, len(chunks)-len(diff.addedAt), len(diff.addedAt), len(removed))
+
+	if s.indexLog != nil {
+		s.appendIndexRecord(file.meta.record(path, chunks, s.fileEmbeddings(file, diff)))
+	}
+	return nil
+}
+
+// fileEmbeddings returns the embedding of every chunk of a changed file for
+// its index record: added chunks from the file, kept ones from the file's
+// previous record, or from the cache if that cannot be read. s.mu must be
+// held.
+func (s *CompletionService) fileEmbeddings(file *changedFile, diff chunkDiff) [][]float32 {
+	embeddings := make([][]float32, len(file.chunks))
+	for i, emb := range file.embeddings {
+		embeddings[i] = emb
+	}
+
+	kept := make(map[uint64][]float32)
+	rec, err := s.indexLog.read(file.path)
+	if err != nil {
+		log.ErrorLogger.Printf("⚠️ Could not read index record for %s: %v", file.path, err)
+	}
+	if rec != nil {
+		for i, chunk := range rec.Chunks {
+			if i < len(rec.Embeddings) && rec.Embeddings[i] != nil {
+				kept[cache.HashString(chunk.Content)] = rec.Embeddings[i]
+			}
+		}
+	}
+	for i, chunk := range file.chunks {
+		if _, added := file.embeddings[i]; added || diff.ids[i] < 0 {
+			continue
+		}
+		if emb, found := kept[diff.hashes[i]]; found {
+			embeddings[i] = emb
+		} else if emb, found := s.cache.Get(s.keyer.Key(chunk.FilePath, chunk.Content)); found {
+			embeddings[i] = emb
+		}
+	}
+	return embeddings
+}
+
+// appendIndexRecord persists a file change to the on-disk index, if one is
+// open. A failure only costs re-embedding the file on the next start.
+// s.mu must be held.
+func (s *CompletionService) appendIndexRecord(rec *indexRecord) {
+	if s.indexLog == nil {
+		return
+	}
+	if err := s.indexLog.append(rec); err != nil {
+		log.ErrorLogger.Printf("⚠️ Failed to update index %s: %v", s.indexLog.path, err)
+	}
+}
+
+// DeleteFile removes a file's chunks from the vector store and the index.
 func (s *CompletionService) DeleteFile(path string) error {
 	log.InfoLogger.Printf("🗑️ Deleting file from index: %s", path)
-	if _, ok := s.indexedData[path]; !ok {
+	s.typeahead.forget(path)
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	return s.deleteFile(withWorkClass(context.Background(), classFileIndex), path)
+}
+
+// deleteFile removes a file's vectors and records the deletion on disk,
+// scheduling the removal in the class of ctx. s.mu must be held.
+func (s *CompletionService) deleteFile(ctx context.Context, path string) error {
+	previous := s.files[path]
+	if previous == nil {
 		log.InfoLogger.Printf("Nothing to delete for %s", path)
 		return nil
 	}
-	delete(s.indexedData, path)
-	return s.reIndex()
+	var removed []int
+	for _, id := range previous.ids {
+		if id >= 0 {
+			removed = append(removed, id)
+		}
+	}
+	remove := func() error { return s.db.Remove(removed) }
+	if err := s.updateStore(ctx, remove); err != nil {
+		return fmt.Errorf("failed to remove chunks of %s: %w", path, err)
+	}
+	if docs := s.docs.Load(); docs != nil {
+		docs.Delete(removed)
+	}
+	delete(s.files, path)
+	s.parses.Forget(path)
+	s.appendIndexRecord(&indexRecord{Path: path, Deleted: true})
+	return nil
 }
 
 // GetCompletion generates a code completion by embedding the query,
 // querying the vector store, building a prompt, and calling the LLM.
-func (s *CompletionService) GetCompletion(filePath, content string) (string, error) {
-	queryEmb, err := s.embedder.Embed(content)
+// A prefix that continues the file's previous request by the start of its
+// completion is answered with the rest of that completion instead.
+//
+// Every stage is abandoned when ctx is done or a newer completion request
+// for filePath arrives; the error is then ctx's cause, such as
+// ErrSuperseded.
+func (s *CompletionService) GetCompletion(ctx context.Context, filePath, content string) (string, error) {
+	defer completionLatency.ObserveSince(time.Now())
+	ctx, end := s.inflight.begin(ctx, filePath)
+	defer end()
+
+	if remainder, found := s.typeahead.lookup(filePath, content); found {
+		typeaheadHits.Inc()
+		return remainder, nil
+	}
+	typeaheadMisses.Inc()
+
+	prompt, err := s.preparePrompt(ctx, content)
 	if err != nil {
-		return "", fmt.Errorf("failed to embed query: %w", err)
+		return "", abandoned(ctx, err)
 	}
-	similarDocs, err := s.db.Query(queryEmb, 5)
+	completion, err := s.llm.Complete(ctx, prompt)
 	if err != nil {
-		return "", fmt.Errorf("failed to query vector store: %w", err)
+		return "", abandoned(ctx, err)
 	}
-	prompt := s.buildPrompt(content, similarDocs)
-	return s.llm.Complete(prompt)
+	if ctx.Err() == nil {
+		s.typeahead.store(filePath, content, completion)
+	}
+	return completion, nil
 }
 
-// GetCompletionStream streams token-by-token completions to the channel.
-func (s *CompletionService) GetCompletionStream(filePath, content string, ch chan<- string) {
-	queryEmb, err := s.embedder.Embed(content)
+// preparePrompt runs the retrieval stages of the pipeline (query embedding,
+// vector search, prompt construction) and records their metrics.
+func (s *CompletionService) preparePrompt(ctx context.Context, content string) (string, error) {
+	stageStart := time.Now()
+	queryEmb, err := s.embedQuery(ctx, content)
 	if err != nil {
-		log.ErrorLogger.Printf("failed to embed query for streaming: %v", err)
-		close(ch)
-		return
+		return "", err
 	}
-	similarDocs, err := s.db.Query(queryEmb, 5)
+	queryEmbedLatency.ObserveSince(stageStart)
+
+	stageStart = time.Now()
+	ids, err := s.db.Query(ctx, queryEmb, 5)
 	if err != nil {
-		log.ErrorLogger.Printf("failed to query vector store for streaming: %v", err)
-		close(ch)
-		return
+		return "", fmt.Errorf("failed to query vector store: %w", err)
+	}
+	similarDocs, err := s.readDocuments(ids)
+	if err != nil {
+		return "", err
 	}
+	vectorSearchLatency.ObserveSince(stageStart)
 	log.InfoLogger.Printf("Found %d similar documents.", len(similarDocs))
+
+	stageStart = time.Now()
 	prompt := s.buildPrompt(content, similarDocs)
-	s.llm.GetCompletionStream(prompt, ch)
+	promptBuildLatency.ObserveSince(stageStart)
+	promptBytes.Observe(float64(len(prompt)))
+	promptTokens.Observe(float64(estimateTokens(prompt)))
+	return prompt, nil
+}
+
+// embedQuery embeds the window around the cursor that retrieval is based
+// on, reusing the embedding of an identical recent window.
+func (s *CompletionService) embedQuery(ctx context.Context, content string) ([]float32, error) {
+	window := queryWindow(content, s.config.QueryLines())
+	queryWindowBytes.Observe(float64(len(window)))
+	if emb, found := s.queries.get(window); found {
+		queryCacheHits.Inc()
+		return emb, nil
+	}
+	queryCacheMisses.Inc()
+	emb, err := s.embedder.Embed(ctx, window)
+	if err != nil {
+		return nil, fmt.Errorf("failed to embed query: %w", err)
+	}
+	s.queries.set(window, emb)
+	return emb, nil
+}
+
+// readDocuments returns the text of the chunks with the given vector ids,
+// skipping any removed since the search.
+func (s *CompletionService) readDocuments(ids []int) ([]string, error) {
+	// loadRecords may swap the store and close the old one meanwhile;
+	// a store that is already closed has been replaced, so read the new one.
+	var docs *storage.DocStore
+	for {
+		docs = s.docs.Load()
+		if docs == nil {
+			return nil, nil
+		}
+		if docs.Acquire() {
+			break
+		}
+	}
+	defer docs.Release()
+	texts := make([]string, 0, len(ids))
+	for _, id := range ids {
+		text, err := docs.Get(id)
+		if err != nil {
+			return nil, fmt.Errorf("failed to read similar document: %w", err)
+		}
+		if text != "" {
+			texts = append(texts, text)
+		}
+	}
+	return texts, nil
+}
+
+// GetCompletionStream streams a completion to ch as the LLM produces it and
+// closes ch at the end. The stream ends with the first complete statement
+// or block, at which point the LLM request is cancelled, and earlier when
+// ctx is done or the request is superseded as in GetCompletion.
+//
+// It returns the error that ended the stream early: a failure to prepare
+// the prompt or of the LLM stream, or ctx's cause, such as ErrSuperseded,
+// if it was abandoned.
+func (s *CompletionService) GetCompletionStream(ctx context.Context, filePath, content string, ch chan<- string) error {
+	defer close(ch)
+	defer completionLatency.ObserveSince(time.Now())
+	ctx, end := s.inflight.begin(ctx, filePath)
+	defer end()
+
+	if remainder, found := s.typeahead.lookup(filePath, content); found {
+		typeaheadHits.Inc()
+		select {
+		case ch <- remainder:
+		case <-ctx.Done():
+		}
+		return nil
+	}
+	typeaheadMisses.Inc()
+
+	prompt, err := s.preparePrompt(ctx, content)
+	if err != nil {
+		return abandoned(ctx, err)
+	}
+
+	upstream, stopUpstream := context.WithCancel(ctx)
+	defer stopUpstream()
+	tokens := make(chan string)
+	streamErr := make(chan error, 1)
+	go func() { streamErr <- s.llm.GetCompletionStream(upstream, prompt, tokens) }()
+
+	unit := newLogicalUnit(content)
+	complete := false
+	for token := range tokens {
+		piece, done := unit.feed(token)
+		if piece != "" {
+			select {
+			case ch <- piece:
+			case <-ctx.Done():
+			}
+		}
+		if done || ctx.Err() != nil {
+			complete = done
+			stopUpstream()
+			break
+		}
+	}
+	for range tokens {
+		// Let the LLM stream notice the cancellation and close.
+	}
+	err = <-streamErr
+	switch {
+	case ctx.Err() != nil:
+		return abandoned(ctx, err)
+	case complete:
+		streamEarlyStops.Inc()
+	case err != nil:
+		return fmt.Errorf("completion stream failed: %w", err)
+	}
+	s.typeahead.store(filePath, content, unit.completion())
+	return nil
+}
+
+// abandoned returns the reason ctx was cancelled if err came from giving up
+// on it, and err otherwise.
+func abandoned(ctx context.Context, err error) error {
+	if ctx.Err() != nil {
+		if errors.Is(context.Cause(ctx), ErrSuperseded) {
+			completionsSuperseded.Inc()
+		}
+		return context.Cause(ctx)
+	}
+	return err
 }
 
 // buildPrompt constructs the LLM prompt including context and rules.
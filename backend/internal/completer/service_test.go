@@ -0,0 +1,381 @@
+package completer
+
+import (
+	"context"
+	"errors"
+	"os"
+	"path/filepath"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+
+	"autocomplete/backend/internal/cache"
+	"autocomplete/backend/internal/indexer"
+	"autocomplete/backend/internal/storage"
+)
+
+// TestMain keeps the on-disk indexes of the tests out of the user's cache
+// directory.
+func TestMain(m *testing.M) {
+	dir, err := os.MkdirTemp("", "completer-test")
+	if err != nil {
+		panic(err)
+	}
+	os.Setenv("XDG_CACHE_HOME", dir)
+	code := m.Run()
+	os.RemoveAll(dir)
+	os.Exit(code)
+}
+
+// testDimensions is the size of the embeddings of testEmbedder.
+const testDimensions = 3
+
+// testEmbedder embeds a text by its length, so equal texts get equal
+// embeddings without a provider. Texts containing fail, if set, are refused.
+type testEmbedder struct {
+	fail     string
+	requests atomic.Int64
+
+	// onRequest, if set, is called at the start of every request.
+	onRequest func()
+}
+
+func (e *testEmbedder) Embed(ctx context.Context, text string) ([]float32, error) {
+	embeddings, err := e.BatchEmbed(ctx, []string{text})
+	if err != nil {
+		return nil, err
+	}
+	return embeddings[0], nil
+}
+
+func (e *testEmbedder) BatchEmbed(ctx context.Context, texts []string) ([][]float32, error) {
+	e.requests.Add(1)
+	if e.onRequest != nil {
+		e.onRequest()
+	}
+	if err := ctx.Err(); err != nil {
+		return nil, err
+	}
+	embeddings := make([][]float32, len(texts))
+	for i, text := range texts {
+		if e.fail != "" && strings.Contains(text, e.fail) {
+			return nil, errors.New("refused")
+		}
+		embeddings[i] = []float32{float32(len(text)), 1, 0}
+	}
+	return embeddings, nil
+}
+
+// errInsertFailed is returned by a memoryStore whose inserts fail.
+var errInsertFailed = errors.New("insert failed")
+
+// memoryStore is a vector store held in a map. Like the C store, it hands
+// out removed ids to later inserts.
+type memoryStore struct {
+	mu         sync.Mutex
+	vectors    map[int][]float32
+	free       []int
+	next       int
+	queries    int64
+	failInsert bool
+	closed     bool
+}
+
+func newMemoryStore() *memoryStore {
+	return &memoryStore{vectors: make(map[int][]float32)}
+}
+
+func (m *memoryStore) Add(vectors [][]float32) error {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	m.vectors, m.free, m.next = make(map[int][]float32), nil, len(vectors)
+	for id, vector := range vectors {
+		m.vectors[id] = vector
+	}
+	return nil
+}
+
+func (m *memoryStore) Insert(vectors [][]float32) ([]int, error) {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	if m.failInsert {
+		return nil, errInsertFailed
+	}
+	ids := make([]int, len(vectors))
+	for i, vector := range vectors {
+		if n := len(m.free); n > 0 {
+			ids[i], m.free = m.free[n-1], m.free[:n-1]
+		} else {
+			ids[i] = m.next
+			m.next++
+		}
+		m.vectors[ids[i]] = vector
+	}
+	return ids, nil
+}
+
+func (m *memoryStore) Remove(ids []int) error {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	for _, id := range ids {
+		if _, found := m.vectors[id]; !found {
+			return errors.New("vector not found")
+		}
+		delete(m.vectors, id)
+		m.free = append(m.free, id)
+	}
+	return nil
+}
+
+func (m *memoryStore) Query(ctx context.Context, vector []float32, k int) ([]int, error) {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	m.queries++
+	var ids []int
+	for id := range m.vectors {
+		if len(ids) == k {
+			break
+		}
+		ids = append(ids, id)
+	}
+	return ids, nil
+}
+
+func (m *memoryStore) Stats() storage.Stats {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	return storage.Stats{Vectors: len(m.vectors), Queries: m.queries}
+}
+
+func (m *memoryStore) Close() error {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	m.closed = true
+	return nil
+}
+
+func (m *memoryStore) isClosed() bool {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+	return m.closed
+}
+
+// newTestService returns a service over an in-memory store and a test
+// embedder.
+func newTestService(t *testing.T) (*CompletionService, *memoryStore, *testEmbedder) {
+	t.Helper()
+	store, embedder := newMemoryStore(), &testEmbedder{}
+	config := &Config{
+		Embedding:      EmbeddingConfig{Provider: ProviderOpenAI, BatchSize: 4},
+		ChunkMaxTokens: 60,
+		ChunkMinTokens: 1,
+	}
+	service := NewCompletionService(store, embedder, nil, cache.NewInMemoryCache(), config)
+	t.Cleanup(func() { service.Close() })
+	return service, store, embedder
+}
+
+// writeFiles writes files, by path relative to dir, and returns dir.
+func writeFiles(t *testing.T, dir string, files map[string]string) string {
+	t.Helper()
+	for name, content := range files {
+		path := filepath.Join(dir, name)
+		if err := os.MkdirAll(filepath.Dir(path), 0o755); err != nil {
+			t.Fatal(err)
+		}
+		if err := os.WriteFile(path, []byte(content), 0o644); err != nil {
+			t.Fatal(err)
+		}
+	}
+	return dir
+}
+
+// eventually fails the test unless cond holds within a few seconds.
+func eventually(t *testing.T, what string, cond func() bool) {
+	t.Helper()
+	deadline := time.Now().Add(5 * time.Second)
+	for !cond() {
+		if time.Now().After(deadline) {
+			t.Fatalf("timed out waiting for %s", what)
+		}
+		time.Sleep(5 * time.Millisecond)
+	}
+}
+
+// checkVectorIDs fails the test unless every vector id the service holds
+// for a file belongs to that file alone and is in the store, and the store
+// holds no other vectors.
+func checkVectorIDs(t *testing.T, s *CompletionService, store *memoryStore) {
+	t.Helper()
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	store.mu.Lock()
+	defer store.mu.Unlock()
+	owners := make(map[int]string)
+	for path, file := range s.files {
+		for _, id := range file.ids {
+			if id < 0 {
+				continue
+			}
+			if owner, taken := owners[id]; taken {
+				t.Fatalf("vector %d is held by both %s and %s", id, owner, path)
+			}
+			if _, found := store.vectors[id]; !found {
+				t.Fatalf("%s holds vector %d, which is not in the store", path, id)
+			}
+			owners[id] = path
+		}
+	}
+	if len(owners) != len(store.vectors) {
+		t.Fatalf("files hold %d vectors, the store %d", len(owners), len(store.vectors))
+	}
+}
+
+func TestIndexFileKeepsVectorIDsWhenInsertFails(t *testing.T) {
+	s, store, _ := newTestService(t)
+	dir := t.TempDir()
+	a := filepath.Join(dir, "a.go")
+	b := filepath.Join(dir, "b.go")
+
+	writeFiles(t, dir, map[string]string{"a.go": "package a\n\nfunc One() int { return 1 }\n\nfunc Two() int { return 2 }\n"})
+	if err := s.IndexFile(a); err != nil {
+		t.Fatal(err)
+	}
+	checkVectorIDs(t, s, store)
+
+	// Replacing Two removes its vector, then fails to insert the new one.
+	writeFiles(t, dir, map[string]string{"a.go": "package a\n\nfunc One() int { return 1 }\n\nfunc Three() int { return 3 }\n"})
+	store.mu.Lock()
+	store.failInsert = true
+	store.mu.Unlock()
+	if err := s.IndexFile(a); !errors.Is(err, errInsertFailed) {
+		t.Fatalf("IndexFile with failing inserts returned %v", err)
+	}
+	store.mu.Lock()
+	store.failInsert = false
+	store.mu.Unlock()
+	checkVectorIDs(t, s, store)
+
+	// A second file gets the id Two had; a must not touch it when it is
+	// indexed again.
+	writeFiles(t, dir, map[string]string{"b.go": "package b\n\nfunc Four() int { return 4 }\n"})
+	if err := s.IndexFile(b); err != nil {
+		t.Fatal(err)
+	}
+	checkVectorIDs(t, s, store)
+	if err := s.IndexFile(a); err != nil {
+		t.Fatal(err)
+	}
+	checkVectorIDs(t, s, store)
+	if got, want := len(store.vectors), len(s.files[a].ids)+len(s.files[b].ids); got != want {
+		t.Fatalf("store holds %d vectors after re-indexing, want %d", got, want)
+	}
+}
+
+func TestApplyChangesEmbedsWithoutServiceLock(t *testing.T) {
+	s, store, embedder := newTestService(t)
+	dir := t.TempDir()
+	a := filepath.Join(dir, "a.go")
+	ctx := withWorkClass(context.Background(), classFileIndex)
+
+	writeFiles(t, dir, map[string]string{"a.go": "package a\n\nfunc One() int { return 1 }\n"})
+	if err := s.IndexFile(a); err != nil {
+		t.Fatal(err)
+	}
+
+	// Embed a change to a, then let another change reach the index first,
+	// so the first one adds chunks it never embedded.
+	writeFiles(t, dir, map[string]string{"a.go": "package a\n\nfunc One() int { return 1 }\n\nfunc Two() int { return 2 }\n"})
+	late, err := s.rechunk(a)
+	if err != nil {
+		t.Fatal(err)
+	}
+	s.embedNewChunks(ctx, []*changedFile{late})
+	writeFiles(t, dir, map[string]string{"a.go": "package a\n\nfunc Three() int { return 3 }\n"})
+	if err := s.IndexFile(a); err != nil {
+		t.Fatal(err)
+	}
+	s.cache = cache.NewInMemoryCache()
+
+	requests := embedder.requests.Load()
+	embedder.onRequest = func() {
+		if !s.mu.TryLock() {
+			t.Error("embedding requested with the service lock held")
+			return
+		}
+		s.mu.Unlock()
+	}
+	if err := s.applyChanges(ctx, nil, []*changedFile{late}); err != nil {
+		t.Fatal(err)
+	}
+	if embedder.requests.Load() == requests {
+		t.Fatal("chunks missing from the index were not embedded")
+	}
+	if got := s.files[a]; got.hash != late.meta.hash || len(got.ids) != len(late.chunks) {
+		t.Fatalf("indexed version of a is %+v, want the late change", got)
+	}
+	checkVectorIDs(t, s, store)
+}
+
+func TestGetCompletionStreamReturnsPromptFailure(t *testing.T) {
+	s, _, embedder := newTestService(t)
+	embedder.fail = "func"
+
+	tokens := make(chan string)
+	streamErr := make(chan error, 1)
+	go func() {
+		streamErr <- s.GetCompletionStream(context.Background(), "/src/a.go", "package a\n\nfunc A() int {\n\treturn ", tokens)
+	}()
+	for token := range tokens {
+		t.Errorf("unexpected token %q", token)
+	}
+	if err := <-streamErr; err == nil || errors.Is(err, ErrSuperseded) {
+		t.Fatalf("GetCompletionStream with a failing embedder returned %v", err)
+	}
+}
+
+func TestReadDocumentsWhileTheIndexIsReloaded(t *testing.T) {
+	s, _, _ := newTestService(t)
+	dir := t.TempDir()
+	records := []*indexRecord{{
+		Path:       filepath.Join(dir, "a.go"),
+		Chunks:     []indexer.Chunk{{Content: "func A() int { return 1 }"}},
+		Embeddings: [][]float32{{1, 1, 0}},
+	}}
+	s.mu.Lock()
+	err := s.loadRecords(dir, records)
+	s.mu.Unlock()
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	done := make(chan struct{})
+	go func() {
+		defer close(done)
+		for i := 0; i < 200; i++ {
+			s.mu.Lock()
+			err := s.loadRecords(dir, records)
+			s.mu.Unlock()
+			if err != nil {
+				t.Error(err)
+				return
+			}
+		}
+	}()
+	for {
+		select {
+		case <-done:
+			return
+		default:
+		}
+		texts, err := s.readDocuments([]int{0})
+		if err != nil {
+			t.Fatalf("readDocuments during a reload: %v", err)
+		}
+		if len(texts) != 1 {
+			t.Fatalf("readDocuments during a reload returned %q", texts)
+		}
+	}
+}
@@ -0,0 +1,172 @@
+package completer
+
+import "strings"
+
+// logicalUnit finds where the first complete statement or block of a
+// streamed completion ends, so that streaming can stop there instead of
+// waiting for the model to finish everything it had to say.
+//
+// It is a lexical approximation that works across languages: a unit ends at
+// the first line break outside brackets and strings that follows a line of
+// code, unless that line continues (a trailing operator, comma, backslash or
+// decorator). A line ending in ':' opens an indented block, as in Python,
+// which ends before the next line indented no deeper than it. Trailing
+// whitespace is held back until more code follows, so a cut never leaves a
+// dangling line break.
+type logicalUnit struct {
+	text    strings.Builder
+	emitted int // Bytes of text already returned by feed
+	lastEnd int // End of the last non-whitespace byte
+
+	depth       int
+	quote       byte // Open string delimiter, or 0
+	escaped     bool
+	lineStart   int
+	lineIndent  int  // Indentation of the current line; -1 until known
+	lineHasCode bool // Current line has more than whitespace and comments
+	comment     bool // Rest of the current line is a comment
+	blockIndent int  // Indentation of the line opening a ':' block; -1 if none
+
+	// The first line continues the line of the cursor in prefix.
+	cursorIndent int
+	cursorBlank  bool // The cursor's line holds only indentation so far
+}
+
+// newLogicalUnit returns a logicalUnit for a completion of prefix.
+func newLogicalUnit(prefix string) *logicalUnit {
+	cursorLine := prefix[strings.LastIndexByte(prefix, '\n')+1:]
+	code := strings.TrimLeft(cursorLine, " \t")
+	return &logicalUnit{
+		lineIndent:   -1,
+		blockIndent:  -1,
+		cursorIndent: len(cursorLine) - len(code),
+		cursorBlank:  code == "",
+	}
+}
+
+// feed adds the next streamed token and returns the part of the completion
+// that can be shown now, and whether the first unit is complete. After it
+// reports true the rest of the stream should be discarded.
+func (u *logicalUnit) feed(token string) (string, bool) {
+	start := u.text.Len()
+	u.text.WriteString(token)
+	text := u.text.String()
+	for i := start; i < len(text); i++ {
+		if end, done := u.scan(text, i); done {
+			return u.flush(text, min(end, u.lastEnd)), true
+		}
+	}
+	return u.flush(text, u.lastEnd), false
+}
+
+// completion returns the text of the first unit, or all of the text if the
+// unit has not ended yet.
+func (u *logicalUnit) completion() string {
+	return u.text.String()[:u.emitted]
+}
+
+func (u *logicalUnit) flush(text string, end int) string {
+	if end <= u.emitted {
+		return ""
+	}
+	piece := text[u.emitted:end]
+	u.emitted = end
+	return piece
+}
+
+// scan processes text[i] and reports the end of the unit if it ends there.
+func (u *logicalUnit) scan(text string, i int) (int, bool) {
+	c := text[i]
+	if c == '\n' {
+		return u.endLine(text, i)
+	}
+	if c == ' ' || c == '\t' || c == '\r' {
+		return 0, false
+	}
+	if u.lineIndent < 0 {
+		switch {
+		case u.lineStart > 0:
+			u.lineIndent = i - u.lineStart
+		case u.cursorBlank:
+			u.lineIndent = u.cursorIndent + i
+		default:
+			u.lineIndent = u.cursorIndent
+		}
+		if u.blockIndent >= 0 && u.lineIndent <= u.blockIndent && u.depth <= 0 && u.quote == 0 {
+			// Dedented past the block opener: the block is complete.
+			return u.lineStart, true
+		}
+	}
+	u.lastEnd = i + 1
+	if u.comment {
+		return 0, false
+	}
+
+	switch {
+	case u.quote != 0:
+		u.lineHasCode = true
+		switch {
+		case u.escaped:
+			u.escaped = false
+		case c == '\\':
+			u.escaped = true
+		case c == u.quote:
+			u.quote = 0
+		}
+	case c == '"' || c == '\'' || c == '`':
+		u.quote = c
+		u.lineHasCode = true
+	case c == '#' || c == '/' && i > 0 && text[i-1] == '/':
+		u.comment = true
+	case strings.IndexByte("([{", c) >= 0:
+		u.depth++
+		u.lineHasCode = true
+	case strings.IndexByte(")]}", c) >= 0:
+		u.depth--
+		u.lineHasCode = true
+	case c != '/':
+		u.lineHasCode = true
+	}
+	return 0, false
+}
+
+// endLine handles the line break at text[i].
+func (u *logicalUnit) endLine(text string, i int) (int, bool) {
+	line := strings.TrimSpace(text[u.lineStart:i])
+	hadCode, indent := u.lineHasCode, u.lineIndent
+	if u.quote != '`' {
+		u.quote, u.escaped = 0, false
+	}
+	u.lineStart, u.lineIndent, u.lineHasCode, u.comment = i+1, -1, false, false
+
+	if !hadCode || u.depth > 0 || u.quote != 0 {
+		return 0, false
+	}
+	if code, _, found := strings.Cut(line, "#"); found && !strings.ContainsAny(code, "\"'") {
+		line = strings.TrimSpace(code)
+	}
+	if strings.HasSuffix(line, ":") {
+		if u.blockIndent < 0 {
+			u.blockIndent = indent
+		}
+		return 0, false
+	}
+	if u.blockIndent >= 0 || continuesOnNextLine(line) {
+		return 0, false
+	}
+	return i, true
+}
+
+// continuesOnNextLine reports whether a line of code is syntactically
+// unfinished.
+func continuesOnNextLine(line string) bool {
+	if strings.HasPrefix(line, "@") {
+		return true // A decorator applies to the declaration after it
+	}
+	for _, suffix := range []string{",", "\\", "=", "+", "-", "*", "/", "%", "&", "|", "^", "<", ">", ".", "?", "=>", "->"} {
+		if strings.HasSuffix(line, suffix) {
+			return !strings.HasSuffix(line, "++") && !strings.HasSuffix(line, "--") && !strings.HasSuffix(line, "*/")
+		}
+	}
+	return false
+}
@@ -0,0 +1,54 @@
+package completer
+
+import (
+	"context"
+	"errors"
+	"sync"
+)
+
+// ErrSuperseded is the cause of a completion request cancelled because a
+// newer request arrived for the same file.
+var ErrSuperseded = errors.New("completion superseded by a newer request")
+
+// supersession keeps only the latest in-flight completion request of each
+// file alive. While the user types, every debounced keystroke asks for a
+// completion of the same document; earlier ones can no longer be shown, so
+// their embedding and LLM calls are cancelled rather than run to the end.
+type supersession struct {
+	mu     sync.Mutex
+	latest map[string]*inflightCompletion
+}
+
+type inflightCompletion struct {
+	cancel context.CancelCauseFunc
+}
+
+func newSupersession() *supersession {
+	return &supersession{latest: make(map[string]*inflightCompletion)}
+}
+
+// begin registers a completion request for path, cancelling the one before
+// it with ErrSuperseded. The returned context is done when ctx is or when a
+// later request for path begins; end must be called once the request is
+// finished.
+func (s *supersession) begin(ctx context.Context, path string) (context.Context, func()) {
+	ctx, cancel := context.WithCancelCause(ctx)
+	request := &inflightCompletion{cancel: cancel}
+
+	s.mu.Lock()
+	if previous := s.latest[path]; previous != nil {
+		previous.cancel(ErrSuperseded)
+	}
+	s.latest[path] = request
+	s.mu.Unlock()
+
+	end := func() {
+		s.mu.Lock()
+		if s.latest[path] == request {
+			delete(s.latest, path)
+		}
+		s.mu.Unlock()
+		cancel(context.Canceled)
+	}
+	return ctx, end
+}
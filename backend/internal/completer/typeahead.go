@@ -0,0 +1,112 @@
+package completer
+
+import (
+	"container/list"
+	"strings"
+	"sync"
+
+	"autocomplete/backend/internal/cache"
+)
+
+// completionCacheFiles is the number of files whose last completion is kept
+// for typeahead.
+const completionCacheFiles = 64
+
+// typeaheadCache remembers the last completion shown for each recently edited
+// file, so that while the user types the start of that completion the rest
+// of it is returned without running the pipeline again. The prefix a
+// completion was made for is kept only as a length and hash: a new prefix
+// continues it when it is longer and its first prefixLen bytes hash the
+// same.
+type typeaheadCache struct {
+	mu       sync.Mutex
+	capacity int
+	order    *list.List // Of *typeaheadEntry, most recently used first
+	files    map[string]*list.Element
+}
+
+type typeaheadEntry struct {
+	path       string
+	prefixLen  int
+	prefixHash uint64
+	completion string
+}
+
+func newTypeaheadCache(capacity int) *typeaheadCache {
+	return &typeaheadCache{
+		capacity: capacity,
+		order:    list.New(),
+		files:    make(map[string]*list.Element),
+	}
+}
+
+// lookup returns what remains of the cached completion for path once the
+// text typed since it was made is consumed, if prefix only adds text the
+// completion starts with. The entry is dropped when prefix diverges from
+// it or has used it up.
+func (c *typeaheadCache) lookup(path, prefix string) (string, bool) {
+	c.mu.Lock()
+	element, found := c.files[path]
+	if !found {
+		c.mu.Unlock()
+		return "", false
+	}
+	entry := *element.Value.(*typeaheadEntry)
+	c.mu.Unlock()
+
+	// Hash outside the lock; the prefix can be large.
+	remainder, ok := "", false
+	if len(prefix) >= entry.prefixLen && cache.HashString(prefix[:entry.prefixLen]) == entry.prefixHash {
+		typed := prefix[entry.prefixLen:]
+		if len(typed) < len(entry.completion) && strings.HasPrefix(entry.completion, typed) {
+			remainder, ok = entry.completion[len(typed):], true
+		}
+	}
+
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if element, found := c.files[path]; found && *element.Value.(*typeaheadEntry) == entry {
+		if ok {
+			c.order.MoveToFront(element)
+		} else {
+			c.order.Remove(element)
+			delete(c.files, path)
+		}
+	}
+	return remainder, ok
+}
+
+// store records completion as the one shown for prefix in path.
+func (c *typeaheadCache) store(path, prefix, completion string) {
+	if completion == "" {
+		return
+	}
+	entry := &typeaheadEntry{
+		path:       path,
+		prefixLen:  len(prefix),
+		prefixHash: cache.HashString(prefix),
+		completion: completion,
+	}
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if element, found := c.files[path]; found {
+		element.Value = entry
+		c.order.MoveToFront(element)
+		return
+	}
+	c.files[path] = c.order.PushFront(entry)
+	for c.order.Len() > c.capacity {
+		oldest := c.order.Remove(c.order.Back()).(*typeaheadEntry)
+		delete(c.files, oldest.path)
+	}
+}
+
+// forget drops the cached completion for path.
+func (c *typeaheadCache) forget(path string) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if element, found := c.files[path]; found {
+		c.order.Remove(element)
+		delete(c.files, path)
+	}
+}
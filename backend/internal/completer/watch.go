@@ -0,0 +1,191 @@
+package completer
+
+import (
+	"context"
+	"os"
+	"path/filepath"
+	"runtime"
+	"strings"
+	"sync"
+	"time"
+
+	"autocomplete/backend/internal/cache"
+	"autocomplete/backend/internal/indexer"
+	"autocomplete/backend/internal/log"
+)
+
+// WatchDirectory keeps the index of root up to date as files change on disk,
+// replacing any previous watch. It is a no-op when watching is disabled.
+func (s *CompletionService) WatchDirectory(root string) error {
+	debounce := time.Duration(s.config.WatchDebounceMS) * time.Millisecond
+	if debounce <= 0 {
+		return nil
+	}
+	watcher, err := indexer.NewWatcher(s.skipEntry, debounce)
+	if err != nil {
+		return err
+	}
+	if err := watcher.Start(root, s.queueWatchedChanges); err != nil {
+		watcher.Close()
+		return err
+	}
+
+	s.mu.Lock()
+	if s.jobs.ctx.Err() != nil {
+		// Indexing was stopped while the directory was indexed.
+		s.mu.Unlock()
+		watcher.Close()
+		return nil
+	}
+	previous := s.watcher
+	s.watcher = watcher
+	s.mu.Unlock()
+	if previous != nil {
+		previous.Close()
+	}
+	return nil
+}
+
+// stopWatching stops watching for changes.
+func (s *CompletionService) stopWatching() {
+	s.mu.Lock()
+	watcher := s.watcher
+	s.watcher = nil
+	s.mu.Unlock()
+	if watcher != nil {
+		watcher.Close()
+	}
+}
+
+// queueWatchedChanges queues a batch of changed paths from the watcher
+// behind any indexing in progress and waits for it, so the watcher collects
+// the next batch meanwhile instead of racing the queue.
+func (s *CompletionService) queueWatchedChanges(paths []string) {
+	s.QueueFileChanges(paths).Wait()
+}
+
+// parseCacheFiles is how many recently changed files keep their parse tree
+// for incremental reparsing.
+const parseCacheFiles = 64
+
+// changedFile is a re-chunked file waiting to be applied to the index.
+type changedFile struct {
+	path    string
+	meta    fileMeta
+	chunks  []indexer.Chunk
+	touched bool // Content unchanged; only size or modification time differ
+
+	// embeddings holds the embeddings of chunks the indexed version of the
+	// file lacks, by chunk position; nil where embedding failed.
+	embeddings map[int][]float32
+}
+
+// ApplyFileChanges brings the index up to date with a batch of changed
+// paths. Existing files are re-chunked in parallel and the new chunks of the
+// whole batch are embedded together, so a checkout touching thousands of
+// files costs a few batched embedding requests rather than one per file.
+// Paths that no longer exist are removed together with any indexed files
+// beneath them.
+func (s *CompletionService) ApplyFileChanges(paths []string) {
+	s.applyFileChanges(withWorkClass(context.Background(), classFileIndex), paths)
+}
+
+// applyFileChanges is ApplyFileChanges with embedding requests scheduled in
+// the work class of ctx.
+func (s *CompletionService) applyFileChanges(ctx context.Context, paths []string) {
+	start := time.Now()
+	s.reportProgress(0, int64(len(paths)))
+
+	var mu sync.Mutex
+	var changed []*changedFile
+	var removed []string
+	work := make(chan string)
+	var wg sync.WaitGroup
+	for i := 0; i < min(runtime.NumCPU(), len(paths)); i++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for path := range work {
+				file, err := s.rechunk(path)
+				s.reportProgress(1, 0)
+				if err != nil && !os.IsNotExist(err) {
+					log.ErrorLogger.Printf("⚠️ Could not re-chunk %s: %v. Skipping.", path, err)
+					continue
+				}
+				mu.Lock()
+				if err != nil {
+					removed = append(removed, path)
+				} else if file != nil {
+					changed = append(changed, file)
+				}
+				mu.Unlock()
+			}
+		}()
+	}
+	for _, path := range paths {
+		work <- path
+	}
+	close(work)
+	wg.Wait()
+
+	// The new chunks of every file are embedded in one batched pass before
+	// the lock is taken; the per-file updates then only touch the index.
+	if err := s.applyChanges(ctx, removed, changed); err != nil {
+		if ctx.Err() != nil {
+			log.InfoLogger.Printf("⏹️ Gave up applying %d file changes", len(paths))
+			return
+		}
+		log.ErrorLogger.Printf("⚠️ Failed to update index: %v", err)
+	}
+	log.InfoLogger.Printf("✅ Applied %d file changes (%d updated, %d removed) in %v",
+		len(paths), len(changed), len(removed), time.Since(start))
+}
+
+// rechunk reads and chunks a changed path. It returns nil for directories
+// and for files whose indexed version is current, and a touched change for
+// files whose metadata changed but content did not.
+func (s *CompletionService) rechunk(path string) (*changedFile, error) {
+	info, err := os.Stat(path)
+	if err != nil {
+		return nil, err
+	}
+	if info.IsDir() {
+		return nil, nil
+	}
+	content, err := os.ReadFile(path)
+	if err != nil {
+		return nil, err
+	}
+	meta := statMeta(info)
+	meta.hash = cache.HashBytes(content)
+
+	s.mu.Lock()
+	previous := s.files[path]
+	s.mu.Unlock()
+	if previous != nil && previous.hash == meta.hash {
+		if previous.fileMeta == meta {
+			return nil, nil
+		}
+		return &changedFile{path: path, meta: meta, touched: true}, nil
+	}
+
+	chunks, err := s.parses.Chunk(path, content)
+	if err != nil {
+		return nil, err
+	}
+	return &changedFile{path: path, meta: meta, chunks: chunks}, nil
+}
+
+// removeTree drops path from the index, along with every indexed file below
+// it when path was a directory, scheduling the removals in the class of ctx.
+// s.mu must be held.
+func (s *CompletionService) removeTree(ctx context.Context, path string) {
+	prefix := path + string(filepath.Separator)
+	for indexed := range s.files {
+		if indexed == path || strings.HasPrefix(indexed, prefix) {
+			if err := s.deleteFile(ctx, indexed); err != nil {
+				log.ErrorLogger.Printf("⚠️ Failed to remove %s from index: %v", indexed, err)
+			}
+		}
+	}
+}
@@ -0,0 +1,350 @@
+package completer
+
+import (
+	"container/list"
+	"errors"
+	"os"
+	"path/filepath"
+	"strings"
+	"sync"
+
+	"autocomplete/backend/internal/log"
+	"autocomplete/backend/internal/storage"
+)
+
+// Workspaces lets one backend process serve every workspace open in the
+// editor's windows. Each workspace root has its own CompletionService with
+// its own vector store and document mirror; the embedder, LLM client and
+// embedding cache are shared, so their connection pools and cached vectors
+// are too. Loaded indexes are kept in least-recently-used order and evicted
+// when their estimated size exceeds the memory budget. An evicted workspace
+// is loaded again from its on-disk index the next time a request needs it.
+type Workspaces struct {
+	newService func() (*CompletionService, error)
+	dimensions int
+	budget     int64 // Bytes of loaded indexes; 0 means unlimited
+
+	mu      sync.Mutex
+	byRoot  map[string]*list.Element // Of *workspace
+	recent  *list.List               // Most recently used at the front
+	evicted map[string]bool          // Roots to reload on demand
+	closed  bool
+
+	// closing holds unloaded workspaces whose services are not closed yet,
+	// and retired the search counters of those already closed, so the
+	// totals in VectorStats never go back when a workspace is evicted.
+	// released is signalled whenever one of them has closed.
+	closing  map[*workspace]bool
+	retired  storage.Stats
+	released *sync.Cond
+}
+
+// errWorkspacesClosed refuses to load workspaces after Close.
+var errWorkspacesClosed = errors.New("workspaces closed")
+
+type workspace struct {
+	root    string
+	service *CompletionService
+
+	// inUse is held for reading by every request and indexing run, so an
+	// evicted service is only closed once nothing uses it.
+	inUse sync.RWMutex
+}
+
+// NewWorkspaces returns an empty set of workspaces. newService creates the
+// service of a newly loaded workspace, whose vectors have dimensions
+// components; budgetBytes bounds the estimated size of the loaded indexes,
+// or is 0 for no bound.
+func NewWorkspaces(newService func() (*CompletionService, error), dimensions int, budgetBytes int64) *Workspaces {
+	w := &Workspaces{
+		newService: newService,
+		dimensions: dimensions,
+		budget:     budgetBytes,
+		byRoot:     make(map[string]*list.Element),
+		recent:     list.New(),
+		evicted:    make(map[string]bool),
+		closing:    make(map[*workspace]bool),
+	}
+	w.released = sync.NewCond(&w.mu)
+	return w
+}
+
+// Index loads the workspace at root, or the working directory if root is
+// empty, and indexes it in the background, then watches it for changes. A
+// workspace that is already loaded is brought up to date with the files on
+// disk. It returns the root being indexed.
+func (w *Workspaces) Index(root string) (string, error) {
+	if root == "" {
+		var err error
+		if root, err = os.Getwd(); err != nil {
+			return "", err
+		}
+	}
+	root = filepath.Clean(root)
+
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	if err := w.index(root); err != nil {
+		return "", err
+	}
+	return root, nil
+}
+
+// index loads the workspace at root and queues indexing it. w.mu must be
+// held.
+func (w *Workspaces) index(root string) error {
+	ws, err := w.load(root)
+	if err != nil {
+		return err
+	}
+	ws.inUse.RLock()
+	job := ws.service.QueueIndexDirectory(root)
+	go func() {
+		defer w.evict()
+		defer ws.inUse.RUnlock()
+		job.Wait()
+	}()
+	return nil
+}
+
+// Acquire returns the service of the workspace that path belongs to: the
+// loaded workspace with the longest root containing it. A path under an
+// evicted workspace loads that workspace again, and any other path goes to
+// the most recently used workspace. release must be called once the
+// service is no longer in use.
+func (w *Workspaces) Acquire(path string) (*CompletionService, func(), error) {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+
+	var found *list.Element
+	foundLen := -1
+	for root, elem := range w.byRoot {
+		if len(root) > foundLen && containsPath(root, path) {
+			found, foundLen = elem, len(root)
+		}
+	}
+	if found == nil {
+		for root := range w.evicted {
+			if containsPath(root, path) {
+				if err := w.index(root); err != nil {
+					return nil, nil, err
+				}
+				found = w.byRoot[root]
+				break
+			}
+		}
+	}
+	if found == nil {
+		found = w.recent.Front()
+	}
+
+	var ws *workspace
+	if found != nil {
+		w.recent.MoveToFront(found)
+		ws = found.Value.(*workspace)
+	} else {
+		// Nothing indexed yet: serve from an empty workspace, as a single
+		// workspace server did before its first index request.
+		var err error
+		if ws, err = w.load(""); err != nil {
+			return nil, nil, err
+		}
+	}
+	ws.inUse.RLock()
+	return ws.service, ws.inUse.RUnlock, nil
+}
+
+// Each calls fn with the service of every loaded workspace.
+func (w *Workspaces) Each(fn func(root string, service *CompletionService)) {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	for elem := w.recent.Front(); elem != nil; elem = elem.Next() {
+		ws := elem.Value.(*workspace)
+		fn(ws.root, ws.service)
+	}
+}
+
+// WorkspaceStatus reports the indexing jobs of one loaded workspace.
+type WorkspaceStatus struct {
+	Root string           `json:"root"`
+	Jobs []IndexJobStatus `json:"jobs"`
+}
+
+// IndexStatus returns the recent, running and queued indexing jobs of every
+// loaded workspace, most recently used workspace first.
+func (w *Workspaces) IndexStatus() []WorkspaceStatus {
+	statuses := []WorkspaceStatus{}
+	w.Each(func(root string, service *CompletionService) {
+		statuses = append(statuses, WorkspaceStatus{Root: root, Jobs: service.IndexJobs()})
+	})
+	return statuses
+}
+
+// Close closes every loaded workspace. Queued indexing jobs fail and running
+// ones are given up before it waits for requests in progress.
+func (w *Workspaces) Close() {
+	w.mu.Lock()
+	w.closed = true
+	var unloaded []*workspace
+	for elem := w.recent.Front(); elem != nil; elem = elem.Next() {
+		ws := elem.Value.(*workspace)
+		w.closing[ws] = true
+		unloaded = append(unloaded, ws)
+	}
+	w.byRoot = make(map[string]*list.Element)
+	w.recent.Init()
+	w.mu.Unlock()
+
+	for _, ws := range unloaded {
+		ws.service.stopJobs()
+	}
+	for _, ws := range unloaded {
+		w.retire(ws)
+	}
+}
+
+// load returns the workspace at root, creating it if it is not loaded, and
+// marks it most recently used. A root unloaded so recently that its previous
+// service is still closing is only loaded again once that service has let go
+// of the on-disk index. w.mu must be held, and may be released meanwhile.
+func (w *Workspaces) load(root string) (*workspace, error) {
+	for {
+		if elem := w.byRoot[root]; elem != nil {
+			w.recent.MoveToFront(elem)
+			return elem.Value.(*workspace), nil
+		}
+		if w.closed {
+			return nil, errWorkspacesClosed
+		}
+		if !w.retiring(root) {
+			break
+		}
+		w.released.Wait()
+	}
+	service, err := w.newService()
+	if err != nil {
+		return nil, err
+	}
+	ws := &workspace{root: root, service: service}
+	w.byRoot[root] = w.recent.PushFront(ws)
+	delete(w.evicted, root)
+	if root != "" {
+		// An empty workspace is only a stand-in until a real one loads.
+		if elem := w.byRoot[""]; elem != nil {
+			w.remove(elem)
+		}
+		workspaceLoads.Inc()
+		log.InfoLogger.Printf("🗃 Loaded workspace %s (%d loaded)", root, w.recent.Len())
+	}
+	return ws, nil
+}
+
+// evict unloads least recently used workspaces until the loaded indexes fit
+// the memory budget. The most recently used workspace always stays.
+func (w *Workspaces) evict() {
+	if w.budget <= 0 {
+		return
+	}
+	w.mu.Lock()
+	defer w.mu.Unlock()
+
+	var total int64
+	for elem := w.recent.Front(); elem != nil; elem = elem.Next() {
+		total += w.indexBytes(elem.Value.(*workspace))
+	}
+	for total > w.budget && w.recent.Len() > 1 {
+		elem := w.recent.Back()
+		ws := elem.Value.(*workspace)
+		size := w.indexBytes(ws)
+		w.remove(elem)
+		w.evicted[ws.root] = true
+		workspaceEvictions.Inc()
+		log.InfoLogger.Printf("🗃 Evicted workspace %s (%d MB) to stay within %d MB", ws.root, size>>20, w.budget>>20)
+		total -= size
+	}
+}
+
+// indexBytes estimates the memory held by the index of ws from its vectors,
+// which outweigh the graph links and per-file state.
+func (w *Workspaces) indexBytes(ws *workspace) int64 {
+	return int64(ws.service.db.Stats().Vectors) * int64(w.dimensions) * 4
+}
+
+// retiring reports whether a workspace at root is still closing. The empty
+// stand-in workspace has no on-disk index to share. w.mu must be held.
+func (w *Workspaces) retiring(root string) bool {
+	if root == "" {
+		return false
+	}
+	for ws := range w.closing {
+		if ws.root == root {
+			return true
+		}
+	}
+	return false
+}
+
+// remove unloads a workspace: its indexing jobs are given up at once, and its
+// service is closed once requests using it are done. w.mu must be held.
+func (w *Workspaces) remove(elem *list.Element) {
+	ws := elem.Value.(*workspace)
+	w.recent.Remove(elem)
+	delete(w.byRoot, ws.root)
+	w.closing[ws] = true
+	ws.service.stopJobs()
+	go w.retire(ws)
+}
+
+// retire stops watching an unloaded workspace, closes its service once
+// nothing uses it and keeps its search counters. w.mu must not be held.
+func (w *Workspaces) retire(ws *workspace) {
+	ws.service.stopWatching()
+	ws.service.closeJobs()
+	ws.inUse.Lock()
+	defer ws.inUse.Unlock()
+	stats := ws.service.db.Stats()
+	ws.service.Close()
+
+	// Only the counters outlive the index; its size and build figures go
+	// with it.
+	stats.Vectors, stats.BuildInserts, stats.BuildSeconds = 0, 0, 0
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	delete(w.closing, ws)
+	w.retired = storage.SumStats(w.retired, stats)
+	w.released.Broadcast()
+}
+
+// VectorStats returns the vector search statistics of all workspaces
+// together. Search counters include workspaces that have been unloaded
+// since, so they only ever grow.
+func (w *Workspaces) VectorStats() storage.Stats {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	stats := []storage.Stats{w.retired}
+	for elem := w.recent.Front(); elem != nil; elem = elem.Next() {
+		stats = append(stats, elem.Value.(*workspace).service.db.Stats())
+	}
+	for ws := range w.closing {
+		stats = append(stats, ws.service.db.Stats())
+	}
+	return storage.SumStats(stats...)
+}
+
+// Loaded returns the number of loaded workspaces.
+func (w *Workspaces) Loaded() int {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+	return w.recent.Len()
+}
+
+// containsPath reports whether path is root or lies beneath it.
+func containsPath(root, path string) bool {
+	if root == "" {
+		return false
+	}
+	if !strings.HasPrefix(path, root) {
+		return false
+	}
+	return len(path) == len(root) || path[len(root)] == filepath.Separator || strings.HasSuffix(root, string(filepath.Separator))
+}
@@ -0,0 +1,144 @@
+package completer
+
+import (
+	"context"
+	"path/filepath"
+	"sync"
+	"testing"
+	"time"
+)
+
+// indexedRoot reports whether a loaded workspace at root has finished an
+// indexing job.
+func indexedRoot(w *Workspaces, root string) bool {
+	for _, status := range w.IndexStatus() {
+		if status.Root != root {
+			continue
+		}
+		for _, job := range status.Jobs {
+			if job.State == "done" {
+				return true
+			}
+		}
+	}
+	return false
+}
+
+func TestWorkspacesReloadEvictedRootOnceItsServiceIsClosed(t *testing.T) {
+	a := writeFiles(t, t.TempDir(), map[string]string{"a.go": "package a\n\nfunc A() int { return 1 }\n"})
+	b := writeFiles(t, t.TempDir(), map[string]string{"b.go": "package b\n\nfunc B() int { return 2 }\n"})
+
+	var mu sync.Mutex
+	var services []*CompletionService
+	var stores []*memoryStore
+	var reloadedOpen bool
+	newService := func() (*CompletionService, error) {
+		service, store, _ := newTestService(t)
+		service.config.WatchDebounceMS = 50
+		mu.Lock()
+		defer mu.Unlock()
+		if len(stores) == 2 {
+			// Reloading a: the service it replaces must have let go of
+			// the on-disk index.
+			reloadedOpen = !stores[0].isClosed()
+		}
+		services = append(services, service)
+		stores = append(stores, store)
+		return service, nil
+	}
+	// A one byte budget keeps only the most recently used workspace.
+	w := NewWorkspaces(newService, testDimensions, 1)
+	defer w.Close()
+
+	if _, err := w.Index(a); err != nil {
+		t.Fatal(err)
+	}
+	eventually(t, "a to be indexed", func() bool { return indexedRoot(w, a) })
+	first, releaseFirst, err := w.Acquire(filepath.Join(a, "a.go"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	eventually(t, "a to be watched", func() bool {
+		first.mu.Lock()
+		defer first.mu.Unlock()
+		return first.watcher != nil
+	})
+
+	// Indexing b evicts a, which stays in use by the request above.
+	if _, err := w.Index(b); err != nil {
+		t.Fatal(err)
+	}
+	eventually(t, "a to be evicted", func() bool { return w.Loaded() == 1 && indexedRoot(w, b) })
+	if first.jobs.ctx.Err() == nil {
+		t.Fatal("evicted workspace still runs indexing jobs")
+	}
+	eventually(t, "a to stop watching", func() bool {
+		first.mu.Lock()
+		defer first.mu.Unlock()
+		return first.watcher == nil
+	})
+
+	reloaded := make(chan *CompletionService)
+	go func() {
+		service, release, err := w.Acquire(filepath.Join(a, "a.go"))
+		if err != nil {
+			t.Error(err)
+			close(reloaded)
+			return
+		}
+		release()
+		reloaded <- service
+	}()
+	select {
+	case <-reloaded:
+		t.Fatal("a was loaded again while its evicted service was open")
+	case <-time.After(100 * time.Millisecond):
+	}
+
+	releaseFirst()
+	second := <-reloaded
+	if second == nil || second == first {
+		t.Fatalf("Acquire after eviction returned %p, want a new service", second)
+	}
+	mu.Lock()
+	defer mu.Unlock()
+	if len(services) != 3 || reloadedOpen {
+		t.Fatalf("%d services created, reloaded while the evicted one was open: %v", len(services), reloadedOpen)
+	}
+}
+
+func TestWorkspacesKeepSearchCountersOfEvictedWorkspaces(t *testing.T) {
+	a := writeFiles(t, t.TempDir(), map[string]string{"a.go": "package a\n\nfunc A() int { return 1 }\n"})
+	b := writeFiles(t, t.TempDir(), map[string]string{"b.go": "package b\n\nfunc B() int { return 2 }\n"})
+	newService := func() (*CompletionService, error) {
+		service, _, _ := newTestService(t)
+		return service, nil
+	}
+	w := NewWorkspaces(newService, testDimensions, 1)
+	defer w.Close()
+
+	if _, err := w.Index(a); err != nil {
+		t.Fatal(err)
+	}
+	eventually(t, "a to be indexed", func() bool { return indexedRoot(w, a) })
+	service, release, err := w.Acquire(filepath.Join(a, "a.go"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	for i := 0; i < 3; i++ {
+		service.db.Query(context.Background(), []float32{1, 1, 0}, 1)
+	}
+	release()
+
+	if _, err := w.Index(b); err != nil {
+		t.Fatal(err)
+	}
+	eventually(t, "a to be evicted and closed", func() bool {
+		w.mu.Lock()
+		defer w.mu.Unlock()
+		return len(w.closing) == 0 && w.recent.Len() == 1 && w.evicted[a]
+	})
+	if got := w.VectorStats().Queries; got != 3 {
+		t.Fatalf("VectorStats().Queries = %d after eviction, want 3", got)
+	}
+}
@@ -13,15 +13,33 @@ type Chunk struct {
 	Content   string
 	StartLine int
 	EndLine   int
+	// Parent is the position, counting from 1, of the enclosing chunk in
+	// the file's chunk list when a large declaration was split (the piece
+	// holding its signature); 0 for chunks that stand on their own.
+	Parent int
+}
+
+// ChunkBudget bounds the size of declaration chunks in estimated tokens.
+// Declarations above MaxTokens are split at inner block boundaries, and
+// adjacent declarations below MinTokens are merged while the result stays
+// within MaxTokens.
+type ChunkBudget struct {
+	MaxTokens int
+	MinTokens int
+}
+
+// DefaultChunkBudget fits the input limit of common embedding models.
+var DefaultChunkBudget = ChunkBudget{MaxTokens: 512, MinTokens: 64}
+
+// estimateTokens approximates the token count of n bytes of source code.
+func estimateTokens(n uint32) int {
+	return int(n+3) / 4
 }
 
 // ChunkFile reads a file and splits it into chunks based on character size.
 // It aims for chunks of 1000 characters with 100 characters of overlap.
 // The chunkSize parameter from the function signature is ignored in favor of the constants defined within.
 func ChunkFile(filePath string, _ int) ([]Chunk, error) {
-	const chunkSize = 1000
-	const chunkOverlap = 100
-
 	contentBytes, err := os.ReadFile(filePath)
 	if err != nil {
 		return nil, err
@@ -32,10 +50,16 @@ func ChunkFile(filePath string, _ int) ([]Chunk, error) {
 		return nil, nil
 	}
 
-	content := string(contentBytes)
+	return chunkText(filePath, string(contentBytes)), nil
+}
+
+// chunkText splits content into overlapping chunks of chunkSize characters.
+func chunkText(filePath, content string) []Chunk {
+	const chunkSize = 1000
+	const chunkOverlap = 100
 
 	if strings.TrimSpace(content) == "" {
-		return nil, nil
+		return nil
 	}
 
 	lines := strings.Split(content, "\n")
@@ -91,5 +115,5 @@ func ChunkFile(filePath string, _ int) ([]Chunk, error) {
 		}
 	}
 
-	return chunks, nil
+	return chunks
 }
@@ -0,0 +1,289 @@
+package indexer
+
+import (
+	"bytes"
+	"container/list"
+	"context"
+	"sort"
+	"sync"
+	"unicode/utf8"
+
+	sitter "github.com/smacker/go-tree-sitter"
+)
+
+// ParseCache keeps the parse trees of recently edited files so that the
+// next change to one of them is parsed incrementally: the difference to the
+// previous version becomes a tree edit, tree-sitter reuses every unchanged
+// subtree, and only declarations overlapping the edit are captured again.
+// Chunks elsewhere in the file are carried over as they were.
+type ParseCache struct {
+	mu       sync.Mutex
+	capacity int
+	budget   ChunkBudget
+	order    *list.List // Of *parsedFile, most recently used first
+	files    map[string]*list.Element
+}
+
+// parsedFile is the last parse of a file and the chunks taken from it.
+type parsedFile struct {
+	path    string
+	lang    *language
+	content []byte
+	tree    *sitter.Tree
+	chunks  []Chunk
+	spans   []chunkSpan // Parallel to chunks; nil when they are text chunks
+}
+
+// NewParseCache creates a cache holding the trees of up to capacity files,
+// chunking them to budget.
+func NewParseCache(capacity int, budget ChunkBudget) *ParseCache {
+	return &ParseCache{
+		capacity: capacity,
+		budget:   budget,
+		order:    list.New(),
+		files:    make(map[string]*list.Element),
+	}
+}
+
+// Chunk chunks a new version of filePath like ChunkSourceWithTreeSitter,
+// reparsing incrementally when the previous version is cached. content is
+// retained and must not be modified afterwards.
+func (c *ParseCache) Chunk(filePath string, content []byte) ([]Chunk, error) {
+	lang := languageFor(filePath)
+	if lang == nil || !utf8.Valid(content) {
+		c.Forget(filePath)
+		return ChunkSourceWithTreeSitter(filePath, content, c.budget)
+	}
+	query, err := lang.compiledQuery()
+	if err != nil {
+		return nil, err
+	}
+
+	previous := c.take(filePath)
+	if previous != nil && previous.lang != lang {
+		previous.tree.Close()
+		previous = nil
+	}
+
+	var oldTree *sitter.Tree
+	var edit sitter.EditInput
+	if previous != nil {
+		edit = contentEdit(previous.content, content)
+		if edit.StartIndex == edit.OldEndIndex && edit.StartIndex == edit.NewEndIndex {
+			c.put(previous)
+			return previous.chunks, nil
+		}
+		previous.tree.Edit(edit)
+		oldTree = previous.tree
+	}
+
+	parser := lang.getParser()
+	tree, err := parser.ParseCtx(context.Background(), oldTree, content)
+	lang.putParser(parser)
+	if oldTree != nil {
+		oldTree.Close()
+	}
+	if err != nil {
+		return nil, err
+	}
+
+	file := &parsedFile{path: filePath, lang: lang, content: content, tree: tree}
+	reused := false
+	if previous != nil && previous.spans != nil {
+		file.chunks, file.spans, reused = recaptureEdited(previous, edit, query, tree, content, c.budget)
+	}
+	if !reused {
+		file.chunks, file.spans, _, _ = captureChunks(filePath, content, query, tree.RootNode(), c.budget, nil)
+	}
+	if len(file.chunks) == 0 {
+		file.chunks, file.spans = chunkText(filePath, string(content)), nil
+	}
+	c.put(file)
+	return file.chunks, nil
+}
+
+// Forget drops the cached parse of filePath, if any.
+func (c *ParseCache) Forget(filePath string) {
+	if file := c.take(filePath); file != nil {
+		file.tree.Close()
+	}
+}
+
+// take removes and returns the cached parse of path, giving the caller sole
+// use of its tree.
+func (c *ParseCache) take(path string) *parsedFile {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	element, found := c.files[path]
+	if !found {
+		return nil
+	}
+	delete(c.files, path)
+	return c.order.Remove(element).(*parsedFile)
+}
+
+// put caches file as the most recently used, evicting the least recently
+// used file beyond capacity.
+func (c *ParseCache) put(file *parsedFile) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if element, found := c.files[file.path]; found {
+		// Parsed concurrently by someone else; keep the newer one.
+		c.order.Remove(element).(*parsedFile).tree.Close()
+	}
+	c.files[file.path] = c.order.PushFront(file)
+	for c.order.Len() > c.capacity {
+		oldest := c.order.Remove(c.order.Back()).(*parsedFile)
+		delete(c.files, oldest.path)
+		oldest.tree.Close()
+	}
+}
+
+// contentEdit describes the change from old to new as a single edit
+// spanning everything between their common prefix and suffix.
+func contentEdit(oldContent, newContent []byte) sitter.EditInput {
+	prefix := 0
+	for prefix < len(oldContent) && prefix < len(newContent) && oldContent[prefix] == newContent[prefix] {
+		prefix++
+	}
+	suffix := 0
+	for suffix < len(oldContent)-prefix && suffix < len(newContent)-prefix &&
+		oldContent[len(oldContent)-1-suffix] == newContent[len(newContent)-1-suffix] {
+		suffix++
+	}
+	return sitter.EditInput{
+		StartIndex:  uint32(prefix),
+		OldEndIndex: uint32(len(oldContent) - suffix),
+		NewEndIndex: uint32(len(newContent) - suffix),
+		StartPoint:  pointAt(oldContent, prefix),
+		OldEndPoint: pointAt(oldContent, len(oldContent)-suffix),
+		NewEndPoint: pointAt(newContent, len(newContent)-suffix),
+	}
+}
+
+// pointAt returns the row and byte column of offset in content.
+func pointAt(content []byte, offset int) sitter.Point {
+	before := content[:offset]
+	row := bytes.Count(before, []byte{'\n'})
+	column := offset - (bytes.LastIndexByte(before, '\n') + 1)
+	return sitter.Point{Row: uint32(row), Column: uint32(column)}
+}
+
+// shiftByte and shiftPoint move a position at or after the end of an edit
+// to where it is in the edited source.
+func shiftByte(offset uint32, edit sitter.EditInput) uint32 {
+	return offset - edit.OldEndIndex + edit.NewEndIndex
+}
+
+func shiftPoint(p sitter.Point, edit sitter.EditInput) sitter.Point {
+	if p.Row == edit.OldEndPoint.Row {
+		p.Column = p.Column - edit.OldEndPoint.Column + edit.NewEndPoint.Column
+	}
+	p.Row = p.Row - edit.OldEndPoint.Row + edit.NewEndPoint.Row
+	return p
+}
+
+// recaptureEdited derives the chunks of an edited file from its previous
+// chunks. Chunking scans declarations left to right, merging small
+// neighbours, so the scan is restarted one chunk before the chunk the edit
+// falls in (which may now absorb a shrunken declaration) and continued only
+// until it starts a new chunk exactly where a chunk after the edit started;
+// every other chunk is carried over, moved if it follows the edit. The
+// result is the same as chunking the whole file. It reports false when the
+// new tree no longer has the declaration a kept chunk was taken from, as
+// happens when an edit changes how the rest of the file parses; the caller
+// then captures the whole file.
+func recaptureEdited(previous *parsedFile, edit sitter.EditInput, query *sitter.Query, tree *sitter.Tree, content []byte, budget ChunkBudget) ([]Chunk, []chunkSpan, bool) {
+	// Chunks are tracked by key until they are put in order: previous
+	// chunks by their old index, recaptured ones after those.
+	type entry struct {
+		chunk     Chunk
+		span      chunkSpan
+		key       int
+		parentKey int // -1 for none
+	}
+
+	// Spans are in source order, so the chunk starts before the edit are
+	// found by walking back.
+	window := &captureWindow{}
+	var last, before *chunkSpan
+	for i := range previous.spans {
+		span := &previous.spans[i]
+		if span.anchorStart >= edit.StartIndex {
+			break
+		}
+		if last == nil || span.anchorStart != last.anchorStart {
+			before, last = last, span
+		}
+	}
+	if before != nil {
+		window.startByte, window.startPoint = before.anchorStart, before.anchorStartPoint
+	}
+	var kept []entry
+	resumeAt := make(map[uint32]bool)
+	for i, span := range previous.spans {
+		e := entry{chunk: previous.chunks[i], span: span, key: i, parentKey: previous.chunks[i].Parent - 1}
+		switch {
+		case span.anchorStart < window.startByte:
+			kept = append(kept, e)
+		case span.startByte >= edit.OldEndIndex:
+			e.span = chunkSpan{
+				startByte:        shiftByte(span.startByte, edit),
+				endByte:          shiftByte(span.endByte, edit),
+				startPoint:       shiftPoint(span.startPoint, edit),
+				endPoint:         shiftPoint(span.endPoint, edit),
+				anchorStart:      shiftByte(span.anchorStart, edit),
+				anchorEnd:        shiftByte(span.anchorEnd, edit),
+				anchorStartPoint: shiftPoint(span.anchorStartPoint, edit),
+				anchorEndPoint:   shiftPoint(span.anchorEndPoint, edit),
+			}
+			e.chunk.StartLine = int(e.span.startPoint.Row + 1)
+			e.chunk.EndLine = int(e.span.endPoint.Row + 1)
+			kept = append(kept, e)
+			if e.span.startByte == e.span.anchorStart {
+				resumeAt[e.span.startByte] = true
+			}
+		}
+	}
+	window.stop = func(start uint32) bool {
+		return start >= edit.NewEndIndex && resumeAt[start]
+	}
+
+	root := tree.RootNode()
+	chunks, spans, stoppedAt, stopped := captureChunks(previous.path, content, query, root, budget, window)
+	entries := make([]entry, 0, len(chunks)+len(kept))
+	for i, span := range spans {
+		parentKey := -1
+		if chunks[i].Parent > 0 {
+			parentKey = len(previous.chunks) + chunks[i].Parent - 1
+		}
+		entries = append(entries, entry{chunk: chunks[i], span: span, key: len(previous.chunks) + i, parentKey: parentKey})
+	}
+
+	for _, e := range kept {
+		if e.span.anchorStart >= window.startByte && (!stopped || e.span.anchorStart < stoppedAt) {
+			continue // Replaced by the recaptured chunks
+		}
+		node := root.NamedDescendantForPointRange(e.span.anchorStartPoint, e.span.anchorEndPoint)
+		if node == nil || node.StartByte() != e.span.anchorStart || node.EndByte() != e.span.anchorEnd {
+			return nil, nil, false
+		}
+		entries = append(entries, e)
+	}
+
+	sort.Slice(entries, func(a, b int) bool { return entries[a].span.startByte < entries[b].span.startByte })
+	position := make(map[int]int, len(entries))
+	for i, e := range entries {
+		position[e.key] = i
+	}
+	chunks = make([]Chunk, len(entries))
+	spans = make([]chunkSpan, len(entries))
+	for i, e := range entries {
+		chunks[i], spans[i] = e.chunk, e.span
+		chunks[i].Parent = 0
+		if parent, found := position[e.parentKey]; found {
+			chunks[i].Parent = parent + 1
+		}
+	}
+	return chunks, spans, true
+}
@@ -0,0 +1,138 @@
+package indexer
+
+import (
+	"reflect"
+	"strings"
+	"testing"
+)
+
+// incrementalBudget is small enough for the sample below to have merged
+// runs of small functions and split large ones.
+var incrementalBudget = ChunkBudget{MaxTokens: 60, MinTokens: 16}
+
+const incrementalSample = `package sample
+
+import "fmt"
+
+func one() int { return 1 }
+
+func two() int { return 2 }
+
+func three() int { return 3 }
+
+func greet(name string) {
+	fmt.Println("hello,", name)
+	fmt.Println("nice to meet you")
+}
+
+func process(items []string) int {
+	total := 0
+	for _, item := range items {
+		if item == "" {
+			continue
+		}
+		total += len(item)
+		fmt.Println("processing", item)
+	}
+	if total > 100 {
+		fmt.Println("that was a lot of input to go through")
+	}
+	return total
+}
+
+func tail() string { return "tail" }
+`
+
+// TestParseCacheMatchesFullChunking checks that chunking an edited file
+// through the parse cache gives exactly the chunks of chunking the new
+// content from scratch, for edits in every part of a file.
+func TestParseCacheMatchesFullChunking(t *testing.T) {
+	tests := []struct {
+		name     string
+		old, new string // Replaced once in incrementalSample
+	}{
+		{"insert at start", "package sample\n", "// Package sample is chunked.\npackage sample\n"},
+		{"delete at start", "package sample\n\nimport \"fmt\"\n", "package sample\n"},
+		{"edit in middle", "nice to meet you", "good to see you again"},
+		{"grow a small function", "func two() int { return 2 }", "func two() int {\n\tfmt.Println(\"two is a larger function now\")\n\treturn 2\n}"},
+		{"shrink a large function", "\tif total > 100 {\n\t\tfmt.Println(\"that was a lot of input to go through\")\n\t}\n", ""},
+		{"edit at end", "return \"tail\"", "return \"the end\""},
+		{"append at end", "func tail() string { return \"tail\" }\n", "func tail() string { return \"tail\" }\n\nfunc extra() {}\n"},
+		{"delete at end", "\nfunc tail() string { return \"tail\" }\n", ""},
+		{"merge two declarations", " return 1 }\n\nfunc two() int {", ""},
+		{"merge into a large declaration", "\treturn total\n}\n\nfunc tail() string {", "\treturn total\n"},
+		{"split a declaration", "\tfmt.Println(\"hello,\", name)\n", "\tfmt.Println(\"hello,\", name)\n}\n\nfunc meet() {\n"},
+		{"split a large declaration", "\t\ttotal += len(item)\n", "\t\ttotal += len(item)\n\t}\n\treturn total\n}\n\nfunc more(items []string) {\n\tfor _, item := range items {\n"},
+		{"remove a declaration", "func three() int { return 3 }\n\n", ""},
+		{"multi-line insert before a chunk", "func greet(", "func added() {\n\tfmt.Println(\"one\")\n\tfmt.Println(\"two\")\n}\n\nfunc greet("},
+		{"multi-line delete before a chunk", "func one() int { return 1 }\n\nfunc two() int { return 2 }\n\n", ""},
+		{"multi-line replace before a chunk", "import \"fmt\"\n", "import (\n\t\"fmt\"\n\t\"strings\"\n)\n\nvar _ = strings.TrimSpace\n"},
+	}
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			if !strings.Contains(incrementalSample, tt.old) {
+				t.Fatalf("sample does not contain %q", tt.old)
+			}
+			edited := strings.Replace(incrementalSample, tt.old, tt.new, 1)
+			assertIncrementalChunks(t, "/src/sample.go", incrementalSample, edited)
+		})
+	}
+}
+
+// TestParseCacheMatchesFullChunkingAcrossEdits applies edits one after the
+// other, so each is parsed against the chunks of the previous incremental
+// parse rather than of a full one.
+func TestParseCacheMatchesFullChunkingAcrossEdits(t *testing.T) {
+	edits := []struct{ old, new string }{
+		{"func three() int { return 3 }", "func three() int {\n\treturn 3\n}"},
+		{"package sample\n", "// Package sample is chunked.\npackage sample\n"},
+		{"\t\ttotal += len(item)\n", "\t\ttotal += len(item)\n\t}\n\treturn total\n}\n\nfunc more(items []string) {\n\tfor _, item := range items {\n"},
+		{" return 1 }\n\nfunc two() int {", ""},
+		{"return \"tail\"", "return \"the end\""},
+		{"// Package sample is chunked.\n", ""},
+	}
+
+	cache := NewParseCache(1, incrementalBudget)
+	content := incrementalSample
+	if _, err := cache.Chunk("/src/sample.go", []byte(content)); err != nil {
+		t.Fatal(err)
+	}
+	for i, edit := range edits {
+		if !strings.Contains(content, edit.old) {
+			t.Fatalf("edit %d: content does not contain %q", i, edit.old)
+		}
+		content = strings.Replace(content, edit.old, edit.new, 1)
+		got, err := cache.Chunk("/src/sample.go", []byte(content))
+		if err != nil {
+			t.Fatalf("edit %d: %v", i, err)
+		}
+		want, err := ChunkSourceWithTreeSitter("/src/sample.go", []byte(content), incrementalBudget)
+		if err != nil {
+			t.Fatalf("edit %d: %v", i, err)
+		}
+		if !reflect.DeepEqual(got, want) {
+			t.Fatalf("edit %d: incremental chunks differ from full chunking\ngot:  %+v\nwant: %+v", i, got, want)
+		}
+	}
+}
+
+// assertIncrementalChunks chunks before and then after through a parse
+// cache and compares the result with chunking after from scratch.
+func assertIncrementalChunks(t *testing.T, path, before, after string) {
+	t.Helper()
+	cache := NewParseCache(1, incrementalBudget)
+	if _, err := cache.Chunk(path, []byte(before)); err != nil {
+		t.Fatal(err)
+	}
+	got, err := cache.Chunk(path, []byte(after))
+	if err != nil {
+		t.Fatal(err)
+	}
+	want, err := ChunkSourceWithTreeSitter(path, []byte(after), incrementalBudget)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if !reflect.DeepEqual(got, want) {
+		t.Fatalf("incremental chunks differ from full chunking\ngot:  %+v\nwant: %+v", got, want)
+	}
+}
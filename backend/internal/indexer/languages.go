@@ -0,0 +1,158 @@
+package indexer
+
+import (
+	"path/filepath"
+	"strings"
+	"sync"
+
+	sitter "github.com/smacker/go-tree-sitter"
+	"github.com/smacker/go-tree-sitter/c"
+	"github.com/smacker/go-tree-sitter/cpp"
+	"github.com/smacker/go-tree-sitter/golang"
+	"github.com/smacker/go-tree-sitter/java"
+	"github.com/smacker/go-tree-sitter/javascript"
+	"github.com/smacker/go-tree-sitter/python"
+	"github.com/smacker/go-tree-sitter/ruby"
+	"github.com/smacker/go-tree-sitter/rust"
+	"github.com/smacker/go-tree-sitter/typescript/tsx"
+	"github.com/smacker/go-tree-sitter/typescript/typescript"
+)
+
+// language is a tree-sitter grammar together with the query whose captures
+// become chunks. The query is compiled once, on first use, and parsers are
+// pooled so that bulk indexing does not allocate one per file.
+type language struct {
+	name    string
+	grammar *sitter.Language
+	pattern string
+
+	compileOnce sync.Once
+	query       *sitter.Query
+	compileErr  error
+
+	parsers sync.Pool
+}
+
+func newLanguage(name string, grammar *sitter.Language, pattern string) *language {
+	lang := &language{name: name, grammar: grammar, pattern: pattern}
+	lang.parsers.New = func() any {
+		parser := sitter.NewParser()
+		parser.SetLanguage(grammar)
+		return parser
+	}
+	return lang
+}
+
+// compiledQuery returns the language's chunk query, compiling it on first use.
+func (l *language) compiledQuery() (*sitter.Query, error) {
+	l.compileOnce.Do(func() {
+		l.query, l.compileErr = sitter.NewQuery([]byte(l.pattern), l.grammar)
+	})
+	return l.query, l.compileErr
+}
+
+func (l *language) getParser() *sitter.Parser {
+	return l.parsers.Get().(*sitter.Parser)
+}
+
+func (l *language) putParser(parser *sitter.Parser) {
+	l.parsers.Put(parser)
+}
+
+// Chunk queries capture declarations at any depth; captures nested inside an
+// earlier one are dropped, so a class becomes one chunk rather than one per
+// method as well.
+var (
+	goLanguage = newLanguage("go", golang.GetLanguage(), `
+		(function_declaration) @func
+		(method_declaration) @method
+		(type_declaration) @type
+	`)
+	pythonLanguage = newLanguage("python", python.GetLanguage(), `
+		(decorated_definition) @decorated
+		(function_definition) @func
+		(class_definition) @class
+	`)
+	javascriptLanguage = newLanguage("javascript", javascript.GetLanguage(), `
+		(export_statement) @export
+		(function_declaration) @func
+		(generator_function_declaration) @func
+		(class_declaration) @class
+		(lexical_declaration) @decl
+	`)
+	typescriptPattern = `
+		(export_statement) @export
+		(function_declaration) @func
+		(generator_function_declaration) @func
+		(class_declaration) @class
+		(abstract_class_declaration) @class
+		(interface_declaration) @interface
+		(type_alias_declaration) @type
+		(enum_declaration) @enum
+		(lexical_declaration) @decl
+	`
+	typescriptLanguage = newLanguage("typescript", typescript.GetLanguage(), typescriptPattern)
+	tsxLanguage        = newLanguage("tsx", tsx.GetLanguage(), typescriptPattern)
+	cLanguage          = newLanguage("c", c.GetLanguage(), `
+		(function_definition) @func
+		(type_definition) @type
+		(struct_specifier body: (_)) @struct
+		(enum_specifier body: (_)) @enum
+	`)
+	cppLanguage = newLanguage("cpp", cpp.GetLanguage(), `
+		(template_declaration) @template
+		(function_definition) @func
+		(type_definition) @type
+		(class_specifier body: (_)) @class
+		(struct_specifier body: (_)) @struct
+		(enum_specifier body: (_)) @enum
+	`)
+	javaLanguage = newLanguage("java", java.GetLanguage(), `
+		(method_declaration) @method
+		(constructor_declaration) @constructor
+		(interface_declaration) @interface
+		(enum_declaration) @enum
+	`)
+	rustLanguage = newLanguage("rust", rust.GetLanguage(), `
+		(function_item) @func
+		(impl_item) @impl
+		(trait_item) @trait
+		(struct_item) @struct
+		(enum_item) @enum
+	`)
+	rubyLanguage = newLanguage("ruby", ruby.GetLanguage(), `
+		(method) @method
+		(singleton_method) @method
+	`)
+)
+
+// languagesByExtension maps lower-case file extensions to their language.
+var languagesByExtension = map[string]*language{
+	".go":   goLanguage,
+	".py":   pythonLanguage,
+	".pyi":  pythonLanguage,
+	".js":   javascriptLanguage,
+	".jsx":  javascriptLanguage,
+	".mjs":  javascriptLanguage,
+	".cjs":  javascriptLanguage,
+	".ts":   typescriptLanguage,
+	".mts":  typescriptLanguage,
+	".cts":  typescriptLanguage,
+	".tsx":  tsxLanguage,
+	".c":    cLanguage,
+	".h":    cLanguage,
+	".cc":   cppLanguage,
+	".cpp":  cppLanguage,
+	".cxx":  cppLanguage,
+	".hh":   cppLanguage,
+	".hpp":  cppLanguage,
+	".hxx":  cppLanguage,
+	".java": javaLanguage,
+	".rs":   rustLanguage,
+	".rb":   rubyLanguage,
+}
+
+// languageFor returns the language of filePath, or nil if it has no grammar.
+func languageFor(filePath string) *language {
+	return languagesByExtension[strings.ToLower(filepath.Ext(filePath))]
+}
@@ -6,7 +6,6 @@ import (
 	"unicode/utf8"
 
 	sitter "github.com/smacker/go-tree-sitter"
-	"github.com/smacker/go-tree-sitter/golang"
 )
 
 // ChunkFileWithTreeSitter reads a file, parses it using tree-sitter, and extracts top-level declarations as chunks.
@@ -15,49 +14,220 @@ func ChunkFileWithTreeSitter(filePath string) ([]Chunk, error) {
 	if err != nil {
 		return nil, err
 	}
+	return ChunkSourceWithTreeSitter(filePath, content, DefaultChunkBudget)
+}
 
+// ChunkSourceWithTreeSitter chunks content already read from filePath using
+// the grammar registered for its extension, sizing chunks to budget. Files
+// without a grammar, and files in which the query finds no declarations,
+// are split into plain text chunks instead.
+func ChunkSourceWithTreeSitter(filePath string, content []byte, budget ChunkBudget) ([]Chunk, error) {
 	// Skip non UTF-8 files to avoid embedding binaries
 	if !utf8.Valid(content) {
 		return nil, nil
 	}
 
-	parser := sitter.NewParser()
-	parser.SetLanguage(golang.GetLanguage())
-
-	tree, err := parser.ParseCtx(context.Background(), nil, content)
+	lang := languageFor(filePath)
+	if lang == nil {
+		return chunkText(filePath, string(content)), nil
+	}
+	query, err := lang.compiledQuery()
 	if err != nil {
 		return nil, err
 	}
 
-	query, err := sitter.NewQuery([]byte(`
-		(function_declaration) @func
-		(method_declaration) @method
-		(type_declaration) @type
-	`), golang.GetLanguage())
+	parser := lang.getParser()
+	tree, err := parser.ParseCtx(context.Background(), nil, content)
+	lang.putParser(parser)
 	if err != nil {
 		return nil, err
 	}
+	defer tree.Close()
+
+	chunks, _, _, _ := captureChunks(filePath, content, query, tree.RootNode(), budget, nil)
+	if len(chunks) == 0 {
+		return chunkText(filePath, string(content)), nil
+	}
+	return chunks, nil
+}
+
+// chunkSpan is the position of a chunk in its source, along with the range
+// of the declaration it was taken from: the first of a merged run, or the
+// whole declaration for pieces of a split one.
+type chunkSpan struct {
+	startByte, endByte     uint32
+	startPoint, endPoint   sitter.Point
+	anchorStart, anchorEnd uint32
+	anchorStartPoint       sitter.Point
+	anchorEndPoint         sitter.Point
+}
 
+// captureWindow restricts a capture to the declarations starting at or
+// after startByte, and ends it before the first chunk that would start at a
+// position stop accepts.
+type captureWindow struct {
+	startByte  uint32
+	startPoint sitter.Point
+	stop       func(start uint32) bool
+}
+
+// captureChunks runs query over root and turns the captured declarations
+// into chunks sized to budget: runs of small adjacent declarations are
+// merged and oversized ones split. Captures that lie inside one already
+// taken are skipped. With a window, only part of the file is captured and
+// the position where a stop ended the capture is returned.
+func captureChunks(filePath string, content []byte, query *sitter.Query, root *sitter.Node, budget ChunkBudget, window *captureWindow) (chunks []Chunk, spans []chunkSpan, stoppedAt uint32, stopped bool) {
 	qc := sitter.NewQueryCursor()
-	qc.Exec(query, tree.RootNode())
+	defer qc.Close()
+	declarations := declarationCursor{qc: qc}
+	if window != nil {
+		qc.SetPointRange(window.startPoint, root.EndPoint())
+		declarations.coveredUntil = window.startByte
+		declarations.started = true
+	}
+	qc.Exec(query, root)
 
-	var chunks []Chunk
-	for {
-		m, ok := qc.NextMatch()
-		if !ok {
-			break
+	b := &chunkBuilder{filePath: filePath, content: content, budget: budget}
+	for first := declarations.next(); first != nil; first = declarations.next() {
+		if window != nil && window.stop(first.StartByte()) {
+			return b.chunks, b.spans, first.StartByte(), true
+		}
+		if estimateTokens(first.EndByte()-first.StartByte()) > budget.MaxTokens {
+			b.split(first, first, -1)
+			continue
 		}
+		// Merge following declarations while one side is small and the
+		// run still fits the budget.
+		last := first
+		for next := declarations.peek(); next != nil; next = declarations.peek() {
+			small := estimateTokens(last.EndByte()-first.StartByte()) < budget.MinTokens ||
+				estimateTokens(next.EndByte()-next.StartByte()) < budget.MinTokens
+			if !small || estimateTokens(next.EndByte()-first.StartByte()) > budget.MaxTokens {
+				break
+			}
+			last = declarations.next()
+		}
+		b.emit(first, last, first, -1)
+	}
+	return b.chunks, b.spans, 0, false
+}
+
+// declarationCursor yields the outermost captured declarations in source
+// order, skipping captures nested in one already yielded.
+type declarationCursor struct {
+	qc           *sitter.QueryCursor
+	coveredUntil uint32
+	started      bool
+	pending      []*sitter.Node
+}
 
+func (d *declarationCursor) peek() *sitter.Node {
+	for len(d.pending) == 0 {
+		m, ok := d.qc.NextMatch()
+		if !ok {
+			return nil
+		}
 		for _, c := range m.Captures {
 			node := c.Node
-			chunks = append(chunks, Chunk{
-				FilePath:  filePath,
-				Content:   node.Content(content),
-				StartLine: int(node.StartPoint().Row + 1),
-				EndLine:   int(node.EndPoint().Row + 1),
-			})
+			if d.started && node.EndByte() <= d.coveredUntil {
+				continue
+			}
+			if d.started && node.StartByte() < d.coveredUntil {
+				// Straddles the start of a window; it belongs to the
+				// chunks before it.
+				continue
+			}
+			d.started = true
+			d.coveredUntil = node.EndByte()
+			d.pending = append(d.pending, node)
 		}
 	}
+	return d.pending[0]
+}
 
-	return chunks, nil
+func (d *declarationCursor) next() *sitter.Node {
+	node := d.peek()
+	if node != nil {
+		d.pending = d.pending[1:]
+	}
+	return node
+}
+
+// chunkBuilder accumulates the chunks of one file.
+type chunkBuilder struct {
+	filePath string
+	content  []byte
+	budget   ChunkBudget
+	chunks   []Chunk
+	spans    []chunkSpan
+}
+
+// emit adds the source from the start of first to the end of last as a
+// chunk taken from anchor, and returns its index.
+func (b *chunkBuilder) emit(first, last, anchor *sitter.Node, parent int) int {
+	b.chunks = append(b.chunks, Chunk{
+		FilePath:  b.filePath,
+		Content:   string(b.content[first.StartByte():last.EndByte()]),
+		StartLine: int(first.StartPoint().Row + 1),
+		EndLine:   int(last.EndPoint().Row + 1),
+		Parent:    parent + 1,
+	})
+	b.spans = append(b.spans, chunkSpan{
+		startByte:        first.StartByte(),
+		endByte:          last.EndByte(),
+		startPoint:       first.StartPoint(),
+		endPoint:         last.EndPoint(),
+		anchorStart:      anchor.StartByte(),
+		anchorEnd:        anchor.EndByte(),
+		anchorStartPoint: anchor.StartPoint(),
+		anchorEndPoint:   anchor.EndPoint(),
+	})
+	return len(b.chunks) - 1
+}
+
+// split breaks an oversized node into runs of consecutive children that fit
+// the budget, recursing into children that are too large on their own. The
+// first run (usually the signature) takes parent; later runs and the pieces
+// of nested children become its children.
+func (b *chunkBuilder) split(node, anchor *sitter.Node, parent int) {
+	count := int(node.ChildCount())
+	if count == 0 {
+		// A single oversized token, such as a long string literal.
+		b.emit(node, node, anchor, parent)
+		return
+	}
+
+	head := -1
+	var runFirst, runLast *sitter.Node
+	flush := func() {
+		if runFirst == nil {
+			return
+		}
+		if head < 0 {
+			head = b.emit(runFirst, runLast, anchor, parent)
+		} else {
+			b.emit(runFirst, runLast, anchor, head)
+		}
+		runFirst = nil
+	}
+	for i := 0; i < count; i++ {
+		child := node.Child(i)
+		if estimateTokens(child.EndByte()-child.StartByte()) > b.budget.MaxTokens {
+			flush()
+			if head < 0 {
+				b.split(child, anchor, parent)
+			} else {
+				b.split(child, anchor, head)
+			}
+			continue
+		}
+		if runFirst != nil && estimateTokens(child.EndByte()-runFirst.StartByte()) > b.budget.MaxTokens {
+			flush()
+		}
+		if runFirst == nil {
+			runFirst = child
+		}
+		runLast = child
+	}
+	flush()
 }
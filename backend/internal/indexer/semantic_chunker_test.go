@@ -0,0 +1,78 @@
+package indexer
+
+import (
+	"strings"
+	"testing"
+)
+
+// TestChunkSourceUsesEachLanguagesGrammar checks that files are chunked at
+// the declarations of the grammar their extension maps to, with nested
+// declarations kept inside the chunk of the one enclosing them.
+func TestChunkSourceUsesEachLanguagesGrammar(t *testing.T) {
+	budget := ChunkBudget{MaxTokens: 200, MinTokens: 1}
+	tests := []struct {
+		path  string
+		decls []string // Separated by two blank lines in the source
+	}{
+		{"model.py", []string{
+			"def origin():\n    return Point(0, 0)",
+			"class Point:\n    def __init__(self, x, y):\n        self.x, self.y = x, y",
+		}},
+		{"STUB.PYI", []string{
+			"def origin() -> Point: ...",
+		}},
+		{"point.ts", []string{
+			"interface Point {\n  x: number;\n}",
+			"function origin(): Point {\n  return { x: 0 };\n}",
+		}},
+		{"point.rs", []string{
+			"struct Point {\n    x: i32,\n}",
+			"impl Point {\n    fn origin() -> Point {\n        Point { x: 0 }\n    }\n}",
+		}},
+		{"point.rb", []string{
+			"def origin\n  Point.new(0, 0)\nend",
+			"def self.unit\n  Point.new(1, 1)\nend",
+		}},
+		{"point.h", []string{
+			"typedef struct {\n  int x;\n} point;",
+			"int origin(void) {\n  return 0;\n}",
+		}},
+	}
+	for _, tt := range tests {
+		t.Run(tt.path, func(t *testing.T) {
+			if languageFor(tt.path) == nil {
+				t.Fatalf("no grammar for %s", tt.path)
+			}
+			source := strings.Join(tt.decls, "\n\n\n") + "\n"
+			chunks, err := ChunkSourceWithTreeSitter(tt.path, []byte(source), budget)
+			if err != nil {
+				t.Fatal(err)
+			}
+			if len(chunks) != len(tt.decls) {
+				t.Fatalf("got %d chunks, want one per declaration: %q", len(chunks), chunks)
+			}
+			line := 1
+			for i, chunk := range chunks {
+				if chunk.Content != tt.decls[i] || chunk.StartLine != line || chunk.FilePath != tt.path {
+					t.Errorf("chunk %d = %q at line %d of %s, want %q at line %d", i, chunk.Content, chunk.StartLine, chunk.FilePath, tt.decls[i], line)
+				}
+				line += strings.Count(tt.decls[i], "\n") + 3
+			}
+		})
+	}
+}
+
+func TestChunkSourceFallsBackToTextWithoutGrammar(t *testing.T) {
+	source := "first line\n\nsecond paragraph\n"
+	chunks, err := ChunkSourceWithTreeSitter("notes.txt", []byte(source), DefaultChunkBudget)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if len(chunks) != 1 || chunks[0].Content != source || chunks[0].StartLine != 1 || chunks[0].EndLine != 3 {
+		t.Fatalf("chunks of a file without a grammar = %q, want the whole text", chunks)
+	}
+
+	if chunks, err := ChunkSourceWithTreeSitter("blob.py", []byte{0xff, 0xfe, 'x'}, DefaultChunkBudget); err != nil || chunks != nil {
+		t.Fatalf("chunks of a non UTF-8 file = %q, %v, want none", chunks, err)
+	}
+}
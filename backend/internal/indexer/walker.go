@@ -0,0 +1,59 @@
+package indexer
+
+import (
+	"autocomplete/backend/internal/log"
+	"io/fs"
+	"os"
+	"path/filepath"
+	"sync"
+)
+
+// SkipFunc reports whether a directory entry should be left out of a walk.
+// Skipped directories are not descended into.
+type SkipFunc func(path string, entry fs.DirEntry) bool
+
+// WalkParallel walks the tree rooted at root, reading up to concurrency
+// directories at once, and sends the path of every regular file that is not
+// skipped to files. It returns once the whole tree has been walked; callers
+// own files and should close it afterwards. Unreadable subdirectories are
+// logged and skipped, while an unreadable root is returned as an error.
+func WalkParallel(root string, concurrency int, skip SkipFunc, files chan<- string) error {
+	rootEntries, err := os.ReadDir(root)
+	if err != nil {
+		return err
+	}
+
+	semaphore := make(chan struct{}, max(concurrency, 1))
+	var wg sync.WaitGroup
+
+	var visit func(dir string, entries []fs.DirEntry)
+	visit = func(dir string, entries []fs.DirEntry) {
+		for _, entry := range entries {
+			path := filepath.Join(dir, entry.Name())
+			if skip(path, entry) {
+				continue
+			}
+			if !entry.IsDir() {
+				files <- path
+				continue
+			}
+
+			wg.Add(1)
+			go func(path string) {
+				defer wg.Done()
+				semaphore <- struct{}{}
+				subEntries, err := os.ReadDir(path)
+				<-semaphore
+				if err != nil {
+					log.ErrorLogger.Printf("⚠️ Could not read directory %s: %v", path, err)
+					return
+				}
+				visit(path, subEntries)
+			}(path)
+		}
+	}
+
+	visit(root, rootEntries)
+	wg.Wait()
+	return nil
+}
@@ -1,63 +1,160 @@
 package indexer
 
 import (
-	"log"
+	"io/fs"
 	"os"
 	"path/filepath"
+	"time"
+
+	"autocomplete/backend/internal/log"
 
 	"github.com/fsnotify/fsnotify"
 )
 
-// Watcher continuously monitors a directory for file changes.
+// Watcher monitors a directory tree and reports changed files in debounced
+// batches. A path is reported once it has been quiet for the debounce
+// interval, so a burst of writes to one file becomes a single change, and
+// every path that settles together (a git checkout, a project-wide replace)
+// is delivered as one batch. Changes that arrive while a batch is being
+// handled are coalesced into the next one.
 type Watcher struct {
-	watcher *fsnotify.Watcher
+	watcher  *fsnotify.Watcher
+	skip     SkipFunc
+	debounce time.Duration
+	done     chan struct{}
 }
 
-// NewWatcher creates and returns a new Watcher.
-func NewWatcher() (*Watcher, error) {
+// NewWatcher creates a Watcher that ignores entries rejected by skip.
+func NewWatcher(skip SkipFunc, debounce time.Duration) (*Watcher, error) {
 	fsnWatcher, err := fsnotify.NewWatcher()
 	if err != nil {
 		return nil, err
 	}
-	return &Watcher{watcher: fsnWatcher}, nil
+	return &Watcher{
+		watcher:  fsnWatcher,
+		skip:     skip,
+		debounce: debounce,
+		done:     make(chan struct{}),
+	}, nil
 }
 
-// Start begins watching the specified root directory.
-func (w *Watcher) Start(root string) (<-chan fsnotify.Event, error) {
-	// Walk the directory and add all subdirectories to the watcher.
-	if err := filepath.Walk(root, func(path string, info os.FileInfo, err error) error {
-		if err != nil {
-			return err
-		}
-		if info.IsDir() {
-			return w.watcher.Add(path)
-		}
-		return nil
-	}); err != nil {
-		return nil, err
+// Start begins watching root and its subdirectories. flush is called from a
+// single goroutine with each batch of settled paths; a path may have been
+// created, modified or removed, so flush should check the file system.
+func (w *Watcher) Start(root string, flush func(paths []string)) error {
+	if err := w.addTree(root, nil); err != nil {
+		return err
 	}
+	log.InfoLogger.Printf("👀 Started watching directory: %s", root)
 
-	log.Printf("👀 Started watching directory: %s", root)
-
-	// Goroutine to handle events and errors
+	batches := make(chan []string)
+	idle := make(chan struct{}, 1)
 	go func() {
-		defer w.watcher.Close()
-		for {
-			select {
-			case event, ok := <-w.watcher.Events:
-				if !ok {
-					return
-				}
-				log.Printf("✨ File event: %s %s", event.Name, event.Op)
-				// Here we would trigger re-indexing for the changed file.
-			case err, ok := <-w.watcher.Errors:
-				if !ok {
-					return
+		for batch := range batches {
+			flush(batch)
+			idle <- struct{}{}
+		}
+	}()
+	go w.run(batches, idle)
+	return nil
+}
+
+// Close stops watching.
+func (w *Watcher) Close() error {
+	close(w.done)
+	return w.watcher.Close()
+}
+
+// run collects events into per-path deadlines and hands settled paths to the
+// flusher whenever it is idle.
+func (w *Watcher) run(batches chan<- []string, idle <-chan struct{}) {
+	defer close(batches)
+	ticker := time.NewTicker(max(w.debounce/2, 10*time.Millisecond))
+	defer ticker.Stop()
+
+	pending := make(map[string]time.Time) // Path → time of its latest event
+	flushing := false
+	for {
+		select {
+		case <-w.done:
+			return
+		case event, ok := <-w.watcher.Events:
+			if !ok {
+				return
+			}
+			if event.Op == fsnotify.Chmod {
+				continue
+			}
+			w.handleEvent(event, pending)
+		case err, ok := <-w.watcher.Errors:
+			if !ok {
+				return
+			}
+			log.ErrorLogger.Printf("🔥 Watcher error: %v", err)
+		case <-idle:
+			flushing = false
+		case now := <-ticker.C:
+			if flushing {
+				continue
+			}
+			var batch []string
+			for path, last := range pending {
+				if now.Sub(last) >= w.debounce {
+					batch = append(batch, path)
+					delete(pending, path)
 				}
-				log.Printf("🔥 Watcher error: %v", err)
+			}
+			if len(batch) > 0 {
+				log.InfoLogger.Printf("✨ %d changed paths settled, updating index", len(batch))
+				flushing = true
+				batches <- batch
 			}
 		}
-	}()
+	}
+}
 
-	return w.watcher.Events, nil
+// handleEvent records a change, watching newly created directories.
+func (w *Watcher) handleEvent(event fsnotify.Event, pending map[string]time.Time) {
+	info, err := os.Lstat(event.Name)
+	if err != nil {
+		// Removed or renamed away; the flusher drops it from the index.
+		pending[event.Name] = time.Now()
+		return
+	}
+	if w.skip(event.Name, fs.FileInfoToDirEntry(info)) {
+		return
+	}
+	if info.IsDir() {
+		if event.Has(fsnotify.Create) {
+			if err := w.addTree(event.Name, pending); err != nil {
+				log.ErrorLogger.Printf("⚠️ Failed to watch new directory %s: %v", event.Name, err)
+			}
+		}
+		return
+	}
+	pending[event.Name] = time.Now()
+}
+
+// addTree watches dir and every directory below it that skip allows. Files
+// found on the way are added to pending when it is non-nil, since they may
+// have been created before their directory was watched.
+func (w *Watcher) addTree(dir string, pending map[string]time.Time) error {
+	return filepath.WalkDir(dir, func(path string, entry fs.DirEntry, err error) error {
+		if err != nil {
+			return err
+		}
+		if path != dir && w.skip(path, entry) {
+			if entry.IsDir() {
+				return filepath.SkipDir
+			}
+			return nil
+		}
+		if entry.IsDir() {
+			return w.watcher.Add(path)
+		}
+		if pending != nil && entry.Type().IsRegular() {
+			pending[path] = time.Now()
+		}
+		return nil
+	})
 }
@@ -9,14 +9,26 @@ package storage
 */
 import "C"
 import (
+	"autocomplete/backend/internal/log"
+	"context"
 	"fmt"
+	"sync"
+	"sync/atomic"
+	"time"
 	"unsafe"
 )
 
-// VectorStore is the interface for a vector store.
+// VectorStore is the interface for a vector store. Add replaces the whole
+// store and assigns ids 0..n-1 in order; Insert and Remove update it in
+// place, and ids of removed vectors may be reused by later inserts. Query
+// returns ids, nearest first; the texts they stand for live in a DocStore.
+// It gives up without searching once ctx is done.
 type VectorStore interface {
-	Add(vectors [][]float32, documents []string) error
-	Query(vector []float32, k int) ([]string, error)
+	Add(vectors [][]float32) error
+	Insert(vectors [][]float32) ([]int, error)
+	Remove(ids []int) error
+	Query(ctx context.Context, vector []float32, k int) ([]int, error)
+	Stats() Stats
 	Close() error
 }
 
@@ -27,77 +39,225 @@ func NewVectorStore(dim int) (VectorStore, error) {
 	}, nil
 }
 
+// NewProfiledVectorStore creates a vector store that counts hardware cache
+// misses for every query (Linux perf events; a no-op elsewhere).
+func NewProfiledVectorStore(dim int) (VectorStore, error) {
+	return &CGoStore{
+		dim:                dim,
+		profileCacheMisses: true,
+	}, nil
+}
+
+// profileLogInterval is how many profiled queries pass between cache-miss
+// log lines; per-query counts are on /metrics.
+const profileLogInterval = 1000
+
 // CGoStore implements the VectorStore interface using CGo.
 type CGoStore struct {
-	index *C.VectorIndex
-	docs  []string
-	dim   int
+	// mu guards index and the C memory below; queries share a read lock
+	// while Add, Insert, Remove and Close take it exclusively. writeMu
+	// serializes those writers, so Add can build a new index without mu
+	// and only take it to swap the new index in.
+	mu      sync.RWMutex
+	writeMu sync.Mutex
+	index   *C.VectorIndex
+	count   int   // Vector slots in use, including removed ones
+	free    []int // Removed ids available for reuse
+	dim     int
+
+	// Cache-miss profiling, enabled via NewProfiledVectorStore. Misses are
+	// logged as an average every profileLogInterval profiled queries.
+	profileCacheMisses bool
+	profiledQueries    atomic.Int64
+
+	// Statistics of indexes that have since been rebuilt or closed.
+	retired Stats
 
 	// Pointers to C-allocated memory that must be manually freed in Close().
+	// cData holds capacity contiguous vectors of dim floats and cVectors the
+	// matching Vector structs, so the brute-force scan stays sequential.
 	cVectors *C.Vector
 	cData    unsafe.Pointer
+	capacity int
 }
 
-// Add adds vectors and their corresponding documents to the store.
+// Add replaces the contents of the store with vectors.
 // It allocates memory on the C heap to avoid passing Go pointers to C.
-func (s *CGoStore) Add(vectors [][]float32, documents []string) error {
-	// If a previous index exists, free its memory before creating a new one.
-	if s.index != nil {
-		s.Close()
+// The new index is built while queries keep searching the old one, which
+// is only locked out for the swap, so rebuilding a large workspace does not
+// stall completions for the length of the build.
+func (s *CGoStore) Add(vectors [][]float32) error {
+	if err := s.checkDimensions(vectors); err != nil {
+		return err
 	}
+	s.writeMu.Lock()
+	defer s.writeMu.Unlock()
 
-	s.docs = documents
-	numVectors := len(vectors)
-	if numVectors == 0 {
-		s.index = nil
-		return nil
+	start := time.Now()
+	next := &CGoStore{dim: s.dim}
+	if numVectors := len(vectors); numVectors > 0 {
+		if err := next.ensureCapacity(numVectors); err != nil {
+			next.freeIndex()
+			return err
+		}
+		for i, v := range vectors {
+			next.copyVector(i, v)
+		}
+		next.count = numVectors
+		next.index = C.create_index(next.cVectors, C.int(numVectors))
+		C.index_record_build(next.index, 0, C.double(time.Since(start).Seconds()))
 	}
-	dim := len(vectors[0])
 
-	floatSize := unsafe.Sizeof(float32(0))
-	vectorStructSize := unsafe.Sizeof(C.Vector{})
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	// Free the previous index, keeping its statistics, and take over the
+	// new one.
+	s.freeIndex()
+	s.index, s.cVectors, s.cData = next.index, next.cVectors, next.cData
+	s.count, s.capacity = next.count, next.capacity
+	s.free = nil
+	return nil
+}
+
+// Insert adds vectors to the existing index without rebuilding it and
+// returns the id assigned to each.
+func (s *CGoStore) Insert(vectors [][]float32) ([]int, error) {
+	s.writeMu.Lock()
+	defer s.writeMu.Unlock()
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	if len(vectors) == 0 {
+		return nil, nil
+	}
+	if err := s.checkDimensions(vectors); err != nil {
+		return nil, err
+	}
+	start := time.Now()
+	appended := max(0, len(vectors)-len(s.free))
+	if err := s.ensureCapacity(s.count + appended); err != nil {
+		return nil, err
+	}
+
+	ids := make([]int, len(vectors))
+	for i, v := range vectors {
+		var id int
+		if n := len(s.free); n > 0 {
+			id = s.free[n-1]
+			s.free = s.free[:n-1]
+		} else {
+			id = s.count
+			s.count++
+		}
+		s.copyVector(id, v)
+		ids[i] = id
+	}
 
-	// Allocate one contiguous block on the C heap for all vector float data.
-	totalDataSize := numVectors * dim * int(floatSize)
-	cData := C.malloc(C.size_t(totalDataSize))
+	if s.index == nil {
+		s.index = C.create_index(s.cVectors, C.int(s.count))
+		C.index_record_build(s.index, 0, C.double(time.Since(start).Seconds()))
+		return ids, nil
+	}
+	if C.index_resize(s.index, s.cVectors, C.int(s.count)) != 0 {
+		return nil, fmt.Errorf("failed to grow vector index")
+	}
+	for _, id := range ids {
+		C.index_set_deleted(s.index, C.int(id), 0)
+	}
+	C.index_record_build(s.index, C.longlong(len(ids)), C.double(time.Since(start).Seconds()))
+	return ids, nil
+}
+
+// Remove deletes vectors by id; searches skip them from now on.
+func (s *CGoStore) Remove(ids []int) error {
+	s.writeMu.Lock()
+	defer s.writeMu.Unlock()
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	for _, id := range ids {
+		if s.index == nil || id < 0 || id >= s.count {
+			return fmt.Errorf("vector id %d is not in the index", id)
+		}
+		if C.index_set_deleted(s.index, C.int(id), 1) != 0 {
+			return fmt.Errorf("failed to remove vector %d", id)
+		}
+		s.free = append(s.free, id)
+	}
+	return nil
+}
+
+func (s *CGoStore) checkDimensions(vectors [][]float32) error {
+	for _, v := range vectors {
+		if len(v) != s.dim {
+			return fmt.Errorf("vector has %d dimensions, store expects %d", len(v), s.dim)
+		}
+	}
+	return nil
+}
+
+// ensureCapacity grows the C vector storage to hold at least n vectors,
+// re-pointing existing Vector structs if the data block moved. The caller
+// must hold mu exclusively and update the index with the new cVectors.
+func (s *CGoStore) ensureCapacity(n int) error {
+	if n <= s.capacity {
+		return nil
+	}
+	capacity := max(n, 2*s.capacity, 64)
+	floatSize := int(unsafe.Sizeof(float32(0)))
+	vectorStructSize := int(unsafe.Sizeof(C.Vector{}))
+
+	cData := C.realloc(s.cData, C.size_t(capacity*s.dim*floatSize))
 	if cData == nil {
 		return fmt.Errorf("failed to allocate memory for vector data")
 	}
+	s.cData = cData
+	for i := 0; i < s.count; i++ {
+		s.vectorSlot(i).data = (*C.float)(unsafe.Add(s.cData, i*s.dim*floatSize))
+	}
 
-	// Allocate memory on the C heap for the array of C.Vector structs.
-	cVectorsArraySize := numVectors * int(vectorStructSize)
-	cVectors := (*C.Vector)(C.malloc(C.size_t(cVectorsArraySize)))
+	cVectors := (*C.Vector)(C.realloc(unsafe.Pointer(s.cVectors), C.size_t(capacity*vectorStructSize)))
 	if cVectors == nil {
-		C.free(cData) // Clean up previous allocation
 		return fmt.Errorf("failed to allocate memory for vector structs")
 	}
-
-	// Store pointers in the struct so they can be freed later in Close().
-	s.cData = cData
 	s.cVectors = cVectors
+	s.capacity = capacity
+	return nil
+}
 
-	// Create a Go slice header for the C-allocated vector structs to allow easy access.
-	cVectorsSlice := (*[1 << 30]C.Vector)(unsafe.Pointer(cVectors))[:numVectors:numVectors]
-
-	var currentOffset uintptr
-	for i, v := range vectors {
-		destination := unsafe.Pointer(uintptr(cData) + currentOffset)
-		bytesToCopy := len(v) * int(floatSize)
-		C.memcpy(destination, unsafe.Pointer(&v[0]), C.size_t(bytesToCopy))
-		cVectorsSlice[i].data = (*C.float)(destination)
-		cVectorsSlice[i].len = C.int(len(v))
-		currentOffset += uintptr(bytesToCopy)
-	}
+// copyVector copies v into slot id of the C storage.
+func (s *CGoStore) copyVector(id int, v []float32) {
+	floatSize := int(unsafe.Sizeof(float32(0)))
+	destination := unsafe.Add(s.cData, id*s.dim*floatSize)
+	C.memcpy(destination, unsafe.Pointer(&v[0]), C.size_t(len(v)*floatSize))
+	slot := s.vectorSlot(id)
+	slot.data = (*C.float)(destination)
+	slot.len = C.int(len(v))
+}
 
-	s.index = C.create_index(cVectors, C.int(numVectors))
-	return nil
+func (s *CGoStore) vectorSlot(id int) *C.Vector {
+	return (*C.Vector)(unsafe.Add(unsafe.Pointer(s.cVectors), id*int(unsafe.Sizeof(C.Vector{}))))
 }
 
-// Query queries the store for the k most similar documents.
-func (s *CGoStore) Query(vector []float32, k int) ([]string, error) {
+// Query returns the ids of the k vectors most similar to vector. The search
+// itself cannot be interrupted, so ctx is checked before it starts,
+// including after waiting out a concurrent rebuild.
+func (s *CGoStore) Query(ctx context.Context, vector []float32, k int) ([]int, error) {
+	if err := ctx.Err(); err != nil {
+		return nil, err
+	}
+	s.mu.RLock()
+	defer s.mu.RUnlock()
+	if err := ctx.Err(); err != nil {
+		return nil, err
+	}
+
 	if s.index == nil {
 		return nil, fmt.Errorf("index is not initialized")
 	}
+	if live := s.count - len(s.free); k > live {
+		k = live
+	}
 
 	floatSize := unsafe.Sizeof(float32(0))
 	queryDataSize := len(vector) * int(floatSize)
@@ -116,20 +276,45 @@ func (s *CGoStore) Query(vector []float32, k int) ([]string, error) {
 		len:  C.int(len(vector)),
 	}
 
-	cNeighbors := C.knn_search(s.index, &cQuery, C.int(k))
+	var cStats C.SearchStats
+	var cNeighbors *C.int
+	if s.profileCacheMisses {
+		cNeighbors = C.knn_search_profiled(s.index, &cQuery, C.int(k), &cStats)
+		if cStats.cache_misses >= 0 && s.profiledQueries.Add(1)%profileLogInterval == 0 {
+			stats := s.retired.merge(s.indexStats())
+			log.InfoLogger.Printf("🔬 knn_search cache misses: %d per query on average over %d profiled queries",
+				stats.CacheMisses/max(stats.ProfiledQueries, 1), stats.ProfiledQueries)
+		}
+	} else {
+		cNeighbors = C.knn_search_with_stats(s.index, &cQuery, C.int(k), &cStats)
+	}
 	defer C.free(unsafe.Pointer(cNeighbors))
 
 	neighbors := (*[1 << 30]C.int)(unsafe.Pointer(cNeighbors))[:k:k]
-	results := make([]string, k)
-	for i := 0; i < k; i++ {
-		results[i] = s.docs[neighbors[i]]
+	results := make([]int, 0, k)
+	for _, id := range neighbors {
+		if id >= 0 {
+			results = append(results, int(id))
+		}
 	}
 	return results, nil
 }
 
 // Close frees all C-allocated memory associated with the CGoStore.
 func (s *CGoStore) Close() error {
+	s.writeMu.Lock()
+	defer s.writeMu.Unlock()
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	s.freeIndex()
+	return nil
+}
+
+// freeIndex releases the current index and its C memory, keeping its
+// statistics. The caller must hold mu exclusively.
+func (s *CGoStore) freeIndex() {
 	if s.index != nil {
+		s.retired = s.retired.merge(s.indexStats())
 		C.free_index(s.index)
 		s.index = nil
 	}
@@ -141,5 +326,5 @@ func (s *CGoStore) Close() error {
 		C.free(s.cData)
 		s.cData = nil
 	}
-	return nil
+	s.capacity = 0
 }
@@ -0,0 +1,278 @@
+package storage
+
+import (
+	"fmt"
+	"io"
+	"os"
+	"sync"
+
+	"autocomplete/backend/internal/log"
+)
+
+// DocStore holds the text of indexed chunks outside the Go heap. Texts are
+// appended to a scratch file in the cache directory that is memory-mapped
+// for reading, and an offset table maps each vector id to its span, so a
+// query reads only the text of the neighbours it returns.
+type DocStore struct {
+	// mu guards everything below; Get shares a read lock, while Put, Delete,
+	// compaction and Close take it exclusively.
+	mu     sync.RWMutex
+	dir    string
+	path   string // Non-empty while the file still has a name to remove
+	file   *os.File
+	spans  []docSpan // Indexed by vector id; zero for absent ids
+	size   int64     // Bytes written to the file
+	dead   int64     // Bytes of deleted or replaced texts
+	mapped []byte    // Read-only mapping of the first len(mapped) bytes
+
+	// A store closed while readers hold it through Acquire stays readable
+	// until the last one releases it.
+	readers int
+	closing bool // Close was called; no new readers or texts
+	closed  bool // The file and mapping are released
+}
+
+// docSpan locates a text in the file. A zero length marks an absent id.
+type docSpan struct {
+	offset int64
+	length uint32
+}
+
+const (
+	// The mapping is extended once this much has been appended past it;
+	// newer texts are read with pread until then.
+	minRemapBytes = 1 << 20
+	// Compaction waits until dead text is at least this large and
+	// outweighs live text.
+	minDocCompactionBytes = 32 << 20
+)
+
+// NewDocStore creates an empty document store backed by a scratch file in
+// dir. The file is unlinked right away where the platform allows it, so
+// nothing is left behind after a crash.
+func NewDocStore(dir string) (*DocStore, error) {
+	d := &DocStore{dir: dir}
+	file, path, err := d.createFile()
+	if err != nil {
+		return nil, err
+	}
+	d.file, d.path = file, path
+	return d, nil
+}
+
+func (d *DocStore) createFile() (*os.File, string, error) {
+	file, err := os.CreateTemp(d.dir, "documents-*.blob")
+	if err != nil {
+		return nil, "", fmt.Errorf("failed to create document store: %w", err)
+	}
+	path := file.Name()
+	if os.Remove(path) == nil {
+		path = ""
+	}
+	return file, path, nil
+}
+
+// Put stores texts under the given vector ids, replacing any previous text,
+// with a single write.
+func (d *DocStore) Put(ids []int, texts []string) error {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	if d.closing {
+		return fmt.Errorf("document store is closed")
+	}
+
+	total := 0
+	for _, text := range texts {
+		total += len(text)
+	}
+	buf := make([]byte, 0, total)
+	offset := d.size
+	for i, id := range ids {
+		for id >= len(d.spans) {
+			d.spans = append(d.spans, docSpan{})
+		}
+		d.dead += int64(d.spans[id].length)
+		d.spans[id] = docSpan{offset: offset + int64(len(buf)), length: uint32(len(texts[i]))}
+		buf = append(buf, texts[i]...)
+	}
+	if _, err := d.file.WriteAt(buf, offset); err != nil {
+		return fmt.Errorf("failed to write documents: %w", err)
+	}
+	d.size += int64(len(buf))
+
+	if d.dead > minDocCompactionBytes && d.dead > d.size-d.dead {
+		return d.compact()
+	}
+	if d.size-int64(len(d.mapped)) >= max(minRemapBytes, int64(len(d.mapped))) {
+		d.remap()
+	}
+	return nil
+}
+
+// Get returns the text stored under id, or "" if there is none. The text is
+// copied out of the mapping.
+func (d *DocStore) Get(id int) (string, error) {
+	d.mu.RLock()
+	defer d.mu.RUnlock()
+	if d.closed {
+		return "", fmt.Errorf("document store is closed")
+	}
+	if id < 0 || id >= len(d.spans) || d.spans[id].length == 0 {
+		return "", nil
+	}
+
+	span := d.spans[id]
+	end := span.offset + int64(span.length)
+	if end <= int64(len(d.mapped)) {
+		return string(d.mapped[span.offset:end]), nil
+	}
+	buf := make([]byte, span.length)
+	if _, err := d.file.ReadAt(buf, span.offset); err != nil && err != io.EOF {
+		return "", fmt.Errorf("failed to read document %d: %w", id, err)
+	}
+	return string(buf), nil
+}
+
+// Delete drops the texts stored under ids.
+func (d *DocStore) Delete(ids []int) {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	for _, id := range ids {
+		if id >= 0 && id < len(d.spans) {
+			d.dead += int64(d.spans[id].length)
+			d.spans[id] = docSpan{}
+		}
+	}
+}
+
+// Bytes returns the size of the live texts.
+func (d *DocStore) Bytes() int64 {
+	d.mu.RLock()
+	defer d.mu.RUnlock()
+	return d.size - d.dead
+}
+
+// remap maps the whole file, falling back to pread for everything if the
+// platform cannot map it. The caller must hold mu exclusively.
+func (d *DocStore) remap() {
+	if d.mapped != nil {
+		unmapFile(d.mapped)
+		d.mapped = nil
+	}
+	if d.size == 0 {
+		return
+	}
+	mapped, err := mapFile(d.file, d.size)
+	if err != nil {
+		log.ErrorLogger.Printf("⚠️ Could not map document store, reading from file: %v", err)
+		return
+	}
+	d.mapped = mapped
+}
+
+// compact copies the live texts to a fresh file. The caller must hold mu
+// exclusively.
+func (d *DocStore) compact() error {
+	file, path, err := d.createFile()
+	if err != nil {
+		return err
+	}
+
+	var buf []byte
+	var size int64
+	spans := make([]docSpan, len(d.spans))
+	for id, span := range d.spans {
+		if span.length == 0 {
+			continue
+		}
+		text := make([]byte, span.length)
+		if _, err := d.file.ReadAt(text, span.offset); err != nil && err != io.EOF {
+			file.Close()
+			return fmt.Errorf("failed to compact document store: %w", err)
+		}
+		spans[id] = docSpan{offset: size + int64(len(buf)), length: span.length}
+		buf = append(buf, text...)
+		if len(buf) >= minRemapBytes {
+			if _, err := file.WriteAt(buf, size); err != nil {
+				file.Close()
+				return fmt.Errorf("failed to compact document store: %w", err)
+			}
+			size += int64(len(buf))
+			buf = buf[:0]
+		}
+	}
+	if _, err := file.WriteAt(buf, size); err != nil {
+		file.Close()
+		return fmt.Errorf("failed to compact document store: %w", err)
+	}
+	size += int64(len(buf))
+
+	log.InfoLogger.Printf("🧹 Compacted document store from %d to %d bytes", d.size, size)
+	d.closeFile()
+	d.file, d.path = file, path
+	d.spans = spans
+	d.size = size
+	d.dead = 0
+	d.remap()
+	return nil
+}
+
+// Acquire keeps the store readable for the caller until it calls Release,
+// even if the store is closed meanwhile. It reports false if the store is
+// already closed.
+func (d *DocStore) Acquire() bool {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	if d.closing {
+		return false
+	}
+	d.readers++
+	return true
+}
+
+// Release ends a read started by Acquire, releasing the store if it was
+// closed meanwhile and this was the last reader.
+func (d *DocStore) Release() {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	d.readers--
+	if d.closing && d.readers == 0 {
+		if err := d.release(); err != nil {
+			log.ErrorLogger.Printf("⚠️ Failed to close document store: %v", err)
+		}
+	}
+}
+
+// Close releases the mapping and removes the file, once readers that
+// acquired the store have released it.
+func (d *DocStore) Close() error {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+	if d.closing {
+		return nil
+	}
+	d.closing = true
+	if d.readers > 0 {
+		return nil
+	}
+	return d.release()
+}
+
+// release frees the file and mapping. The caller must hold mu exclusively.
+func (d *DocStore) release() error {
+	d.closed = true
+	d.spans = nil
+	return d.closeFile()
+}
+
+func (d *DocStore) closeFile() error {
+	if d.mapped != nil {
+		unmapFile(d.mapped)
+		d.mapped = nil
+	}
+	err := d.file.Close()
+	if d.path != "" {
+		os.Remove(d.path)
+	}
+	return err
+}
@@ -0,0 +1,34 @@
+package storage
+
+import "testing"
+
+func TestDocStoreStaysReadableUntilReadersRelease(t *testing.T) {
+	d, err := NewDocStore(t.TempDir())
+	if err != nil {
+		t.Fatal(err)
+	}
+	if err := d.Put([]int{0, 2}, []string{"zero", "two"}); err != nil {
+		t.Fatal(err)
+	}
+	if !d.Acquire() {
+		t.Fatal("Acquire on an open store failed")
+	}
+	if err := d.Close(); err != nil {
+		t.Fatal(err)
+	}
+
+	if text, err := d.Get(2); err != nil || text != "two" {
+		t.Fatalf("Get(2) by a reader after Close = %q, %v", text, err)
+	}
+	if d.Acquire() {
+		t.Fatal("Acquire after Close succeeded")
+	}
+	if err := d.Put([]int{1}, []string{"one"}); err == nil {
+		t.Fatal("Put after Close succeeded")
+	}
+
+	d.Release()
+	if _, err := d.Get(0); err == nil {
+		t.Fatal("Get after the last reader released a closed store succeeded")
+	}
+}
@@ -0,0 +1,15 @@
+//go:build !unix
+
+package storage
+
+import (
+	"errors"
+	"os"
+)
+
+// mapFile is unsupported here; the document store reads with pread instead.
+func mapFile(file *os.File, size int64) ([]byte, error) {
+	return nil, errors.New("memory mapping is not supported on this platform")
+}
+
+func unmapFile(mapped []byte) {}
@@ -0,0 +1,105 @@
+package storage
+
+/*
+#include "vector_search.h"
+*/
+import "C"
+
+// Stats summarizes the work done by the vector search library. Search
+// counters are totals over all queries since the store was created, while
+// Vectors and the build figures describe the current index, including
+// incremental inserts. Hops, HeapOperations and LayersDescended are only
+// produced by HNSW indexes, which the store does not build.
+type Stats struct {
+	Vectors              int     `json:"vectors"`
+	Queries              int64   `json:"queries"`
+	DistanceComputations int64   `json:"distance_computations"`
+	Hops                 int64   `json:"hops"`
+	VisitedNodes         int64   `json:"visited_nodes"`
+	HeapOperations       int64   `json:"heap_operations"`
+	LayersDescended      int64   `json:"layers_descended"`
+	ProfiledQueries      int64   `json:"profiled_queries"`
+	CacheMisses          int64   `json:"cache_misses"`
+	BuildInserts         int64   `json:"build_inserts"`
+	BuildSeconds         float64 `json:"build_seconds"`
+}
+
+// BuildInsertsPerSecond returns the insert throughput of the current index,
+// or 0 when its inserts were too fast to measure.
+func (st Stats) BuildInsertsPerSecond() float64 {
+	if st.BuildSeconds <= 0 {
+		return 0
+	}
+	return float64(st.BuildInserts) / st.BuildSeconds
+}
+
+// SumStats adds up the statistics of several stores, such as the stores of
+// all workspaces served by one process.
+func SumStats(stats ...Stats) Stats {
+	var sum Stats
+	for _, st := range stats {
+		sum.Vectors += st.Vectors
+		sum.Queries += st.Queries
+		sum.DistanceComputations += st.DistanceComputations
+		sum.Hops += st.Hops
+		sum.VisitedNodes += st.VisitedNodes
+		sum.HeapOperations += st.HeapOperations
+		sum.LayersDescended += st.LayersDescended
+		sum.ProfiledQueries += st.ProfiledQueries
+		sum.CacheMisses += st.CacheMisses
+		sum.BuildInserts += st.BuildInserts
+		sum.BuildSeconds += st.BuildSeconds
+	}
+	return sum
+}
+
+// merge adds the search counters of other to st and takes the index
+// description (vector count, build figures) from other.
+func (st Stats) merge(other Stats) Stats {
+	return Stats{
+		Vectors:              other.Vectors,
+		Queries:              st.Queries + other.Queries,
+		DistanceComputations: st.DistanceComputations + other.DistanceComputations,
+		Hops:                 st.Hops + other.Hops,
+		VisitedNodes:         st.VisitedNodes + other.VisitedNodes,
+		HeapOperations:       st.HeapOperations + other.HeapOperations,
+		LayersDescended:      st.LayersDescended + other.LayersDescended,
+		ProfiledQueries:      st.ProfiledQueries + other.ProfiledQueries,
+		CacheMisses:          st.CacheMisses + other.CacheMisses,
+		BuildInserts:         other.BuildInserts,
+		BuildSeconds:         other.BuildSeconds,
+	}
+}
+
+// Stats returns the aggregated search statistics of the store.
+func (s *CGoStore) Stats() Stats {
+	s.mu.RLock()
+	defer s.mu.RUnlock()
+
+	if s.index == nil {
+		retired := s.retired
+		retired.Vectors = 0
+		return retired
+	}
+	return s.retired.merge(s.indexStats())
+}
+
+// indexStats reads the statistics aggregated by the current C index.
+// The caller must hold mu.
+func (s *CGoStore) indexStats() Stats {
+	var cStats C.IndexStats
+	C.get_index_stats(s.index, &cStats)
+	return Stats{
+		Vectors:              int(s.index.len - s.index.deleted_count),
+		Queries:              int64(cStats.query_count),
+		DistanceComputations: int64(cStats.totals.distance_computations),
+		Hops:                 int64(cStats.totals.hops),
+		VisitedNodes:         int64(cStats.totals.visited_nodes),
+		HeapOperations:       int64(cStats.totals.heap_operations),
+		LayersDescended:      int64(cStats.totals.layers_descended),
+		ProfiledQueries:      int64(cStats.profiled_query_count),
+		CacheMisses:          int64(cStats.totals.cache_misses),
+		BuildInserts:         int64(cStats.build_inserts),
+		BuildSeconds:         float64(cStats.build_seconds),
+	}
+}
@@ -1,3 +1,7 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // Exposes syscall() for perf_event_open under -std=c99
+#endif
+
 #include "vector_search.h"
 #include <stdlib.h>
 #include <math.h>
@@ -6,6 +10,67 @@
 #include <time.h>
 #include <limits.h>
 
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// ================================
+// MEMORY PREFETCHING
+// ================================
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH_READ(address) __builtin_prefetch((address), 0, 1)
+#else
+#define PREFETCH_READ(address) ((void)(address))
+#endif
+
+#define CACHE_LINE_BYTES 64
+#define PREFETCH_VECTOR_BYTES 256 // Leading lines; the hardware prefetcher streams the rest
+
+// Issues prefetches for the leading cache lines of a vector's data so the
+// distance computation does not stall on the first loads.
+static void prefetch_vector_data(const Vector* vector) {
+    const char* data = (const char*)vector->data;
+    size_t total_bytes = (size_t)vector->len * sizeof(float);
+    size_t prefetch_bytes = total_bytes < PREFETCH_VECTOR_BYTES ? total_bytes : PREFETCH_VECTOR_BYTES;
+    for (size_t offset = 0; offset < prefetch_bytes; offset += CACHE_LINE_BYTES) {
+        PREFETCH_READ(data + offset);
+    }
+}
+
+// ================================
+// SEARCH STATISTICS
+// ================================
+
+// Counting is skipped entirely when the caller passes NULL stats
+#define STATS_ADD(stats, field, amount) \
+    do { if (stats) { (stats)->field += (amount); } } while (0)
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ATOMIC_ADD(target, amount) __atomic_fetch_add((target), (amount), __ATOMIC_RELAXED)
+#else
+#define ATOMIC_ADD(target, amount) (*(target) += (amount))
+#endif
+
+static void accumulate_search_stats(VectorIndex* index, const SearchStats* stats) {
+    IndexStats* totals = &index->stats;
+    ATOMIC_ADD(&totals->totals.distance_computations, stats->distance_computations);
+    ATOMIC_ADD(&totals->totals.hops, stats->hops);
+    ATOMIC_ADD(&totals->totals.visited_nodes, stats->visited_nodes);
+    ATOMIC_ADD(&totals->totals.heap_operations, stats->heap_operations);
+    ATOMIC_ADD(&totals->totals.layers_descended, stats->layers_descended);
+    ATOMIC_ADD(&totals->query_count, 1LL);
+    if (stats->cache_misses >= 0) {
+        ATOMIC_ADD(&totals->totals.cache_misses, stats->cache_misses);
+        ATOMIC_ADD(&totals->profiled_query_count, 1LL);
+    }
+}
+
 // ================================
 // UTILITY FUNCTIONS
 // ================================
@@ -392,7 +457,7 @@ HNSWGraph* build_hnsw_graph(Vector* vectors, int vector_count, int max_connectio
 // ================================
 
 int* search_layer(HNSWGraph* graph, Vector* query, int entry_point, int layer, 
-                  int search_width, int* result_count) {
+                  int search_width, int* result_count, SearchStats* stats) {
     PriorityQueue* candidates = create_priority_queue(search_width, 0); // min-heap for closest
     PriorityQueue* visited = create_priority_queue(search_width * 2, 1); // max-heap for worst
     int* visited_flags = (int*)calloc(graph->node_count, sizeof(int));
@@ -401,35 +466,59 @@ int* search_layer(HNSWGraph* graph, Vector* query, int entry_point, int layer,
     insert_candidate(candidates, entry_point, entry_distance);
     insert_candidate(visited, entry_point, entry_distance);
     visited_flags[entry_point] = 1;
+    STATS_ADD(stats, distance_computations, 1);
+    STATS_ADD(stats, heap_operations, 2);
+    STATS_ADD(stats, visited_nodes, 1);
     
     while (candidates->size > 0) {
         SearchCandidate current = extract_top_candidate(candidates);
+        STATS_ADD(stats, heap_operations, 1);
         
         // Early termination if current distance is worse than worst in visited set
         if (visited->size >= search_width && current.distance > visited->candidates[0].distance) {
             break;
         }
+        STATS_ADD(stats, hops, 1);
         
         // Explore neighbors
         HNSWNode* current_node = &graph->nodes[current.node_id];
         if (layer <= current_node->maximum_layer) {
+            int* neighbor_ids = current_node->layer_connections[layer];
+            int neighbor_count = current_node->connection_counts[layer];
+            
+            // Warm the first neighbor before entering the loop
+            if (neighbor_count > 0) {
+                PREFETCH_READ(&visited_flags[neighbor_ids[0]]);
+                prefetch_vector_data(&graph->original_vectors[neighbor_ids[0]]);
+            }
+            
             for (int neighbor_index = 0; 
-                 neighbor_index < current_node->connection_counts[layer]; 
+                 neighbor_index < neighbor_count; 
                  neighbor_index++) {
                 
-                int neighbor_id = current_node->layer_connections[layer][neighbor_index];
+                int neighbor_id = neighbor_ids[neighbor_index];
+                
+                // Overlap the next neighbor's memory loads with this distance computation
+                if (neighbor_index + 1 < neighbor_count) {
+                    int next_neighbor_id = neighbor_ids[neighbor_index + 1];
+                    PREFETCH_READ(&visited_flags[next_neighbor_id]);
+                    prefetch_vector_data(&graph->original_vectors[next_neighbor_id]);
+                }
                 
                 if (!visited_flags[neighbor_id]) {
                     visited_flags[neighbor_id] = 1;
                     float neighbor_distance = calculate_euclidean_distance(
                         query, &graph->original_vectors[neighbor_id]
                     );
+                    STATS_ADD(stats, visited_nodes, 1);
+                    STATS_ADD(stats, distance_computations, 1);
                     
                     if (visited->size < search_width || 
                         neighbor_distance < visited->candidates[0].distance) {
                         
                         insert_candidate(candidates, neighbor_id, neighbor_distance);
                         insert_candidate(visited, neighbor_id, neighbor_distance);
+                        STATS_ADD(stats, heap_operations, 2);
                     }
                 }
             }
@@ -445,6 +534,7 @@ int* search_layer(HNSWGraph* graph, Vector* query, int entry_point, int layer,
         SearchCandidate result = extract_top_candidate(visited);
         results[result_index] = result.node_id;
     }
+    STATS_ADD(stats, heap_operations, *result_count);
     
     free_priority_queue(candidates);
     free_priority_queue(visited);
@@ -453,7 +543,8 @@ int* search_layer(HNSWGraph* graph, Vector* query, int entry_point, int layer,
     return results;
 }
 
-int* hnsw_knn_search(VectorIndex* index, Vector* query, int k, SearchConfig* search_config) {
+static int* hnsw_search_with_stats(VectorIndex* index, Vector* query, int k,
+                                   SearchConfig* search_config, SearchStats* stats) {
     if (!index->hnsw_graph) {
         return NULL; // No HNSW graph available
     }
@@ -467,16 +558,17 @@ int* hnsw_knn_search(VectorIndex* index, Vector* query, int k, SearchConfig* sea
     // Greedy search from top layer down to layer 1
     for (int layer = graph->maximum_layer_in_graph; layer > 0; layer--) {
         int result_count;
-        int* layer_results = search_layer(graph, query, current_closest, layer, 1, &result_count);
+        int* layer_results = search_layer(graph, query, current_closest, layer, 1, &result_count, stats);
         if (result_count > 0) {
             current_closest = layer_results[0];
         }
         free(layer_results);
+        STATS_ADD(stats, layers_descended, 1);
     }
     
     // Comprehensive search at layer 0
     int result_count;
-    int* all_candidates = search_layer(graph, query, current_closest, 0, search_width, &result_count);
+    int* all_candidates = search_layer(graph, query, current_closest, 0, search_width, &result_count, stats);
     
     // Return top k results
     int return_count = (result_count < k) ? result_count : k;
@@ -487,6 +579,10 @@ int* hnsw_knn_search(VectorIndex* index, Vector* query, int k, SearchConfig* sea
     return final_results;
 }
 
+int* hnsw_knn_search(VectorIndex* index, Vector* query, int k, SearchConfig* search_config) {
+    return hnsw_search_with_stats(index, query, k, search_config, NULL);
+}
+
 int* approximate_search(VectorIndex* index, Vector* query, int k, int search_width) {
     SearchConfig config = {
         .search_width = search_width,
@@ -511,7 +607,7 @@ int* beam_search(VectorIndex* index, Vector* query, int k, int beam_width) {
 // TRADITIONAL BRUTE-FORCE SEARCH
 // ================================
 
-int* knn_search(VectorIndex* index, Vector* query, int k) {
+static int* knn_search_internal(VectorIndex* index, Vector* query, int k, SearchStats* stats) {
     // Use HNSW if available
     if (index->use_hnsw_optimization && index->hnsw_graph) {
         SearchConfig default_config = {
@@ -520,8 +616,11 @@ int* knn_search(VectorIndex* index, Vector* query, int k) {
             .accuracy_threshold = 1.0f,
             .use_approximate_search = 0
         };
-        return hnsw_knn_search(index, query, k, &default_config);
+        return hnsw_search_with_stats(index, query, k, &default_config, stats);
     }
+    int live_count = index->len - index->deleted_count;
+    STATS_ADD(stats, distance_computations, live_count);
+    STATS_ADD(stats, visited_nodes, live_count);
     
     // Fallback to brute-force search
     int* neighbors = (int*)malloc(sizeof(int) * k);
@@ -533,6 +632,9 @@ int* knn_search(VectorIndex* index, Vector* query, int k) {
     }
 
     for (int vector_index = 0; vector_index < index->len; vector_index++) {
+        if (index->deleted && index->deleted[vector_index]) {
+            continue;
+        }
         float current_distance = calculate_euclidean_distance(query, &index->vectors[vector_index]);
 
         for (int insertion_position = 0; insertion_position < k; insertion_position++) {
@@ -553,6 +655,166 @@ int* knn_search(VectorIndex* index, Vector* query, int k) {
     return neighbors;
 }
 
+int* knn_search(VectorIndex* index, Vector* query, int k) {
+    return knn_search_internal(index, query, k, NULL);
+}
+
+int* knn_search_with_stats(VectorIndex* index, Vector* query, int k, SearchStats* stats) {
+    if (!stats) {
+        return knn_search_internal(index, query, k, NULL);
+    }
+    
+    memset(stats, 0, sizeof(SearchStats));
+    stats->cache_misses = -1;
+    int* neighbors = knn_search_internal(index, query, k, stats);
+    accumulate_search_stats(index, stats);
+    return neighbors;
+}
+
+void get_index_stats(VectorIndex* index, IndexStats* stats) {
+    *stats = index->stats;
+}
+
+void index_record_build(VectorIndex* index, long long inserts, double seconds) {
+    index->stats.build_inserts += inserts;
+    index->stats.build_seconds += seconds;
+}
+
+int index_resize(VectorIndex* index, Vector* vectors, int len) {
+    if (index->hnsw_graph || len < index->len) {
+        return -1;
+    }
+    if (index->deleted && len > index->len) {
+        unsigned char* deleted = (unsigned char*)realloc(index->deleted, len);
+        if (!deleted) {
+            return -1;
+        }
+        memset(deleted + index->len, 0, len - index->len);
+        index->deleted = deleted;
+    }
+    index->vectors = vectors;
+    index->len = len;
+    return 0;
+}
+
+int index_set_deleted(VectorIndex* index, int id, int deleted) {
+    if (index->hnsw_graph || id < 0 || id >= index->len) {
+        return -1;
+    }
+    if (!index->deleted) {
+        if (!deleted) {
+            return 0;
+        }
+        index->deleted = (unsigned char*)calloc(index->len, 1);
+        if (!index->deleted) {
+            return -1;
+        }
+    }
+    unsigned char flag = deleted ? 1 : 0;
+    if (index->deleted[id] != flag) {
+        index->deleted_count += flag ? 1 : -1;
+        index->deleted[id] = flag;
+    }
+    return 0;
+}
+
+// ================================
+// CACHE-MISS PROFILING
+// ================================
+
+#ifdef __linux__
+// Opens a disabled per-thread hardware cache-miss counter, or returns -1 when
+// perf events are unavailable (e.g. perf_event_paranoid, containers, VMs).
+static int open_cache_miss_counter(void) {
+    struct perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.size = sizeof(attributes);
+    attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    
+    long file_descriptor = syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+    return (int)file_descriptor;
+}
+
+// Each thread opens its counter on first use and keeps it, so profiled
+// queries do not pay for a perf_event_open and close every time. The counter
+// is held in thread-specific data, whose destructor closes it when the thread
+// exits. The value stored is fd + 2: NULL means not opened yet on this
+// thread, 1 that counters are unavailable.
+static pthread_key_t cache_miss_counter_key;
+static pthread_once_t cache_miss_counter_once = PTHREAD_ONCE_INIT;
+static int cache_miss_counter_key_ready = 0;
+
+static void close_cache_miss_counter(void* value) {
+    int counter_fd = (int)((intptr_t)value - 2);
+    if (counter_fd >= 0) {
+        close(counter_fd);
+    }
+}
+
+static void create_cache_miss_counter_key(void) {
+    cache_miss_counter_key_ready = pthread_key_create(&cache_miss_counter_key, close_cache_miss_counter) == 0;
+}
+
+// Returns the calling thread's counter, or -1 when perf events are
+// unavailable.
+static int thread_cache_miss_counter(void) {
+    pthread_once(&cache_miss_counter_once, create_cache_miss_counter_key);
+    if (!cache_miss_counter_key_ready) {
+        return -1;
+    }
+    void* value = pthread_getspecific(cache_miss_counter_key);
+    if (value != NULL) {
+        return (int)((intptr_t)value - 2);
+    }
+    int counter_fd = open_cache_miss_counter();
+    if (counter_fd < 0) {
+        counter_fd = -1;
+    }
+    if (pthread_setspecific(cache_miss_counter_key, (void*)(intptr_t)(counter_fd + 2)) != 0) {
+        // Without somewhere to keep it, the counter would leak
+        close_cache_miss_counter((void*)(intptr_t)(counter_fd + 2));
+        return -1;
+    }
+    return counter_fd;
+}
+
+int* knn_search_profiled(VectorIndex* index, Vector* query, int k, SearchStats* stats) {
+    int counter_fd = thread_cache_miss_counter();
+    if (counter_fd < 0) {
+        return knn_search_with_stats(index, query, k, stats);
+    }
+    
+    SearchStats query_stats;
+    memset(&query_stats, 0, sizeof(query_stats));
+    query_stats.cache_misses = -1;
+    
+    ioctl(counter_fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(counter_fd, PERF_EVENT_IOC_ENABLE, 0);
+    int* neighbors = knn_search_internal(index, query, k, &query_stats);
+    ioctl(counter_fd, PERF_EVENT_IOC_DISABLE, 0);
+    
+    long long counter_value = 0;
+    if (read(counter_fd, &counter_value, sizeof(counter_value)) == (ssize_t)sizeof(counter_value)) {
+        query_stats.cache_misses = counter_value;
+    }
+    
+    accumulate_search_stats(index, &query_stats);
+    if (stats) {
+        *stats = query_stats;
+    }
+    return neighbors;
+}
+#else
+int* knn_search_profiled(VectorIndex* index, Vector* query, int k, SearchStats* stats) {
+    // perf_event_open is Linux-only; stats->cache_misses stays -1
+    return knn_search_with_stats(index, query, k, stats);
+}
+#endif
+
 // ================================
 // INDEX CREATION AND MANAGEMENT
 // ================================
@@ -563,6 +825,10 @@ VectorIndex* create_index(Vector* vectors, int vector_count) {
     index->len = vector_count;
     index->hnsw_graph = NULL;
     index->use_hnsw_optimization = 0;
+    memset(&index->stats, 0, sizeof(IndexStats));
+    index->stats.build_inserts = vector_count;
+    index->deleted = NULL;
+    index->deleted_count = 0;
     return index;
 }
 
@@ -572,9 +838,11 @@ VectorIndex* create_hnsw_index(Vector* vectors, int vector_count, int max_connec
     
     // Build HNSW graph with reasonable defaults
     int construction_search_width = max_connections * 2;
+    clock_t build_start = clock();
     index->hnsw_graph = build_hnsw_graph(vectors, vector_count, max_connections,
                                         max_connections_layer_zero, level_factor, 
                                         construction_search_width);
+    index->stats.build_seconds = (double)(clock() - build_start) / CLOCKS_PER_SEC;
     index->use_hnsw_optimization = 1;
     
     return index;
@@ -601,5 +869,6 @@ void free_index(VectorIndex* index) {
     if (index->hnsw_graph) {
         free_hnsw_graph(index->hnsw_graph);
     }
+    free(index->deleted);
     free(index);
 }
\ No newline at end of file
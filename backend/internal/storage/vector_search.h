@@ -40,12 +40,34 @@ typedef struct {
     int construction_search_width;    // efConstruction: candidate list size during construction
 } HNSWGraph;
 
+// Per-query search statistics, filled in by knn_search_with_stats
+typedef struct {
+    long long distance_computations; // Distance evaluations against stored vectors
+    long long hops;                  // Candidates expanded during graph traversal
+    long long visited_nodes;         // Distinct nodes marked visited
+    long long heap_operations;       // Priority queue inserts and extractions
+    long long layers_descended;      // Upper HNSW layers walked before layer 0
+    long long cache_misses;          // Hardware cache misses, -1 when not measured
+} SearchStats;
+
+// Statistics aggregated over the lifetime of an index
+typedef struct {
+    SearchStats totals;              // Sums of per-query stats (cache_misses over profiled queries)
+    long long query_count;           // Queries that reported stats
+    long long profiled_query_count;  // Queries with a cache-miss measurement
+    long long build_inserts;         // Vectors inserted by the build and incremental inserts
+    double build_seconds;            // Time spent building the index and inserting into it
+} IndexStats;
+
 // Enhanced vector index supporting both brute-force and HNSW search
 typedef struct {
     Vector* vectors;
     int len;
     HNSWGraph* hnsw_graph;           // Optional HNSW graph for fast search
     int use_hnsw_optimization;       // Flag to enable HNSW search
+    IndexStats stats;                // Aggregated search and build statistics
+    unsigned char* deleted;          // Per-id tombstones, NULL until the first removal
+    int deleted_count;               // Number of ids currently marked deleted
 } VectorIndex;
 
 // Search configuration for optimized searches
@@ -73,6 +95,30 @@ int* hnsw_knn_search(VectorIndex* index, Vector* query, int k, SearchConfig* con
 int* approximate_search(VectorIndex* index, Vector* query, int k, int search_width);
 int* beam_search(VectorIndex* index, Vector* query, int k, int beam_width);
 
+// Instrumented search: fills the caller-provided stats (may be NULL) and adds
+// them to the index totals. Safe to call concurrently on the same index.
+int* knn_search_with_stats(VectorIndex* index, Vector* query, int k, SearchStats* stats);
+
+// Profiling: runs knn_search_with_stats while counting hardware cache misses on the
+// calling thread via perf_event_open. stats->cache_misses is -1 when counters are unavailable.
+int* knn_search_profiled(VectorIndex* index, Vector* query, int k, SearchStats* stats);
+
+// Copies the aggregated statistics of an index
+void get_index_stats(VectorIndex* index, IndexStats* stats);
+
+// Incremental updates (brute-force indexes only). The index does not own
+// vector storage: index_resize points it at a possibly reallocated array now
+// holding len vectors, with existing ids unchanged. index_set_deleted marks
+// an id deleted (skipped by searches) or live again. Both return -1 when the
+// index cannot be updated in place.
+int index_resize(VectorIndex* index, Vector* vectors, int len);
+int index_set_deleted(VectorIndex* index, int id, int deleted);
+
+// Adds vectors the caller wrote into index storage, and the seconds spent
+// writing them, to the build statistics. Brute-force indexes have no build
+// step of their own, so their throughput is that of filling the storage.
+void index_record_build(VectorIndex* index, long long inserts, double seconds);
+
 // Utility functions
 float calculate_euclidean_distance(Vector* vector_a, Vector* vector_b);
 int determine_random_layer(float level_generation_factor);
@@ -1,6 +1,50 @@
 import axios from "axios";
 
-export class ApiClient {
+export interface DocumentEdit {
+  offset: number;
+  length: number;
+  text: string;
+}
+
+// An error reported by the backend, with the HTTP status the same call
+// would have had.
+export class BackendError extends Error {
+  constructor(
+    message: string,
+    public status: number,
+  ) {
+    super(message);
+  }
+}
+
+// The calls the extension makes to the backend, over HTTP (ApiClient) or
+// the backend's Unix socket (SocketClient).
+export interface BackendClient {
+  startIndexing(path: string): Promise<void>;
+  indexFile(path: string): Promise<void>;
+  deleteFile(path: string): Promise<void>;
+  openDocument(filePath: string, version: number, text: string): Promise<void>;
+  changeDocument(
+    filePath: string,
+    baseVersion: number,
+    version: number,
+    changes: DocumentEdit[],
+  ): Promise<void>;
+  closeDocument(filePath: string): Promise<void>;
+  getCompletionSimple(
+    filePath: string,
+    content: string,
+    signal?: AbortSignal,
+  ): Promise<string>;
+  getCompletionStream(
+    filePath: string,
+    version: number,
+    offset: number,
+    signal?: AbortSignal,
+  ): Promise<string>;
+}
+
+export class ApiClient implements BackendClient {
   private client: axios.AxiosInstance;
   private baseUrl: string;
 
@@ -23,16 +67,97 @@ export class ApiClient {
     await this.client.delete("/index-file", { data: { path } });
   }
 
+  async openDocument(
+    filePath: string,
+    version: number,
+    text: string,
+  ): Promise<void> {
+    await this.client.post("/documents/open", {
+      file_path: filePath,
+      version,
+      text,
+    });
+  }
+
+  async changeDocument(
+    filePath: string,
+    baseVersion: number,
+    version: number,
+    changes: DocumentEdit[],
+  ): Promise<void> {
+    await this.client.post("/documents/change", {
+      file_path: filePath,
+      base_version: baseVersion,
+      version,
+      changes,
+    });
+  }
+
+  async closeDocument(filePath: string): Promise<void> {
+    await this.client.post("/documents/close", { file_path: filePath });
+  }
+
   async getCompletionSimple(
     filePath: string,
     content: string,
+    signal?: AbortSignal,
   ): Promise<string> {
     const response = await this.client.get("/complete", {
       params: {
         file_path: filePath,
         content: content,
       },
+      signal,
     });
     return response.data.completion;
   }
+
+  // Streams a completion at offset in a version of a document mirrored on
+  // the server (see DocumentSync) from the server-sent events endpoint,
+  // which ends after the first complete statement or block. Resolves with
+  // the whole completion once the server reports it done.
+  async getCompletionStream(
+    filePath: string,
+    version: number,
+    offset: number,
+    signal?: AbortSignal,
+  ): Promise<string> {
+    const response = await this.client.post(
+      "/complete/stream",
+      { file_path: filePath, version, offset },
+      { responseType: "stream", signal },
+    );
+
+    const decoder = new TextDecoder();
+    let completion = "";
+    let buffered = "";
+    for await (const data of response.data) {
+      buffered += decoder.decode(data, { stream: true });
+      let boundary: number;
+      while ((boundary = buffered.indexOf("\n\n")) >= 0) {
+        const event = buffered.slice(0, boundary);
+        buffered = buffered.slice(boundary + 2);
+        let name = "message";
+        let payload = "";
+        for (const line of event.split("\n")) {
+          if (line.startsWith("event:")) {
+            name = line.slice("event:".length).trim();
+          } else if (line.startsWith("data:")) {
+            payload += line.slice("data:".length);
+          }
+        }
+        if (name === "done") {
+          return completion;
+        }
+        if (name === "error") {
+          const failure = JSON.parse(payload);
+          throw new BackendError(failure.error, failure.status);
+        }
+        if (name === "token") {
+          completion += JSON.parse(payload).text;
+        }
+      }
+    }
+    return completion;
+  }
 }
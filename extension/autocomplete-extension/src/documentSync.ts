@@ -0,0 +1,92 @@
+import * as vscode from "vscode";
+import { BackendClient } from "./apiClient";
+
+// Mirrors open documents on the backend, like LSP didOpen/didChange, so that
+// completion requests send a document version and cursor offset rather than
+// the whole text before the cursor. A document is opened with its full text
+// the first time a completion needs it; after that only its edits are sent.
+// Requests for one document are chained so the backend sees them in order.
+export class DocumentSync {
+  // Version of each document the backend holds.
+  private synced = new Map<string, number>();
+  private pending = new Map<string, Promise<void>>();
+
+  constructor(
+    private apiClient: BackendClient,
+    private log: (message: string) => void,
+  ) {}
+
+  // Makes sure the backend holds the current version of document.
+  async ensure(document: vscode.TextDocument): Promise<void> {
+    const filePath = document.fileName;
+    await this.enqueue(filePath, async () => {
+      if (this.synced.get(filePath) === document.version) {
+        return;
+      }
+      const version = document.version;
+      await this.apiClient.openDocument(filePath, version, document.getText());
+      this.synced.set(filePath, version);
+    });
+  }
+
+  // Forgets what the backend holds for document, so the next ensure opens
+  // it again with its full text.
+  invalidate(document: vscode.TextDocument): void {
+    this.synced.delete(document.fileName);
+  }
+
+  onDidChange(event: vscode.TextDocumentChangeEvent): void {
+    const filePath = event.document.fileName;
+    if (!this.synced.has(filePath) || event.contentChanges.length === 0) {
+      return;
+    }
+    const version = event.document.version;
+    const changes = event.contentChanges.map((change) => ({
+      offset: change.rangeOffset,
+      length: change.rangeLength,
+      text: change.text,
+    }));
+    this.enqueue(filePath, async () => {
+      const baseVersion = this.synced.get(filePath);
+      if (baseVersion === undefined) {
+        return; // Reopened with full text on the next completion
+      }
+      this.synced.delete(filePath);
+      await this.apiClient.changeDocument(
+        filePath,
+        baseVersion,
+        version,
+        changes,
+      );
+      this.synced.set(filePath, version);
+    });
+  }
+
+  onDidClose(document: vscode.TextDocument): void {
+    const filePath = document.fileName;
+    if (!this.synced.has(filePath)) {
+      return;
+    }
+    this.enqueue(filePath, async () => {
+      this.synced.delete(filePath);
+      await this.apiClient.closeDocument(filePath);
+    });
+  }
+
+  private enqueue(filePath: string, task: () => Promise<void>): Promise<void> {
+    const previous = this.pending.get(filePath) ?? Promise.resolve();
+    const next = previous.then(task).catch((error: any) => {
+      this.synced.delete(filePath);
+      this.log(
+        `[DEBUG] Document sync failed for ${filePath}: ${error.message}`,
+      );
+    });
+    this.pending.set(filePath, next);
+    next.then(() => {
+      if (this.pending.get(filePath) === next) {
+        this.pending.delete(filePath);
+      }
+    });
+    return next;
+  }
+}
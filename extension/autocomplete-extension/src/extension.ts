@@ -2,12 +2,19 @@
 // Import the module and reference it with the alias vscode in your code below
 import * as vscode from "vscode";
 import { spawn, ChildProcess } from "child_process";
+import * as fs from "fs";
+import * as os from "os";
 import * as path from "path";
-import { ApiClient } from "./apiClient";
+import { ApiClient, BackendClient } from "./apiClient";
+import { SocketClient } from "./socketClient";
+import { DocumentSync } from "./documentSync";
 import find from "find-process";
 
 let backendProcess: ChildProcess;
-let apiClient: ApiClient;
+let apiClient: BackendClient;
+let socketPath: string | undefined;
+let sharedBackend = false;
+let documentSync: DocumentSync;
 let statusBar: vscode.StatusBarItem;
 let outputChannel: vscode.OutputChannel;
 let debounceTimer: NodeJS.Timeout | undefined;
@@ -67,6 +74,7 @@ function startBackendProcess(
   openaiApiKey: string,
   serverPath: string,
   embeddingConfig: any,
+  port: number,
 ): Promise<void> {
   return new Promise((resolve, reject) => {
     outputChannel.appendLine("Starting backend process...");
@@ -87,6 +95,14 @@ function startBackendProcess(
       "excludedExtensions",
       [],
     );
+    const watchDebounceMs: number = configuration.get("watchDebounceMs", 300);
+    const chunkMaxTokens: number = configuration.get("chunkMaxTokens", 512);
+    const chunkMinTokens: number = configuration.get("chunkMinTokens", 64);
+    const queryWindowLines: number = configuration.get("queryWindowLines", 40);
+    const workspaceMemoryMb: number = configuration.get(
+      "workspaceMemoryMb",
+      2048,
+    );
 
     // Compose environment variables from config and exclude lists
     // Read OpenAI completion model from configuration
@@ -110,12 +126,38 @@ function startBackendProcess(
       ? normalizedCompletionModel
       : "gpt-4.1-nano";
 
+    const completionProvider: string = configuration.get(
+      "completion.provider",
+      "openai",
+    );
+    const completionLocalUrl: string = configuration.get(
+      "completion.localUrl",
+      "http://localhost:11434/v1",
+    );
+    const completionLocalModel: string = configuration.get(
+      "completion.localModel",
+      "",
+    );
+    const completionHedge: string = configuration.get(
+      "completion.hedge",
+      "off",
+    );
+    const completionHedgePercentile: number = configuration.get(
+      "completion.hedgePercentile",
+      95,
+    );
+
     const env = {
       ...process.env,
       OPENAI_API_KEY_INJECTED: openaiApiKey,
       EMBEDDING_PROVIDER: embeddingConfig.provider,
       OPENAI_EMBEDDING_MODEL: embeddingConfig.openai.model,
       OPENAI_COMPLETION_MODEL: completionModelFinal,
+      COMPLETION_PROVIDER: completionProvider,
+      COMPLETION_LOCAL_URL: completionLocalUrl,
+      COMPLETION_LOCAL_MODEL: completionLocalModel,
+      COMPLETION_HEDGE: completionHedge,
+      COMPLETION_HEDGE_PERCENTILE: completionHedgePercentile.toString(),
       LOCAL_EMBEDDING_URL: embeddingConfig.local.serverUrl,
       LOCAL_EMBEDDING_SERVER_TYPE: embeddingConfig.local.serverType,
       LOCAL_EMBEDDING_MODEL: embeddingConfig.local.modelName,
@@ -125,9 +167,35 @@ function startBackendProcess(
       HUGGINGFACE_USE_GPU: embeddingConfig.huggingface.useGpu.toString(),
       HUGGINGFACE_MAX_LENGTH: embeddingConfig.huggingface.maxLength.toString(),
       HUGGINGFACE_BATCH_SIZE: embeddingConfig.huggingface.batchSize.toString(),
+      EMBEDDING_BATCH_SIZE: embeddingConfig.batchSize.toString(),
+      EMBEDDING_CONCURRENCY: embeddingConfig.concurrency.toString(),
+      EMBEDDING_INTERACTIVE_CONCURRENCY:
+        embeddingConfig.interactiveConcurrency.toString(),
+      EMBEDDING_FILE_CONCURRENCY: embeddingConfig.fileConcurrency.toString(),
+      EMBEDDING_REQUESTS_PER_SECOND: embeddingConfig.requestsPerSecond.toString(),
+      EMBEDDING_CACHE_MAX_MB: embeddingConfig.cacheMaxMb.toString(),
+      EMBEDDING_CACHE_KEY_MODE: embeddingConfig.cacheKeyMode,
+      EMBEDDING_MEMORY_CACHE_MB: embeddingConfig.memoryCacheMb.toString(),
       EXCLUDED_FILES: excludedFiles.join(","),
       EXCLUDED_EXTENSIONS: excludedExtensions.join(","),
+      INDEX_WATCH_DEBOUNCE_MS: watchDebounceMs.toString(),
+      CHUNK_MAX_TOKENS: chunkMaxTokens.toString(),
+      CHUNK_MIN_TOKENS: chunkMinTokens.toString(),
+      QUERY_WINDOW_LINES: queryWindowLines.toString(),
+      WORKSPACE_MEMORY_MB: workspaceMemoryMb.toString(),
+      // With a socket, HTTP is turned off: each window's backend is private
+      // and no port can collide.
+      BACKEND_PORT: socketPath ? "0" : port.toString(),
+      BACKEND_SOCKET: socketPath ?? "",
+      // A shared backend outlives the window that started it and exits a
+      // while after the last window disconnects.
+      BACKEND_IDLE_TIMEOUT_SECONDS: sharedBackend
+        ? sharedBackendIdleSeconds.toString()
+        : "0",
     };
+    const readyMessage = socketPath
+      ? "Listening for RPC on"
+      : "Listening and serving HTTP on";
 
     outputChannel.appendLine(
       `Using embedding provider: ${embeddingConfig.provider}`,
@@ -151,6 +219,37 @@ function startBackendProcess(
       );
     }
 
+    if (sharedBackend && socketPath) {
+      // Detach the shared backend and send its output to a file, so it
+      // keeps serving the other windows when this one closes.
+      // The log is only appended to and never followed through a symlink.
+      const logPath = `${socketPath}.log`;
+      const logFd = fs.openSync(
+        logPath,
+        fs.constants.O_WRONLY |
+          fs.constants.O_APPEND |
+          fs.constants.O_CREAT |
+          fs.constants.O_NOFOLLOW,
+        0o600,
+      );
+      const shared = spawn(serverPath, [], {
+        cwd: context.extensionPath,
+        env: env,
+        detached: true,
+        stdio: ["ignore", logFd, logFd],
+      });
+      fs.closeSync(logFd);
+      shared.unref();
+      outputChannel.appendLine(`Started shared backend, logging to ${logPath}`);
+      shared.on("error", (err: Error) => {
+        outputChannel.appendLine(`Failed to start backend process: ${err}`);
+        statusBar.text = "$(error) Backend failed";
+        reject(err);
+      });
+      waitForSocket(apiClient as SocketClient).then(resolve, reject);
+      return;
+    }
+
     backendProcess = spawn(serverPath, [], {
       cwd: context.extensionPath,
       env: env,
@@ -165,7 +264,7 @@ function startBackendProcess(
     backendProcess.stdout?.on("data", (data: Buffer) => {
       const message = data.toString();
       outputChannel.appendLine(`Backend: ${message}`);
-      if (message.includes("Listening and serving HTTP on")) {
+      if (message.includes(readyMessage)) {
         outputChannel.appendLine("Backend is ready.");
         resolve();
       }
@@ -185,6 +284,62 @@ function startBackendProcess(
   });
 }
 
+// How long a shared backend keeps running once no window is connected.
+const sharedBackendIdleSeconds = 300;
+
+// Returns a directory for backend sockets and logs that only the current
+// user can access: one under $XDG_RUNTIME_DIR when it is set, or else one in
+// the temporary directory. Anyone can create paths in the latter first, so
+// the directory is used only if it is a real directory owned by the user
+// with no group or other permissions.
+function privateSocketDir(): string {
+  const runtimeDir = process.env.XDG_RUNTIME_DIR;
+  const dir = runtimeDir
+    ? path.join(runtimeDir, "autocomplete")
+    : path.join(os.tmpdir(), `autocomplete-${os.userInfo().uid}`);
+  try {
+    fs.mkdirSync(dir, { mode: 0o700 });
+  } catch (err) {
+    if ((err as NodeJS.ErrnoException).code !== "EEXIST") {
+      throw err;
+    }
+  }
+  const stats = fs.lstatSync(dir);
+  if (
+    !stats.isDirectory() ||
+    stats.uid !== os.userInfo().uid ||
+    (stats.mode & 0o077) !== 0
+  ) {
+    throw new Error(`${dir} is not a private directory of the current user`);
+  }
+  return dir;
+}
+
+// Reports whether the socket at socketPath exists and belongs to the
+// current user, so a backend is only attached to if this user started it.
+function ownSocket(socketPath: string): boolean {
+  try {
+    const stats = fs.lstatSync(socketPath);
+    return stats.isSocket() && stats.uid === os.userInfo().uid;
+  } catch {
+    return false;
+  }
+}
+
+// Resolves once a backend accepts connections on the client's socket. Two
+// windows starting at once may both launch a shared backend; the second
+// exits on finding the first already listening, and both attach to it.
+async function waitForSocket(client: SocketClient): Promise<void> {
+  for (let attempt = 0; attempt < 600; attempt++) {
+    if (await client.ping()) {
+      outputChannel.appendLine("Backend is ready.");
+      return;
+    }
+    await new Promise((resolve) => setTimeout(resolve, 100));
+  }
+  throw new Error("Backend did not start listening within 60 seconds");
+}
+
 export async function activate(context: vscode.ExtensionContext) {
   // Create an output channel for logging.
   outputChannel = vscode.window.createOutputChannel("AI Autocomplete");
@@ -238,9 +393,53 @@ export async function activate(context: vscode.ExtensionContext) {
       maxLength: config.get<number>("huggingface.maxLength") ?? 512,
       batchSize: config.get<number>("huggingface.batchSize") ?? 1,
     },
+    batchSize: config.get<number>("embeddingBatchSize") ?? 32,
+    concurrency: config.get<number>("embeddingConcurrency") ?? 0,
+    interactiveConcurrency:
+      config.get<number>("embeddingInteractiveConcurrency") ?? 4,
+    fileConcurrency: config.get<number>("embeddingFileConcurrency") ?? 2,
+    requestsPerSecond: config.get<number>("embeddingRequestsPerSecond") ?? 0,
+    cacheMaxMb: config.get<number>("embeddingCacheMaxMb") ?? 512,
+    cacheKeyMode: config.get<string>("embeddingCacheKeyMode") ?? "content",
+    memoryCacheMb: config.get<number>("embeddingMemoryCacheMb") ?? 256,
   };
 
-  apiClient = new ApiClient(port);
+  // Unix domain sockets are not used on Windows.
+  const transport = config.get<string>("transport") ?? "socket";
+  let socketDir: string | undefined;
+  if (transport === "socket" && process.platform !== "win32") {
+    try {
+      socketDir = privateSocketDir();
+    } catch (err) {
+      outputChannel.appendLine(`Falling back to HTTP: ${err}`);
+    }
+  }
+  if (socketDir) {
+    // A shared backend serves every window of the user from one socket;
+    // otherwise each window gets a private one.
+    sharedBackend = config.get<boolean>("sharedBackend") ?? true;
+    socketPath = path.join(
+      socketDir,
+      sharedBackend
+        ? "backend.sock"
+        : `window-${process.pid}-${Date.now()}.sock`,
+    );
+    apiClient = new SocketClient(socketPath);
+    outputChannel.appendLine(`Using backend socket: ${socketPath}`);
+  } else {
+    apiClient = new ApiClient(port);
+  }
+  documentSync = new DocumentSync(apiClient, (message) =>
+    outputChannel.appendLine(message),
+  );
+  context.subscriptions.push(
+    vscode.workspace.onDidChangeTextDocument((event) =>
+      documentSync.onDidChange(event),
+    ),
+    vscode.workspace.onDidCloseTextDocument((document) =>
+      documentSync.onDidClose(document),
+    ),
+  );
 
   // Create and show the status bar item.
   statusBar = vscode.window.createStatusBarItem(
@@ -409,10 +608,42 @@ export async function activate(context: vscode.ExtensionContext) {
                 `[INFO] ✅ Requesting completion for ${document.fileName} at ${position.line}:${position.character}`,
               );
 
-              const completion = await apiClient.getCompletionSimple(
-                document.fileName,
-                textBeforeCursor,
+              // The backend mirrors the document, so only the edits since
+              // the last request and the cursor offset are sent.
+              const version = document.version;
+              const offset = document.offsetAt(position);
+              await documentSync.ensure(document);
+              if (
+                token.isCancellationRequested ||
+                document.version !== version
+              ) {
+                resolve([]);
+                return;
+              }
+
+              // Abort the request when VS Code no longer wants its
+              // result, so the backend stops working on it.
+              const abort = new AbortController();
+              const cancellation = token.onCancellationRequested(() =>
+                abort.abort(),
               );
+              let completion: string;
+              try {
+                completion = await apiClient.getCompletionStream(
+                  document.fileName,
+                  version,
+                  offset,
+                  abort.signal,
+                );
+              } catch (error: any) {
+                const status = error.status ?? error.response?.status;
+                if (status === 404 || status === 409) {
+                  documentSync.invalidate(document);
+                }
+                throw error;
+              } finally {
+                cancellation.dispose();
+              }
 
               if (completion && completion.trim()) {
                 outputChannel.appendLine(
@@ -457,25 +688,38 @@ export async function activate(context: vscode.ExtensionContext) {
 
   try {
     // Check if the port is already in use and kill the process if it is.
-    try {
-      const processes = await find("port", port);
-      if (processes.length > 0) {
-        outputChannel.appendLine(
-          `Port ${port} is already in use by process ${processes[0].name} (pid: ${processes[0].pid}). Terminating it.`,
-        );
-        process.kill(processes[0].pid);
-        outputChannel.appendLine(`Process ${processes[0].pid} terminated.`);
+    // A socket is unique to this window, so there is nothing to check.
+    if (!socketPath) {
+      try {
+        const processes = await find("port", port);
+        if (processes.length > 0) {
+          outputChannel.appendLine(
+            `Port ${port} is already in use by process ${processes[0].name} (pid: ${processes[0].pid}). Terminating it.`,
+          );
+          process.kill(processes[0].pid);
+          outputChannel.appendLine(`Process ${processes[0].pid} terminated.`);
+        }
+      } catch (err) {
+        outputChannel.appendLine(`Error checking port ${port}: ${err}`);
       }
-    } catch (err) {
-      outputChannel.appendLine(`Error checking port ${port}: ${err}`);
     }
 
-    await startBackendProcess(
-      context,
-      openaiApiKey,
-      serverPath,
-      embeddingConfig,
-    );
+    if (
+      sharedBackend &&
+      socketPath &&
+      ownSocket(socketPath) &&
+      (await (apiClient as SocketClient).ping())
+    ) {
+      outputChannel.appendLine(`Attached to running backend: ${socketPath}`);
+    } else {
+      await startBackendProcess(
+        context,
+        openaiApiKey,
+        serverPath,
+        embeddingConfig,
+        port,
+      );
+    }
 
     // Trigger indexing when a workspace is opened.
     if (vscode.workspace.workspaceFolders) {
@@ -569,9 +813,16 @@ export async function activate(context: vscode.ExtensionContext) {
 }
 
 export function deactivate() {
+  if (apiClient instanceof SocketClient) {
+    apiClient.dispose();
+  }
   if (backendProcess) {
     backendProcess.kill();
   }
+  if (socketPath && !sharedBackend) {
+    fs.rmSync(socketPath, { force: true });
+    fs.rmSync(`${socketPath}.lock`, { force: true });
+  }
   if (statusBar) {
     statusBar.dispose();
   }
@@ -0,0 +1,215 @@
+import * as net from "net";
+import { BackendClient, BackendError, DocumentEdit } from "./apiClient";
+
+interface PendingCall {
+  resolve(result: any): void;
+  reject(error: Error): void;
+  onEvent?(event: string, result: any): void;
+}
+
+// Talks to the backend over its Unix domain socket, which saves the HTTP
+// parsing and loopback TCP of ApiClient and needs no fixed port, so windows
+// can run their own backends or share one. Each message is a 4-byte big-endian
+// length followed by JSON. Calls are multiplexed on one connection by id,
+// and aborting one sends a cancel for its id.
+export class SocketClient implements BackendClient {
+  private socket: net.Socket | undefined;
+  private connecting: Promise<net.Socket> | undefined;
+  private nextId = 1;
+  private calls = new Map<number, PendingCall>();
+  private buffered = Buffer.alloc(0);
+
+  constructor(private socketPath: string) {}
+
+  async startIndexing(path: string): Promise<void> {
+    await this.call("index", { path });
+  }
+
+  async indexFile(path: string): Promise<void> {
+    await this.call("indexFile", { path });
+  }
+
+  async deleteFile(path: string): Promise<void> {
+    await this.call("deleteFile", { path });
+  }
+
+  async openDocument(
+    filePath: string,
+    version: number,
+    text: string,
+  ): Promise<void> {
+    await this.call("openDocument", { file_path: filePath, version, text });
+  }
+
+  async changeDocument(
+    filePath: string,
+    baseVersion: number,
+    version: number,
+    changes: DocumentEdit[],
+  ): Promise<void> {
+    await this.call("changeDocument", {
+      file_path: filePath,
+      base_version: baseVersion,
+      version,
+      changes,
+    });
+  }
+
+  async closeDocument(filePath: string): Promise<void> {
+    await this.call("closeDocument", { file_path: filePath });
+  }
+
+  async getCompletionSimple(
+    filePath: string,
+    content: string,
+    signal?: AbortSignal,
+  ): Promise<string> {
+    const result = await this.call(
+      "complete",
+      { file_path: filePath, content },
+      signal,
+    );
+    return result.completion;
+  }
+
+  async getCompletionStream(
+    filePath: string,
+    version: number,
+    offset: number,
+    signal?: AbortSignal,
+  ): Promise<string> {
+    let completion = "";
+    await this.call(
+      "completeStream",
+      { file_path: filePath, version, offset },
+      signal,
+      (event, result) => {
+        if (event === "token") {
+          completion += result.text;
+        }
+      },
+    );
+    return completion;
+  }
+
+  // Reports whether a backend is listening on the socket.
+  async ping(): Promise<boolean> {
+    try {
+      await this.connect();
+      return true;
+    } catch {
+      return false;
+    }
+  }
+
+  dispose(): void {
+    this.socket?.destroy();
+  }
+
+  private async call(
+    method: string,
+    params: object,
+    signal?: AbortSignal,
+    onEvent?: (event: string, result: any) => void,
+  ): Promise<any> {
+    if (signal?.aborted) {
+      throw new Error("Request aborted");
+    }
+    const socket = await this.connect();
+    const id = this.nextId++;
+    return new Promise((resolve, reject) => {
+      const abort = () => {
+        if (this.calls.delete(id)) {
+          this.send(socket, { id: 0, method: "cancel", params: { id } });
+          reject(new Error("Request aborted"));
+        }
+      };
+      signal?.addEventListener("abort", abort, { once: true });
+      this.calls.set(id, {
+        resolve: (result) => {
+          signal?.removeEventListener("abort", abort);
+          resolve(result);
+        },
+        reject: (error) => {
+          signal?.removeEventListener("abort", abort);
+          reject(error);
+        },
+        onEvent,
+      });
+      this.send(socket, { id, method, params });
+    });
+  }
+
+  private connect(): Promise<net.Socket> {
+    if (this.socket) {
+      return Promise.resolve(this.socket);
+    }
+    if (!this.connecting) {
+      this.connecting = new Promise((resolve, reject) => {
+        const socket = net.createConnection(this.socketPath);
+        socket.once("connect", () => {
+          this.socket = socket;
+          this.connecting = undefined;
+          resolve(socket);
+        });
+        socket.on("data", (data: Buffer) => this.receive(data));
+        socket.on("error", (error: Error) => {
+          this.connecting = undefined;
+          reject(error);
+        });
+        socket.on("close", () => {
+          this.socket = undefined;
+          this.connecting = undefined;
+          this.buffered = Buffer.alloc(0);
+          this.failAll(new Error("Backend connection closed"));
+        });
+      });
+    }
+    return this.connecting;
+  }
+
+  private send(socket: net.Socket, message: object): void {
+    const body = Buffer.from(JSON.stringify(message));
+    const header = Buffer.alloc(4);
+    header.writeUInt32BE(body.length);
+    socket.write(Buffer.concat([header, body]));
+  }
+
+  private receive(data: Buffer): void {
+    this.buffered = Buffer.concat([this.buffered, data]);
+    while (this.buffered.length >= 4) {
+      const size = this.buffered.readUInt32BE(0);
+      if (this.buffered.length < 4 + size) {
+        return;
+      }
+      const frame = this.buffered.subarray(4, 4 + size).toString("utf8");
+      this.buffered = this.buffered.subarray(4 + size);
+      this.dispatch(JSON.parse(frame));
+    }
+  }
+
+  private dispatch(message: any): void {
+    const call = this.calls.get(message.id);
+    if (!call) {
+      return; // Aborted
+    }
+    if (message.event) {
+      call.onEvent?.(message.event, message.result);
+      return;
+    }
+    this.calls.delete(message.id);
+    if (message.error) {
+      call.reject(new BackendError(message.error, message.status));
+    } else {
+      call.resolve(message.result ?? {});
+    }
+  }
+
+  private failAll(error: Error): void {
+    const calls = [...this.calls.values()];
+    this.calls.clear();
+    for (const call of calls) {
+      call.reject(error);
+    }
+  }
+}